@@ -5,14 +5,52 @@ import numpy as np
 import tflite_runtime.interpreter as tflite  # Import TFLite runtime for inference
 import struct  # For binary data packing
 import random
+import os
+import time
 
 # time in [ms] of a simulation step
 TIME_STEP = 64
 MAX_SPEED = 6.28
 
+# Binary window packet sent by the supervisor (see libraries/vibration/window_packet.hpp):
+# magic, version, axis count, sequence, timestamp, window length, sample count, robot id,
+# feature count, band count
+WINDOW_PACKET_HEADER = struct.Struct('<2sBBIdHHIHH')
+WINDOW_PACKET_VERSION = 2
+
+# Binary result packet sent back to the supervisor (see libraries/vibration/result_packet.hpp):
+# magic, version, class count, robot id, window sequence, label, inference time in microseconds,
+# followed by the float32 class probabilities
+RESULT_PACKET_HEADER = struct.Struct('<2sBBIIif')
+RESULT_PACKET_VERSION = 1
+
 
 ################## SUPPORT FUNCTIONS ########################
 
+# Function to decode a window packet into its robot id, sequence, timestamp, float32 samples and
+# float32 features (either may be empty, depending on the supervisor's --payload)
+def decode_window_packet(packet):
+    if len(packet) < WINDOW_PACKET_HEADER.size:
+        return None
+    (magic, version, axes, sequence, timestamp, window_length, sample_count, robot_id,
+     feature_count, band_count) = WINDOW_PACKET_HEADER.unpack_from(packet)
+    if magic != b'WP' or version != WINDOW_PACKET_VERSION or axes != 3 or sample_count not in (0, 3 * window_length):
+        return None
+    if len(packet) < WINDOW_PACKET_HEADER.size + 4 * (sample_count + feature_count):
+        return None
+    samples = np.frombuffer(packet, dtype='<f4', count=sample_count, offset=WINDOW_PACKET_HEADER.size)
+    features = np.frombuffer(packet, dtype='<f4', count=feature_count, offset=WINDOW_PACKET_HEADER.size + 4 * sample_count)
+    return robot_id, sequence, timestamp, samples, features
+
+
+# Function to encode the classification of a window into a result packet
+def encode_result_packet(robot_id, sequence, label, inference_time, probabilities):
+    probabilities = np.asarray(probabilities, dtype='<f4').ravel()
+    header = RESULT_PACKET_HEADER.pack(b'RP', RESULT_PACKET_VERSION, len(probabilities), robot_id, sequence, label,
+                                       inference_time)
+    return header + probabilities.tobytes()
+
+
 # Function to check for obstacles
 def check_obstacle():
     # Read sensor outputs
@@ -27,8 +65,8 @@ def check_obstacle():
 
 ################ CNN MODEL INITIALIZATION ######################
 
-# Load the TFLite model and allocate tensors
-model_path = '../../models/cnn_model.tflite'
+# Load the TFLite model and allocate tensors; the path is relative to this file, not to the working directory
+model_path = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', 'models', 'cnn_model.tflite')
 interpreter = tflite.Interpreter(model_path=model_path)
 interpreter.allocate_tensors()
 
@@ -77,34 +115,38 @@ while robot.step(TIME_STEP) != -1:
 
     # check for data from the supervisor
     if receiver.getQueueLength() > 0:
-        # receive string data from supervisor
-        data = receiver.getString().replace('\x00', '').strip()
-        
-        # Split the data into individual readings
-        readings = data.split(';')
-        
-        # Collect all the 24 readings into a single numpy array for inference
-        input_data = []
-        for reading in readings:
-            attenuated_values = list(map(float, reading.split(',')))
-            input_data.extend(attenuated_values)  # Flatten into a single list
-        
-        # Convert to a numpy array and reshape based on model's expected input shape
-        input_data = np.array(input_data, dtype=np.float32).reshape(input_details[0]['shape'])
-        
-        # Set the input tensor
-        interpreter.set_tensor(input_details[0]['index'], input_data)
-        
-        # Run inference
-        interpreter.invoke()
-        output_data = interpreter.get_tensor(output_details[0]['index'])
-        
-        # Extract classification label (assuming output_data is a single value or list of probabilities)
-        classification_label = np.argmax(output_data)
-        print(f"Inference result: {classification_label}")
-        
-        # Send classification label back to the supervisor via emitter
-        emitter.send(struct.pack('i', classification_label))  # Sending the label as an integer
+        # receive the binary window packet from the supervisor
+        window = decode_window_packet(receiver.getBytes())
+
+        if window is None:
+            print("Ignoring malformed window packet")
+        elif len(window[3]) == 0:
+            # Features only: per axis rms, peak, crest factor, kurtosis and band energies; the CNN needs raw samples
+            print(f"Window features: {np.round(window[4], 3)}")
+        elif len(window[3]) != np.prod(input_details[0]['shape']):
+            # A window length other than the model's (--window-length in the supervisor)
+            print(f"Ignoring malformed window packet (expected {np.prod(input_details[0]['shape'])} samples)")
+        else:
+            robot_id, sequence, timestamp, samples, features = window
+
+            # Reshape the 24 x, y, z readings based on model's expected input shape
+            input_data = samples.reshape(input_details[0]['shape'])
+
+            # Set the input tensor
+            interpreter.set_tensor(input_details[0]['index'], input_data)
+
+            # Run inference
+            inference_start = time.perf_counter()
+            interpreter.invoke()
+            output_data = interpreter.get_tensor(output_details[0]['index'])
+            inference_time = (time.perf_counter() - inference_start) * 1e6
+
+            # Extract classification label (assuming output_data is a single value or list of probabilities)
+            classification_label = np.argmax(output_data)
+            print(f"Inference result: {classification_label}")
+
+            # Send the result back to the supervisor via emitter, tagged with the robot id and window sequence
+            emitter.send(encode_result_packet(robot_id, sequence, int(classification_label), inference_time, output_data))
 
         # clear the receiver queue
         receiver.nextPacket()
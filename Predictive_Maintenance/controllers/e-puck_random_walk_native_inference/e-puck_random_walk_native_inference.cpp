@@ -0,0 +1,149 @@
+// File: e-puck_random_walk_native_inference.cpp
+// Description: C++ port of the e-puck_random_walk_CNN_inference controller. The robot random-walks
+// while classifying the accelerometer windows sent by the supervisor with the CNN embedded in
+// models/cnn_model.h, run in-process by the vibration library instead of the TFLite runtime.
+// Author:
+
+#include <webots/Robot.hpp>
+#include <webots/DistanceSensor.hpp>
+#include <webots/Motor.hpp>
+#include <webots/Emitter.hpp>
+#include <webots/Receiver.hpp>
+#include <cnn_model.hpp>        // Native TFLite model runner from the vibration library
+#include <result_packet.hpp>    // Binary result packets sent back to the supervisor
+#include <window_packet.hpp>    // Binary window packets sent by the supervisor
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <cmath>
+
+#include "../../models/cnn_model.h"  // autoencoder_model[]: the TFLite flatbuffer of cnn_model.tflite
+
+using namespace webots;
+using namespace std;
+
+// time in [ms] of a simulation step
+static const int TIME_STEP = 64;
+static const double MAX_SPEED = 6.28;
+static const size_t MAX_FEATURES = 1024;
+
+int main(int argc, char **argv) {
+  // Load the embedded CNN model
+  CnnModel model;
+  string error;
+  if (!model.load(autoencoder_model, autoencoder_model_len, &error)) {
+    cerr << "Error: Could not load the embedded CNN model (" << error << ")" << endl;
+    return 1;
+  }
+  vector<float> inputData(model.inputSize());
+  vector<float> probabilities(model.outputSize());
+  uint8_t classCount = (uint8_t)min(probabilities.size(), kMaxResultClasses);
+  vector<unsigned char> resultPacket(resultPacketSize(classCount));
+  float features[MAX_FEATURES];
+
+  // create the Robot instance.
+  Robot *robot = new Robot();
+
+  // Enable distance sensors
+  DistanceSensor *sensors[8];
+  for (int k = 0; k < 8; ++k) {
+    sensors[k] = robot->getDistanceSensor("ps" + to_string(k));
+    sensors[k]->enable(TIME_STEP);
+  }
+
+  // initialize motors
+  Motor *leftMotor = robot->getMotor("left wheel motor");
+  Motor *rightMotor = robot->getMotor("right wheel motor");
+  leftMotor->setPosition(INFINITY);
+  rightMotor->setPosition(INFINITY);
+  leftMotor->setVelocity(0.0);
+  rightMotor->setVelocity(0.0);
+
+  // initialize receiver to receive data from the supervisor
+  Receiver *receiver = robot->getReceiver("receiver");
+  receiver->enable(TIME_STEP);
+
+  // initialize emitter to send classification label back to the supervisor
+  Emitter *emitter = robot->getEmitter("emitter");
+
+  mt19937 random(random_device{}());
+  uniform_real_distribution<double> chance(0.0, 1.0);
+
+  // feedback loop: step simulation until receiving an exit event
+  while (robot->step(TIME_STEP) != -1) {
+    // check for data from the supervisor
+    if (receiver->getQueueLength() > 0) {
+      WindowPacketHeader header;
+      bool decoded = decodeWindowPacket(receiver->getData(), receiver->getDataSize(), header, inputData.data(), inputData.size(),
+                                        features, MAX_FEATURES);
+
+      if (decoded && header.sampleCount == 0) {
+        // Features only: per axis rms, peak, crest factor, kurtosis and band energies; the CNN needs raw samples
+        cout << "Window features:";
+        for (size_t f = 0; f < header.featureCount; ++f)
+          cout << " " << features[f];
+        cout << endl;
+      } else if (decoded && header.sampleCount == inputData.size()) {
+        auto inferenceStart = chrono::steady_clock::now();
+        model.invoke(inputData.data(), probabilities.data());
+        float inferenceTime = chrono::duration<float, micro>(chrono::steady_clock::now() - inferenceStart).count();
+        int classificationLabel = (int)(max_element(probabilities.begin(), probabilities.end()) - probabilities.begin());
+        cout << "Inference result: " << classificationLabel << endl;
+
+        // Send the result back to the supervisor via emitter, tagged with the robot id and window sequence
+        ResultPacketHeader result = {header.robotId, header.sequence, classificationLabel, inferenceTime, classCount};
+        size_t resultSize = encodeResultPacket(result, probabilities.data(), resultPacket.data());
+        emitter->send(resultPacket.data(), (int)resultSize);
+      } else {
+        cerr << "Ignoring malformed window packet (expected " << inputData.size() << " samples)" << endl;
+      }
+
+      // clear the receiver queue
+      receiver->nextPacket();
+    }
+
+    // initialize motor speeds at 50% of MAX_SPEED.
+    double leftSpeed = 0.5 * MAX_SPEED;
+    double rightSpeed = 0.5 * MAX_SPEED;
+
+    // Detect obstacles
+    bool rightObstacle = sensors[0]->getValue() > 80.0 || sensors[1]->getValue() > 80.0 || sensors[2]->getValue() > 80.0;
+    bool leftObstacle = sensors[5]->getValue() > 80.0 || sensors[6]->getValue() > 80.0 || sensors[7]->getValue() > 80.0;
+
+    // modify speeds according to obstacles
+    if (leftObstacle) {
+      // turn right
+      rightSpeed = -0.5 * MAX_SPEED;
+    } else if (rightObstacle) {
+      // turn left
+      leftSpeed = -0.5 * MAX_SPEED;
+    } else if (chance(random) < 0.1) {  // 10% chance per time step to initiate a turn
+      // Turn in place for a random number of time steps, in a random direction
+      int turnDuration = uniform_int_distribution<int>(5, 20)(random);
+      double turnSpeed = chance(random) < 0.5 ? 0.5 * MAX_SPEED : -0.5 * MAX_SPEED;
+      for (int k = 0; k < turnDuration; ++k) {
+        leftMotor->setVelocity(turnSpeed);
+        rightMotor->setVelocity(-turnSpeed);
+        robot->step(TIME_STEP);
+      }
+
+      // Move forward for a bit longer after the turn
+      int forwardDuration = uniform_int_distribution<int>(20, 50)(random);
+      for (int k = 0; k < forwardDuration; ++k) {
+        leftMotor->setVelocity(0.5 * MAX_SPEED);
+        rightMotor->setVelocity(0.5 * MAX_SPEED);
+        robot->step(TIME_STEP);
+      }
+    }
+
+    // write actuators inputs
+    leftMotor->setVelocity(leftSpeed);
+    rightMotor->setVelocity(rightSpeed);
+  }
+
+  delete robot;
+  return 0;
+}
@@ -1,170 +1,468 @@
 // File: supervisor_controller.cpp
-// Description: Supervisor script to read and save accelerometer data with attenuation calculations, 
-// and receive classification label from robot after inference.
+// Description: Supervisor script to read and save accelerometer data with attenuation calculations
+// for a fleet of robots, and receive classification labels from the robots after inference.
 // Author:
 
 #include <webots/Supervisor.hpp>
 #include <webots/Emitter.hpp>   // Include Emitter class
 #include <webots/Receiver.hpp>  // Include Receiver class for receiving data
+#include <capture_file.hpp>     // Sample rate in the header of binary captures
+#include <fleet.hpp>            // Fleet files and grid fleets
+#include <instrumentation.hpp>  // Phase timings and latency histograms, see instrumentation.mk
+#include <map_store.hpp>        // Precomputed vibration maps, chunked and compressed on disk
+#include <pose_sampler.hpp>     // Robot positions read every few steps, extrapolated in between
+#include <supervisor_pipeline.hpp> // Playback, attenuation, windowing, inference and results of a step
+#include <telemetry.hpp>        // Asynchronous writer of the labels, positions and timings
+#include <vibration_map.hpp>    // Captures preloaded as a spatio-temporal vibration map
+#include <vibration_sources.hpp> // Vibration sources and their propagation models
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <fstream>
 #include <sstream>
 #include <vector>
 #include <string>
-#include <cmath>  // For sqrt and pow
+#include <memory>
+
+#include "../../models/cnn_model.h"  // autoencoder_model[]: the TFLite flatbuffer of cnn_model.tflite
 
 using namespace webots;
 using namespace std;
 
-// Function to read accelerometer data from a file
-vector<vector<double>> readAccelerometerData(const string &filename) {
-  vector<vector<double>> data;
-  ifstream file(filename);
-  string line;
+// Channels: robots send their labels on kLabelChannel, and robot k receives its windows on its own
+// channel, kFirstRobotChannel + k unless the fleet file says otherwise
+const int kLabelChannel = 1;
+const int kFirstRobotChannel = 2;
+
+// Side of the RectangleArena floor, in meters
+const double kArenaSize = 10.0;
+
+// Windows of the first capture used to calibrate the activation ranges of the int8 model
+const size_t kInt8CalibrationWindows = 256;
+
+// Functions to parse the whole of a numeric option value. A malformed or out-of-range value prints an
+// error and leaves value, i.e. the default, unchanged, as an unknown option value does.
+static bool parseOption(const string &option, const char *text, double &value) {
+  char *end = nullptr;
+  errno = 0;
+  double parsed = strtod(text, &end);
+  if (end == text || *end != '\0' || errno == ERANGE || !isfinite(parsed)) {
+    cerr << "Error: Invalid number " << text << " for " << option << endl;
+    return false;
+  }
+  value = parsed;
+  return true;
+}
 
-  // Check if the file opened successfully
-  if (!file.is_open()) {
-    cerr << "Error: Could not open the file " << filename << endl;
-    return data;
+static bool parseOption(const string &option, const char *text, float &value) {
+  double parsed = value;
+  if (!parseOption(option, text, parsed))
+    return false;
+  if (!isfinite((float)parsed)) {
+    cerr << "Error: Invalid number " << text << " for " << option << endl;
+    return false;
   }
+  value = (float)parsed;
+  return true;
+}
 
-  // Read the file line by line
-  while (getline(file, line)) {
-    stringstream ss(line);
-    string value;
-    vector<double> row;
+static bool parseOption(const string &option, const char *text, size_t &value) {
+  char *end = nullptr;
+  errno = 0;
+  unsigned long long parsed = strtoull(text, &end, 10);
+  // strtoull() accepts a sign and wraps negative numbers around
+  if (end == text || *end != '\0' || errno == ERANGE || strchr(text, '-') || parsed > SIZE_MAX) {
+    cerr << "Error: Invalid count " << text << " for " << option << endl;
+    return false;
+  }
+  value = (size_t)parsed;
+  return true;
+}
 
-    // Split the line by tabs and convert to doubles
-    while (getline(ss, value, '\t')) {
-      row.push_back(stod(value));
+// Webots side of the pipeline: robot nodes, emitter and receiver
+class WebotsPoses : public RobotPoses {
+public:
+  // Webots streams the pose of every robot every samplingPeriod ms, so that reading them does not
+  // cost a request to the simulator per robot
+  WebotsPoses(const vector<Node *> &nodes, int samplingPeriod) : nodes_(nodes) {
+    for (Node *node : nodes_)
+      node->enablePoseTracking(samplingPeriod);
+  }
+  void read(double, vector<double> &x, vector<double> &y) override {
+    for (size_t k = 0; k < nodes_.size(); ++k) {
+      const double *pose = nodes_[k]->getPose();  // Row-major 4x4 transform in the world frame
+      x[k] = pose[3];
+      y[k] = pose[7];
     }
+  }
+
+private:
+  vector<Node *> nodes_;
+};
 
-    // Add the row to the data vector
-    data.push_back(row);
+class WebotsEmitter : public WindowEmitter {
+public:
+  explicit WebotsEmitter(Emitter *emitter) : emitter_(emitter) {}
+  void send(int channel, const void *data, size_t size) override {
+    emitter_->setChannel(channel);
+    emitter_->send(data, (int)size);
   }
 
-  file.close();
-  return data;
-}
+private:
+  Emitter *emitter_;
+};
 
-// Function to calculate the distance between two points in 3D space
-double calculateDistance(const double *position1, const vector<double> &position2) {
-  return sqrt(pow(position1[0] - position2[0], 2) + pow(position1[1] - position2[1], 2));
-}
+class WebotsReceiver : public ResultReceiver {
+public:
+  explicit WebotsReceiver(Receiver *receiver) : receiver_(receiver) {}
+  size_t queueLength() const override { return (size_t)receiver_->getQueueLength(); }
+  const void *data() const override { return receiver_->getData(); }
+  size_t dataSize() const override { return (size_t)receiver_->getDataSize(); }
+  void nextPacket() override { receiver_->nextPacket(); }
 
-// Function to calculate attenuation based on distance
-double calculateAttenuation(double distance) {
-  return 1 / (1 + distance); // Example attenuation function
-}
+private:
+  Receiver *receiver_;
+};
 
 int main(int argc, char **argv) {
   // Create the Supervisor instance
   Supervisor *supervisor = new Supervisor();
 
-  // Initialize the emitter to send data to the robot
+  // Initialize the emitter to send data to the robots
   Emitter *emitter = supervisor->getEmitter("emitter");
 
-  // Initialize the receiver to get data from the robot
+  // Initialize the receiver to get data from the robots
   Receiver *receiver = supervisor->getReceiver("receiver");
   receiver->enable(supervisor->getBasicTimeStep());
 
-  // Import the robot node
+  // Get the time step of the current world
+  int timeStep = (int)supervisor->getBasicTimeStep();
+
+  // Capture playlist, end-of-data behaviour, robots and windows from the controller arguments:
+  //   [--stop | --loop | --next] [--robot-controller NAME] [--robots N | --fleet FILE]
+  //   [--window-length N] [--window-hop N] [--interpolate] [--attenuation-tolerance M]
+  //   [--field-resolution R] [--field-cache PREFIX] [--pose-period N]
+  //   [--sources FILE] [--calibration GX GY GZ OX OY OZ] [--capture-rate HZ] [--resample METHOD]
+  //   [--payload raw | features | both] [--feature-bands N] [--inference robots | supervisor] [--int8]
+  //   [--stats-period S] [--stats-file FILE] [--telemetry FILE] [--vibration-map MIB]
+  //   [--map-store FILE] [capture ...]
+  // Captures are text files or binary captures produced by tools/capture_converter. A fleet file
+  // lists one robot per line as "x y [channel] [delay]" (see fleet.hpp), a sources file one
+  // vibration source per line (see vibration_sources.hpp). Without a sources file, a single source
+  // at the origin plays the capture playlist. The calibration gains and offsets are applied per
+  // axis to every sample sent to the robots. The captures are resampled from their sample rate (the
+  // rate in the header of binary captures, --capture-rate for text captures) to the 60 Hz the CNN
+  // was trained on (see resampler.hpp), and every step plays the readings of its time span, so they
+  // play back in simulated time whatever the time step.
+  // A robot's gains are only looked up again when it changes grid cell or, with --interpolate, moves
+  // more than --attenuation-tolerance meters (0 by default: any move).
+  // The robot positions are read from the simulator every --pose-period steps (1 by default), and
+  // extrapolated from each robot's latest velocity in between (see pose_sampler.hpp).
+  // Window packets carry the raw samples, the window features (see window_features.hpp), or both.
+  // With --inference supervisor, the windows are not sent: the supervisor classifies all the windows
+  // completed at a step in one batched run of the CNN and keeps each robot's label; --int8 runs the
+  // int8 quantized model instead, calibrated on the first windows of the first capture, to see the
+  // labels the robots' microcontrollers would give (it is no faster than the float CNN here). When built
+  // with instrumentation, a summary of the step phases and window latencies is printed every
+  // --stats-period simulated seconds, and all of it is written to --stats-file at the end.
+  // Labels and events are written by a background thread to --telemetry, the standard output by
+  // default; a .csv or .bin file also gets the positions, attenuations and timings of every step.
+  // With --vibration-map, the captures are loaded and resampled up front into a vibration map (see
+  // vibration_map.hpp) instead of being streamed, and stored on the attenuation grid when that takes
+  // at most the given number of MiB. With --map-store, the vibration is read from a map precomputed
+  // by tools/vibration_map (see map_store.hpp), decompressing only the chunks the robots are in.
+  vector<string> playlist;
+  PipelineSettings settings;  // Windows, attenuation, resampling and payload, see supervisor_pipeline.hpp
+  settings.stepRate = 1000.0 / timeStep;
+  settings.arenaSize = kArenaSize;
+  string robotController = "e-puck_random_walk_CNN_inference";  // Or e-puck_random_walk_native_inference
+  size_t robotCount = 1;
+  string fleetFile;
+  string sourcesFile;
+  bool batchInference = false;
+  bool int8Inference = false;
+  double statsPeriod = 10.0;  // Simulated seconds between instrumentation summaries, 0 for none
+  string statsFile = "supervisor_stats.csv";
+  string telemetryFile = "-";
+  size_t posePeriod = 1;  // Steps between two reads of the robot positions
+  double vibrationMapSize = -1.0;  // MiB of the materialized vibration map, negative to stream the captures
+  string mapStoreFile;
+  for (int a = 1; a < argc; ++a) {
+    string argument = argv[a];
+    if (argument == "--robot-controller" && a + 1 < argc)
+      robotController = argv[++a];
+    else if (argument == "--robots" && a + 1 < argc)
+      parseOption(argument, argv[++a], robotCount);
+    else if (argument == "--fleet" && a + 1 < argc)
+      fleetFile = argv[++a];
+    else if (argument == "--interpolate")
+      settings.interpolate = true;
+    else if (argument == "--attenuation-tolerance" && a + 1 < argc)
+      parseOption(argument, argv[++a], settings.attenuationTolerance);
+    else if (argument == "--pose-period" && a + 1 < argc) {
+      if (parseOption(argument, argv[++a], posePeriod))
+        posePeriod = max<size_t>(1, posePeriod);
+    }
+    else if (argument == "--field-resolution" && a + 1 < argc)
+      parseOption(argument, argv[++a], settings.fieldResolution);
+    else if (argument == "--field-cache" && a + 1 < argc)
+      settings.fieldCache = argv[++a];
+    else if (argument == "--sources" && a + 1 < argc)
+      sourcesFile = argv[++a];
+    else if (argument == "--calibration" && a + 6 < argc) {
+      for (int axis = 0; axis < 3; ++axis)
+        parseOption(argument, argv[++a], settings.calibration.gain[axis]);
+      for (int axis = 0; axis < 3; ++axis)
+        parseOption(argument, argv[++a], settings.calibration.offset[axis]);
+    } else if (argument == "--capture-rate" && a + 1 < argc)
+      parseOption(argument, argv[++a], settings.captureRate);
+    else if (argument == "--resample" && a + 1 < argc) {
+      if (!parseResampleMethod(argv[++a], settings.resampleMethod))
+        cerr << "Error: Unknown resampling method " << argv[a] << endl;
+    } else if (argument == "--payload" && a + 1 < argc) {
+      string payload = argv[++a];
+      if (payload == "raw" || payload == "features" || payload == "both") {
+        settings.sendSamples = payload != "features";
+        settings.sendFeatures = payload != "raw";
+      } else {
+        cerr << "Error: Unknown payload " << payload << endl;
+      }
+    } else if (argument == "--inference" && a + 1 < argc) {
+      string inference = argv[++a];
+      if (inference == "robots" || inference == "supervisor")
+        batchInference = inference == "supervisor";
+      else
+        cerr << "Error: Unknown inference location " << inference << endl;
+    } else if (argument == "--int8")
+      int8Inference = true;
+    else if (argument == "--stats-period" && a + 1 < argc)
+      parseOption(argument, argv[++a], statsPeriod);
+    else if (argument == "--stats-file" && a + 1 < argc)
+      statsFile = argv[++a];
+    else if (argument == "--telemetry" && a + 1 < argc)
+      telemetryFile = argv[++a];
+    else if (argument == "--vibration-map" && a + 1 < argc)
+      parseOption(argument, argv[++a], vibrationMapSize);
+    else if (argument == "--map-store" && a + 1 < argc)
+      mapStoreFile = argv[++a];
+    else if (argument == "--feature-bands" && a + 1 < argc)
+      parseOption(argument, argv[++a], settings.featureBands);
+    else if (argument == "--window-length" && a + 1 < argc) {
+      // The window packet header counts the samples of a window in 16 bits
+      size_t windowLength = 0;
+      if (!parseOption(argument, argv[++a], windowLength))
+        continue;
+      if (windowLength > 0 && windowLength * 3 <= UINT16_MAX)
+        settings.windowLength = windowLength;
+      else
+        cerr << "Error: The window length must be between 1 and " << UINT16_MAX / 3 << " readings" << endl;
+    } else if (argument == "--window-hop" && a + 1 < argc) {
+      size_t windowHop = 0;
+      if (!parseOption(argument, argv[++a], windowHop))
+        continue;
+      if (windowHop > 0)
+        settings.windowHop = windowHop;
+      else
+        cerr << "Error: The window hop must be positive" << endl;
+    } else if (argument == "--stop")
+      settings.playbackEnd = PlaybackEnd::Stop;
+    else if (argument == "--loop")
+      settings.playbackEnd = PlaybackEnd::Loop;
+    else if (argument == "--next")
+      settings.playbackEnd = PlaybackEnd::NextFile;
+    else
+      playlist.push_back(argument);
+  }
+  if (playlist.empty())
+    playlist.push_back("data/capture1_60hz_30vol.txt");
+
+  // Robots of the fleet, from a fleet file or spread on a grid, a single robot at the origin by default
+  vector<RobotConfig> robots;
+  if (!fleetFile.empty()) {
+    string fleetError;
+    if (!loadFleetConfig(fleetFile, robots, kFirstRobotChannel, &fleetError))
+      cerr << "Error: " << fleetError << endl;
+  } else if (robotCount > 1) {
+    robots = gridFleet(robotCount, kArenaSize, kFirstRobotChannel);
+  }
+  if (robots.empty())
+    robots.push_back({0.0, 0.0, kFirstRobotChannel, 0});
+
+  // Import the robot nodes; each robot receives its windows on its own channel
   Node *rootNode = supervisor->getRoot();
   Field *childrenField = rootNode->getField("children");
-  childrenField->importMFNodeFromString(-1, "DEF E-PUCK E-puck { translation 0 0 0, controller \"e-puck_random_walk_CNN_inference\" }");
-  Node *epuckNode = supervisor->getFromDef("E-PUCK");
+  vector<Node *> robotNodes;
+  for (size_t k = 0; k < robots.size(); ++k) {
+    ostringstream robotNode;
+    robotNode << "DEF ROBOT_" << k << " E-puck { translation " << robots[k].x << " " << robots[k].y << " 0, name \"e-puck_" << k
+              << "\", controller \"" << robotController << "\", receiver_channel " << robots[k].channel << ", emitter_channel "
+              << kLabelChannel << " }";
+    childrenField->importMFNodeFromString(-1, robotNode.str());
+    robotNodes.push_back(supervisor->getFromDef("ROBOT_" + to_string(k)));
+  }
+  cout << "Spawned " << robots.size() << " robot(s)." << endl;
 
-  // Get the time step of the current world
-  int timeStep = (int)supervisor->getBasicTimeStep();
+  // Vibration sources, each with its own capture stream and propagation model
+  vector<VibrationSource> sources;
+  if (!sourcesFile.empty()) {
+    string sourcesError;
+    if (!loadSourceConfig(sourcesFile, sources, &sourcesError))
+      cerr << "Error: " << sourcesError << endl;
+  }
+  if (sources.empty()) {
+    VibrationSource source;  // Example source at the origin, attenuated by 1 / (1 + distance)
+    source.playlist = playlist;
+    sources.push_back(source);
+  }
 
-  // Path to the file containing accelerometer data
-  string filePath = "data/capture1_60hz_30vol.txt"; 
+  // Vibration map of the sources over the arena, held for the whole simulation; the captures are
+  // streamed if it cannot be built
+  if (!mapStoreFile.empty()) {
+    shared_ptr<MapStoreReader> store(new MapStoreReader());
+    string storeError;
+    if (store->open(mapStoreFile, &storeError)) {
+      const MapStoreLayout &layout = store->layout();
+      cout << "Reading the vibration map from " << mapStoreFile << ": " << layout.steps << " steps of " << layout.columns
+           << " x " << layout.rows << " nodes." << endl;
+      if (layout.stepRate != settings.readingRate)
+        cerr << "Warning: The map store has " << layout.stepRate << " steps per second, the windows "
+             << settings.readingRate << " readings per second" << endl;
+      settings.vibrationMap = store;
+    } else {
+      cerr << "Error: Could not open the map store (" << storeError << "), streaming the captures" << endl;
+    }
+  } else if (vibrationMapSize >= 0.0) {
+    shared_ptr<VibrationMap> map(new VibrationMap());
+    double half = kArenaSize / 2;
+    string mapError;
+    if (map->build(sources, -half, -half, kArenaSize, kArenaSize, settings.fieldResolution, settings.captureRate,
+                   settings.readingRate, settings.resampleMethod, settings.playbackEnd, settings.fieldCache, &mapError)) {
+      if (map->materialize((size_t)(vibrationMapSize * 1024 * 1024), &mapError))
+        cout << "Materialized the vibration map: " << map->steps() << " steps on the attenuation grid." << endl;
+      else if (vibrationMapSize > 0.0)
+        cout << "Computing the vibration map from the sources (" << mapError << ")." << endl;
+      if (map->skippedLines() > 0)
+        cerr << "Warning: Skipped " << map->skippedLines() << " malformed capture line(s)" << endl;
+      settings.vibrationMap = map;
+    } else {
+      cerr << "Error: Could not build the vibration map (" << mapError << "), streaming the captures" << endl;
+    }
+  }
 
-  // Read accelerometer data from file
-  vector<vector<double>> accelerometerData = readAccelerometerData(filePath);
+  // Playback, attenuation, windowing, inference and results of every step, see supervisor_pipeline.hpp
+  SupervisorPipeline pipeline(settings, robots, sources);
+  cout << "Playing back " << sources.size() << " vibration source(s), the first from " << sources[0].playlist[0] << ", at "
+       << captureSampleRate(sources[0].playlist[0], settings.captureRate) << " Hz resampled to " << settings.readingRate << " Hz, "
+       << settings.readingRate / settings.stepRate << " readings per step." << endl;
 
-  // Check if data was successfully read
-  if (!accelerometerData.empty()) {
-    cout << "Successfully read accelerometer data with " << accelerometerData.size() << " entries." << endl;
-  } else {
-    cout << "No data read from the file." << endl;
+  // Central inference: the CNN embedded in models/cnn_model.h, run on the batch of windows of each step
+  if (batchInference) {
+    string modelError;
+    if (!pipeline.loadModel(autoencoder_model, autoencoder_model_len, &modelError))
+      cerr << "Error: Could not load the embedded CNN model (" << modelError << "), sending the windows to the robots" << endl;
   }
 
-  // Vibration source position
-  vector<double> vibrationSource = {0.0, 0.0, 0.0}; // Example source coordinates
+  // int8 variant of the model, calibrated on resampled and attenuated windows of the first capture of
+  // the first source; the float model is kept if the capture cannot be read
+  if (pipeline.centralInference() && int8Inference) {
+    string quantizeError;
+    if (pipeline.quantizeModel(kInt8CalibrationWindows, &quantizeError))
+      cout << "Running the int8 CNN (" << pipeline.quantizedModel().parameterBytes() << " bytes of parameters)." << endl;
+    else
+      cerr << "Error: Could not quantize the CNN model (" << quantizeError << "), running the float model" << endl;
+  }
+  if (pipeline.centralInference())
+    cout << "Classifying the windows of the " << robots.size() << " robot(s) in the supervisor." << endl;
+  else
+    cout << "Sending " << pipeline.sampleCount() << " samples and " << pipeline.featureCount() << " features per window."
+         << endl;
+
+  // Telemetry, queued without blocking the step and written by a background thread. The queue holds
+  // the records of at least 16 steps, beyond which the writer is too slow and records are dropped.
+  TelemetryFormat telemetryFormat = telemetryFormatFor(telemetryFile);
+  bool stepTelemetry = telemetryFormat != TelemetryFormat::Text;  // Positions, attenuations and timings
+  TelemetrySink telemetry(max<size_t>(65536, 16 * (robots.size() * (1 + sources.size()) + 2)));
+  string telemetryError;
+  if (!telemetry.open(telemetryFile, telemetryFormat, &telemetryError)) {
+    cerr << "Error: Could not open the telemetry (" << telemetryError << "), writing the labels to the standard output" << endl;
+    stepTelemetry = false;
+    telemetry.open("-", TelemetryFormat::Text);
+  }
+  pipeline.setTelemetry(&telemetry, stepTelemetry);
+  uint32_t step = 0;
+  chrono::steady_clock::time_point stepEnd = chrono::steady_clock::now();
+
+  // Instrumentation: wall time of the simulation step and of the controller step, besides the phases
+  // and window latencies recorded by the pipeline
+  Metrics &metrics = pipeline.metrics();
+  Histogram &simulationTime = metrics.histogram("simulation", "ns");  // Inside supervisor->step()
+  Histogram &stepTime = metrics.histogram("step", "ns");              // The rest of the loop
+  PhaseClock simulationClock, stepClock;
+  PhaseClock::Clock::time_point wallStart = PhaseClock::Clock::now();
+  double nextSummary = statsPeriod;
+  if (kInstrumentationEnabled)
+    cout << "Instrumentation enabled, writing " << statsFile << " at the end of the simulation." << endl;
+
+  // The simulator, as seen by the pipeline
+  WebotsPoses webotsPoses(robotNodes, timeStep * (int)posePeriod);
+  PoseSampler poses(webotsPoses, robotNodes.size(), posePeriod, kArenaSize / 2);
+  WebotsEmitter windowEmitter(emitter);
+  WebotsReceiver resultReceiver(receiver);
 
   // Main loop: perform simulation steps until Webots stops the controller
-  size_t i = 0;
-  vector<string> accumulatedData;  // To accumulate 24 readings
-  
+  simulationClock.start();
   while (supervisor->step(timeStep) != -1) {
-    // Get robot position
-    const double *position = epuckNode->getPosition();
-    double coordinates[2];
-    coordinates[0] = floor(position[0]);
-    coordinates[1] = floor(position[1]);
-
-    // Calculate attenuation based on distance from the vibration source
-    double distance = calculateDistance(coordinates, vibrationSource);
-    double attenuation = calculateAttenuation(distance);
-    
-    //cout << "Robot position: " << position[0] << " " << position[1] << " " << position[2] << endl;
-    //cout << "Closest rounded point: " << coordinates[0] << " " << coordinates[1] << endl;
-
-    // Calculate and print attenuated accelerometer data at the current step
-    if (i < accelerometerData.size()) {
-       double attenuatedX = accelerometerData[i][0] * attenuation;
-       double attenuatedY = accelerometerData[i][1] * attenuation;
-       double attenuatedZ = accelerometerData[i][2] * attenuation;
-       
-       // Convert the attenuated values to a comma-separated string
-       ostringstream dataStream;
-       dataStream << attenuatedX << "," << attenuatedY << "," << attenuatedZ;
-       accumulatedData.push_back(dataStream.str());
-       
-       // If we have accumulated 24 readings, send them to the robot
-       if (accumulatedData.size() == 24) {
-            // Join all 24 readings into a single string with a semicolon separator
-            ostringstream finalDataStream;
-            for (size_t j = 0; j < accumulatedData.size(); ++j) {
-                finalDataStream << accumulatedData[j];
-                if (j < accumulatedData.size() - 1) {
-                    finalDataStream << ";";  // Separate each reading with a semicolon
-                }
-            }
-       
-            string finalDataString = finalDataStream.str();
-        
-            // Send the string data to the robot using the emitter
-            emitter->send(finalDataString.c_str(), finalDataString.length() + 1);  // +1 to include the null terminator
-            
-            // Clear the accumulated data
-            accumulatedData.clear();   
-            
-            // Debug output
-            //cout << "Sent 24 readings: " << finalDataString << endl;
-        }
-    } else {
-        cout << "Out of data" << endl;
-    }
+    simulationClock.lap(simulationTime);
+    stepClock.start();
+    chrono::steady_clock::time_point stepStart = chrono::steady_clock::now();
 
-    // Increment the data index
-    i++;
+    // Report unreadable files and malformed lines met by the playback threads
+    for (const CapturePlaybackError &error : pipeline.takePlaybackErrors()) {
+      if (error.line == 0)
+        cerr << "Error: " << error.filename << ": " << error.message << endl;
+      else
+        cerr << error.filename << ":" << error.line << ": " << error.message << endl;
+    }
 
-    // Receiving classification label from robot
-    if (receiver->getQueueLength() > 0) {
-      // Get the classification label sent from the robot
-      const char* received_data = (const char*)receiver->getData();
-      int classification_label = *(int*)received_data;  // Assuming the robot sends an integer
+    pipeline.step(supervisor->getTime(), poses, windowEmitter, resultReceiver);
+    stepClock.lap(stepTime);
 
-      // Print the classification label for debug
-      cout << "Received classification label from robot: " << classification_label << endl;
+    if (stepTelemetry) {
+      chrono::steady_clock::time_point now = chrono::steady_clock::now();
+      telemetry.timing(supervisor->getTime(), step, chrono::duration<float, micro>(stepStart - stepEnd).count(),
+                       chrono::duration<float, micro>(now - stepStart).count(), pipeline.stepWindows(),
+                       pipeline.pendingWindows().inFlight());
+      stepEnd = now;
+    }
+    ++step;
 
-      // Clear the receiver queue
-      receiver->nextPacket();
+    if (kInstrumentationEnabled && statsPeriod > 0.0 && supervisor->getTime() >= nextSummary) {
+      double wallSeconds = chrono::duration<double>(PhaseClock::Clock::now() - wallStart).count();
+      cout << "Instrumentation at " << supervisor->getTime() << " s simulated, " << wallSeconds << " s wall-clock ("
+           << pipeline.pendingWindows().dropped() << " windows without a result):" << endl;
+      metrics.printSummary(cout, wallSeconds);
+      nextSummary += statsPeriod;
     }
+    simulationClock.start();
   }
-  
+
+  // Write out the queued telemetry
+  telemetry.close();
+  if (telemetry.dropped() > 0)
+    cerr << "Warning: " << telemetry.dropped() << " telemetry records were dropped, the writer could not keep up" << endl;
+
+  // Dump the instrumentation, as the simulation ends
+  if (kInstrumentationEnabled) {
+    double wallSeconds = chrono::duration<double>(PhaseClock::Clock::now() - wallStart).count();
+    metrics.printSummary(cout, wallSeconds);
+    if (!metrics.writeCsv(statsFile, wallSeconds))
+      cerr << "Error: Could not write " << statsFile << endl;
+  }
+
   // Cleanup
   delete emitter;
   delete receiver;
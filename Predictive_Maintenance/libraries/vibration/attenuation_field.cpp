@@ -0,0 +1,104 @@
+// File: attenuation_field.cpp
+// Description: Grid construction, bilinear lookup and binary cache of AttenuationField.
+
+#include "attenuation_field.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+// Binary cache header, followed by rows * columns float32 values
+struct AttenuationFieldHeader {
+  char magic[4];  // "PMAF"
+  uint32_t version;
+  uint64_t signature;
+  double minX, minY, resolution;
+  uint32_t columns, rows;
+};
+
+static const char kFieldMagic[4] = {'P', 'M', 'A', 'F'};
+static const uint32_t kFieldVersion = 1;
+
+static size_t nodeCount(double size, double resolution) {
+  return (size_t)llround(size * resolution) + 1;
+}
+
+void AttenuationField::build(double minX, double minY, double width, double height, double resolution,
+                             const function<float(double x, double y)> &model, uint64_t signature) {
+  minX_ = minX;
+  minY_ = minY;
+  resolution_ = resolution > 0.0 ? resolution : 1.0;
+  nx_ = nodeCount(width, resolution_);
+  ny_ = nodeCount(height, resolution_);
+  signature_ = signature;
+
+  values_.resize(nx_ * ny_);
+  for (size_t j = 0; j < ny_; ++j)
+    for (size_t i = 0; i < nx_; ++i)
+      values_[index(i, j)] = model(minX_ + i / resolution_, minY_ + j / resolution_);
+}
+
+float AttenuationField::bilinear(double x, double y) const {
+  double u = (x - minX_) * resolution_;
+  double v = (y - minY_) * resolution_;
+  u = u < 0.0 ? 0.0 : u > nx_ - 1 ? nx_ - 1 : u;
+  v = v < 0.0 ? 0.0 : v > ny_ - 1 ? ny_ - 1 : v;
+
+  size_t i = (size_t)u, j = (size_t)v;
+  size_t i1 = i + 1 < nx_ ? i + 1 : i;
+  size_t j1 = j + 1 < ny_ ? j + 1 : j;
+  float fu = (float)(u - i), fv = (float)(v - j);
+
+  float bottom = values_[index(i, j)] + fu * (values_[index(i1, j)] - values_[index(i, j)]);
+  float top = values_[index(i, j1)] + fu * (values_[index(i1, j1)] - values_[index(i, j1)]);
+  return bottom + fv * (top - bottom);
+}
+
+bool AttenuationField::save(const string &filename) const {
+  FILE *file = fopen(filename.c_str(), "wb");
+  if (!file)
+    return false;
+
+  AttenuationFieldHeader header = {};
+  memcpy(header.magic, kFieldMagic, sizeof(header.magic));
+  header.version = kFieldVersion;
+  header.signature = signature_;
+  header.minX = minX_;
+  header.minY = minY_;
+  header.resolution = resolution_;
+  header.columns = (uint32_t)nx_;
+  header.rows = (uint32_t)ny_;
+
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+            fwrite(values_.data(), sizeof(float), values_.size(), file) == values_.size();
+  return fclose(file) == 0 && ok;
+}
+
+bool AttenuationField::load(const string &filename, double minX, double minY, double width, double height,
+                            double resolution, uint64_t signature) {
+  FILE *file = fopen(filename.c_str(), "rb");
+  if (!file)
+    return false;
+
+  AttenuationFieldHeader header;
+  bool ok = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, kFieldMagic, 4) == 0 &&
+            header.version == kFieldVersion && header.signature == signature && header.minX == minX &&
+            header.minY == minY && header.resolution == resolution && header.columns == nodeCount(width, resolution) &&
+            header.rows == nodeCount(height, resolution);
+  if (ok) {
+    vector<float> values((size_t)header.columns * header.rows);
+    ok = fread(values.data(), sizeof(float), values.size(), file) == values.size();
+    if (ok) {
+      minX_ = minX;
+      minY_ = minY;
+      resolution_ = resolution;
+      nx_ = header.columns;
+      ny_ = header.rows;
+      signature_ = signature;
+      values_.swap(values);
+    }
+  }
+  fclose(file);
+  return ok;
+}
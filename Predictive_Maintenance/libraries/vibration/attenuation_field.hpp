@@ -0,0 +1,62 @@
+// File: attenuation_field.hpp
+// Description: Attenuation precomputed on a dense grid over the arena floor. Built once, then shared
+// read-only by every robot, so that a robot's attenuation is a single table lookup per step.
+
+#ifndef ATTENUATION_FIELD_HPP
+#define ATTENUATION_FIELD_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+class AttenuationField {
+public:
+  // Sample model(x, y) on grid nodes every 1 / resolution meters over the rectangle starting at
+  // (minX, minY). signature identifies the model, so that a cache of another model is not reused.
+  void build(double minX, double minY, double width, double height, double resolution,
+             const std::function<float(double x, double y)> &model, uint64_t signature = 0);
+
+  // Attenuation at the grid node below and left of (x, y), as with floor()ed coordinates
+  float nearest(double x, double y) const {
+    return values_[index(cellIndex(x, minX_, nx_), cellIndex(y, minY_, ny_))];
+  }
+
+  // Bilinear interpolation between the four grid nodes around (x, y)
+  float bilinear(double x, double y) const;
+
+  float sample(double x, double y, bool interpolate) const { return interpolate ? bilinear(x, y) : nearest(x, y); }
+
+  // Binary cache of the grid. load() fails if the file does not match the given geometry and signature.
+  bool save(const std::string &filename) const;
+  bool load(const std::string &filename, double minX, double minY, double width, double height, double resolution,
+            uint64_t signature);
+
+  bool empty() const { return values_.empty(); }
+  size_t columns() const { return nx_; }
+  size_t rows() const { return ny_; }
+  double minX() const { return minX_; }
+  double minY() const { return minY_; }
+  double resolution() const { return resolution_; }
+
+  // Grid node below and left of a coordinate, clamped to the grid, and the attenuation at a node
+  size_t nodeColumn(double x) const { return cellIndex(x, minX_, nx_); }
+  size_t nodeRow(double y) const { return cellIndex(y, minY_, ny_); }
+  float node(size_t i, size_t j) const { return values_[index(i, j)]; }
+
+private:
+  size_t index(size_t i, size_t j) const { return j * nx_ + i; }
+  size_t cellIndex(double coordinate, double origin, size_t nodes) const {
+    double cell = std::floor((coordinate - origin) * resolution_);
+    return cell <= 0.0 ? 0 : cell >= nodes - 1 ? nodes - 1 : (size_t)cell;
+  }
+
+  double minX_ = 0.0, minY_ = 0.0;
+  double resolution_ = 1.0;
+  size_t nx_ = 0, ny_ = 0;
+  uint64_t signature_ = 0;
+  std::vector<float> values_;  // Row-major, ny_ rows of nx_ nodes
+};
+
+#endif  // ATTENUATION_FIELD_HPP
@@ -0,0 +1,102 @@
+// File: capture.cpp
+// Description: Zero-copy text capture loader. The file is memory-mapped and parsed in a single
+// pass straight into the CaptureData buffer, without per-line allocations.
+
+#include "capture.hpp"
+#include "mapped_file.hpp"
+
+#include <charconv>
+#include <cstring>
+
+using namespace std;
+
+void CaptureData::resize(size_t rows) {
+  // The three axes share one allocation, so growing moves y and z to their new offsets
+  vector<float> buffer(3 * rows);
+  size_t kept = rows < rows_ ? rows : rows_;
+  for (size_t axis = 0; axis < 3; ++axis)
+    memcpy(buffer.data() + axis * rows, buffer_.data() + axis * capacity_, kept * sizeof(float));
+  buffer_.swap(buffer);
+  rows_ = rows;
+  capacity_ = rows;
+}
+
+const char *parseCaptureLine(const char *begin, const char *end, float values[3]) {
+  const char *p = begin;
+  for (int axis = 0; axis < 3; ++axis) {
+    if (axis > 0) {
+      if (p == end || *p != '\t')
+        return axis == 1 ? "expected 3 values, found 1" : "expected 3 values, found 2";
+      ++p;
+    }
+    // from_chars does not accept a leading '+'
+    if (p != end && *p == '+')
+      ++p;
+    from_chars_result result = from_chars(p, end, values[axis]);
+    if (result.ec != errc())
+      return "invalid number";
+    p = result.ptr;
+  }
+  if (p != end)
+    return *p == '\t' ? "more than 3 values" : "invalid number";
+  return nullptr;
+}
+
+void CaptureLoadReport::add(size_t line, const char *message) {
+  skippedLines++;
+  if (errors.size() < kMaxReportedErrors)
+    errors.push_back({line, message});
+}
+
+bool loadCaptureText(const string &filename, CaptureData &data, CaptureLoadReport *report) {
+  data.clear();
+  if (report)
+    *report = CaptureLoadReport();
+
+  MappedFile file;
+  if (!file.open(filename))
+    return false;
+
+  const char *p = file.data();
+  const char *end = p + file.size();
+
+  // Size the buffer once from the number of lines, which is an upper bound on the row count
+  size_t lines = 0;
+  for (const char *q = p; q < end; ++lines) {
+    const char *newline = (const char *)memchr(q, '\n', end - q);
+    q = newline ? newline + 1 : end;
+  }
+  data.buffer_.resize(3 * lines);
+  data.capacity_ = lines;
+
+  float *x = data.x(), *y = data.y(), *z = data.z();
+  size_t rows = 0;
+  size_t lineNumber = 0;
+  while (p < end) {
+    const char *newline = (const char *)memchr(p, '\n', end - p);
+    const char *lineEnd = newline ? newline : end;
+    ++lineNumber;
+
+    const char *contentEnd = lineEnd;
+    if (contentEnd > p && contentEnd[-1] == '\r')
+      --contentEnd;
+
+    // Blank lines (typically a trailing newline) are not an error
+    if (contentEnd > p) {
+      float values[3];
+      const char *error = parseCaptureLine(p, contentEnd, values);
+      if (error) {
+        if (report)
+          report->add(lineNumber, error);
+      } else {
+        x[rows] = values[0];
+        y[rows] = values[1];
+        z[rows] = values[2];
+        ++rows;
+      }
+    }
+    p = newline ? newline + 1 : end;
+  }
+  data.rows_ = rows;
+  return true;
+}
@@ -0,0 +1,59 @@
+// File: capture.hpp
+// Description: Accelerometer capture stored as structure-of-arrays, and the text capture loader.
+
+#ifndef CAPTURE_HPP
+#define CAPTURE_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct CaptureLoadReport;
+
+// x, y and z samples of a capture, stored back to back in a single buffer
+class CaptureData {
+public:
+  void resize(size_t rows);
+  void clear() { resize(0); }
+
+  size_t size() const { return rows_; }
+  bool empty() const { return rows_ == 0; }
+
+  float *x() { return buffer_.data(); }
+  float *y() { return buffer_.data() + capacity_; }
+  float *z() { return buffer_.data() + 2 * capacity_; }
+  const float *x() const { return buffer_.data(); }
+  const float *y() const { return buffer_.data() + capacity_; }
+  const float *z() const { return buffer_.data() + 2 * capacity_; }
+
+private:
+  friend bool loadCaptureText(const std::string &, CaptureData &, CaptureLoadReport *);
+
+  std::vector<float> buffer_;
+  size_t rows_ = 0;
+  size_t capacity_ = 0;
+};
+
+// A line of the capture file that could not be parsed
+struct CaptureParseError {
+  size_t line;  // 1-based line number in the file
+  std::string message;
+};
+
+struct CaptureLoadReport {
+  size_t skippedLines = 0;                 // Malformed lines that were not loaded
+  std::vector<CaptureParseError> errors;  // The first kMaxReportedErrors of them
+  static const size_t kMaxReportedErrors = 100;
+
+  void add(size_t line, const char *message);
+};
+
+// Parse one "x<TAB>y<TAB>z" line (without its line terminator) into values.
+// Returns nullptr on success, or a description of the problem.
+const char *parseCaptureLine(const char *begin, const char *end, float values[3]);
+
+// Load a tab-separated "x<TAB>y<TAB>z" capture. Malformed lines are skipped and reported
+// in the optional report. Returns false only when the file cannot be read.
+bool loadCaptureText(const std::string &filename, CaptureData &data, CaptureLoadReport *report = nullptr);
+
+#endif  // CAPTURE_HPP
@@ -0,0 +1,229 @@
+// File: capture_file.cpp
+// Description: Binary capture writer and the streaming capture reader.
+
+#include "capture_file.hpp"
+
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+const char kCaptureFileMagic[4] = {'P', 'M', 'V', 'C'};
+
+static size_t sampleSize(uint16_t sampleType) {
+  return sampleType == (uint16_t)CaptureSampleType::Int16 ? sizeof(int16_t) : sizeof(float);
+}
+
+static bool validHeader(const CaptureFileHeader &header, string *error) {
+  const char *problem = nullptr;
+  if (memcmp(header.magic, kCaptureFileMagic, sizeof(header.magic)) != 0)
+    problem = "not a binary capture";
+  else if (header.version != kCaptureFileVersion)
+    problem = "unsupported binary capture version";
+  else if (header.sampleType != (uint16_t)CaptureSampleType::Float32 && header.sampleType != (uint16_t)CaptureSampleType::Int16)
+    problem = "unknown sample type";
+  else if (header.axisCount != 3)
+    problem = "only 3-axis captures are supported";
+  if (problem && error)
+    *error = problem;
+  return problem == nullptr;
+}
+
+bool isBinaryCapture(const string &filename) {
+  FILE *file = fopen(filename.c_str(), "rb");
+  if (!file)
+    return false;
+  char magic[4];
+  bool binary = fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, kCaptureFileMagic, sizeof(magic)) == 0;
+  fclose(file);
+  return binary;
+}
+
+// CaptureWriter
+
+CaptureWriter::~CaptureWriter() {
+  close();
+}
+
+bool CaptureWriter::open(const string &filename, CaptureSampleType type, float sampleRate, float scale) {
+  close();
+  file_ = fopen(filename.c_str(), "wb");
+  if (!file_)
+    return false;
+
+  header_ = CaptureFileHeader();
+  memcpy(header_.magic, kCaptureFileMagic, sizeof(header_.magic));
+  header_.version = kCaptureFileVersion;
+  header_.sampleType = (uint16_t)type;
+  header_.axisCount = 3;
+  header_.sampleRate = sampleRate;
+  header_.scale = type == CaptureSampleType::Float32 ? 1.0f : scale;
+  return fwrite(&header_, sizeof(header_), 1, file_) == 1;
+}
+
+bool CaptureWriter::write(const float *x, const float *y, const float *z, size_t rows) {
+  if (!file_)
+    return false;
+
+  const float *axes[3] = {x, y, z};
+  staging_.resize(rows * 3 * sampleSize(header_.sampleType));
+  if (header_.sampleType == (uint16_t)CaptureSampleType::Float32) {
+    float *out = (float *)staging_.data();
+    for (size_t i = 0; i < rows; ++i)
+      for (int axis = 0; axis < 3; ++axis)
+        *out++ = axes[axis][i];
+  } else {
+    int16_t *out = (int16_t *)staging_.data();
+    float inverseScale = 1.0f / header_.scale;
+    for (size_t i = 0; i < rows; ++i)
+      for (int axis = 0; axis < 3; ++axis) {
+        float raw = nearbyintf(axes[axis][i] * inverseScale);
+        *out++ = (int16_t)(raw > 32767.0f ? 32767.0f : raw < -32768.0f ? -32768.0f : raw);
+      }
+  }
+  header_.rowCount += rows;
+  return fwrite(staging_.data(), 1, staging_.size(), file_) == staging_.size();
+}
+
+bool CaptureWriter::close() {
+  if (!file_)
+    return true;
+  bool ok = fseek(file_, 0, SEEK_SET) == 0 && fwrite(&header_, sizeof(header_), 1, file_) == 1;
+  ok = fclose(file_) == 0 && ok;
+  file_ = nullptr;
+  return ok;
+}
+
+// CaptureReader
+
+CaptureReader::~CaptureReader() {
+  close();
+}
+
+bool CaptureReader::open(const string &filename, string *error) {
+  close();
+  filename_ = filename;
+
+  if (isBinaryCapture(filename)) {
+    file_ = fopen(filename.c_str(), "rb");
+    if (!file_ || fread(&header_, sizeof(header_), 1, file_) != 1 || !validHeader(header_, error)) {
+      if (error && error->empty())
+        *error = "truncated binary capture header";
+      close();
+      return false;
+    }
+    format_ = CaptureFormat::Binary;
+    return true;
+  }
+
+  if (!text_.open(filename)) {
+    if (error)
+      *error = "could not open the file";
+    return false;
+  }
+  format_ = CaptureFormat::Text;
+  cursor_ = text_.data();
+  return true;
+}
+
+void CaptureReader::close() {
+  if (file_)
+    fclose(file_);
+  file_ = nullptr;
+  text_.close();
+  cursor_ = nullptr;
+  lineNumber_ = 0;
+  rowsRead_ = 0;
+  header_ = CaptureFileHeader();
+  report_ = CaptureLoadReport();
+  error_.clear();
+}
+
+bool CaptureReader::rewind() {
+  if (format_ == CaptureFormat::Binary) {
+    if (!file_ || fseek(file_, sizeof(CaptureFileHeader), SEEK_SET) != 0)
+      return false;
+    rowsRead_ = 0;
+    error_.clear();
+    return true;
+  }
+  if (!text_.isOpen())
+    return false;
+  cursor_ = text_.data();
+  lineNumber_ = 0;
+  report_ = CaptureLoadReport();
+  return true;
+}
+
+size_t CaptureReader::read(float *x, float *y, float *z, size_t maxRows) {
+  size_t rows = 0;
+
+  if (format_ == CaptureFormat::Binary) {
+    if (!file_ || !error_.empty())
+      return 0;
+    uint64_t remaining = header_.rowCount - rowsRead_;
+    size_t wanted = remaining < maxRows ? (size_t)remaining : maxRows;
+    size_t rowSize = 3 * sampleSize(header_.sampleType);
+    staging_.resize(wanted * rowSize);
+    rows = fread(staging_.data(), rowSize, wanted, file_);
+    if (rows < wanted) {
+      if (ferror(file_))
+        error_ = "read error after row " + to_string(rowsRead_ + rows);
+      else
+        error_ = "truncated binary capture: " + to_string(rowsRead_ + rows) + " of " + to_string(header_.rowCount) +
+                 " rows";
+    }
+
+    if (header_.sampleType == (uint16_t)CaptureSampleType::Float32) {
+      const float *in = (const float *)staging_.data();
+      for (size_t i = 0; i < rows; ++i, in += 3) {
+        x[i] = in[0];
+        y[i] = in[1];
+        z[i] = in[2];
+      }
+    } else {
+      const int16_t *in = (const int16_t *)staging_.data();
+      float scale = header_.scale;
+      for (size_t i = 0; i < rows; ++i, in += 3) {
+        x[i] = in[0] * scale;
+        y[i] = in[1] * scale;
+        z[i] = in[2] * scale;
+      }
+    }
+    rowsRead_ += rows;
+    return rows;
+  }
+
+  const char *end = text_.data() + text_.size();
+  while (rows < maxRows && cursor_ && cursor_ < end) {
+    const char *newline = (const char *)memchr(cursor_, '\n', end - cursor_);
+    const char *lineEnd = newline ? newline : end;
+    ++lineNumber_;
+
+    const char *contentEnd = lineEnd;
+    if (contentEnd > cursor_ && contentEnd[-1] == '\r')
+      --contentEnd;
+
+    if (contentEnd > cursor_) {
+      float values[3];
+      const char *problem = parseCaptureLine(cursor_, contentEnd, values);
+      if (problem)
+        report_.add(lineNumber_, problem);
+      else {
+        x[rows] = values[0];
+        y[rows] = values[1];
+        z[rows] = values[2];
+        ++rows;
+      }
+    }
+    cursor_ = newline ? newline + 1 : end;
+  }
+  return rows;
+}
+
+double captureSampleRate(const string &filename, double fallback) {
+  CaptureReader reader;
+  if (!isBinaryCapture(filename) || !reader.open(filename) || !(reader.sampleRate() > 0.0f))
+    return fallback;
+  return reader.sampleRate();
+}
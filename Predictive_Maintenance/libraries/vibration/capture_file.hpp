@@ -0,0 +1,105 @@
+// File: capture_file.hpp
+// Description: Versioned binary capture format, its writer, and a streaming reader that accepts
+// both the binary format and the original tab-separated text captures.
+//
+// Binary layout (little-endian):
+//   CaptureFileHeader (32 bytes)
+//   rowCount rows of axisCount interleaved samples, each a float32 or an int16 fixed-point value
+//   (physical value = raw * scale)
+
+#ifndef CAPTURE_FILE_HPP
+#define CAPTURE_FILE_HPP
+
+#include "capture.hpp"
+#include "mapped_file.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+enum class CaptureSampleType : uint16_t { Float32 = 1, Int16 = 2 };
+
+struct CaptureFileHeader {
+  char magic[4];           // "PMVC"
+  uint16_t version;        // kCaptureFileVersion
+  uint16_t sampleType;     // CaptureSampleType
+  uint32_t axisCount;      // Always 3 (x, y, z) for now
+  float sampleRate;        // Hz, 0 if unknown
+  float scale;             // Fixed-point scale, 1 for float32 samples
+  uint32_t reserved;
+  uint64_t rowCount;
+};
+static_assert(sizeof(CaptureFileHeader) == 32, "CaptureFileHeader must stay 32 bytes");
+
+extern const char kCaptureFileMagic[4];
+const uint16_t kCaptureFileVersion = 1;
+
+// Writes a binary capture chunk by chunk; the row count is patched into the header on close()
+class CaptureWriter {
+public:
+  ~CaptureWriter();
+
+  bool open(const std::string &filename, CaptureSampleType type, float sampleRate, float scale = 1.0f);
+  bool write(const float *x, const float *y, const float *z, size_t rows);
+  bool close();
+
+private:
+  FILE *file_ = nullptr;
+  CaptureFileHeader header_ = {};
+  std::vector<char> staging_;
+};
+
+enum class CaptureFormat { Text, Binary };
+
+// Reads a capture in chunks of rows, so that a capture never has to fit in memory
+class CaptureReader {
+public:
+  ~CaptureReader();
+
+  // Open a capture, detecting the binary format from its header and falling back to text
+  bool open(const std::string &filename, std::string *error = nullptr);
+  void close();
+
+  // Read up to maxRows rows into x, y and z; returns the number of rows read, 0 at the end or after
+  // an error
+  size_t read(float *x, float *y, float *z, size_t maxRows);
+  bool rewind();
+
+  CaptureFormat format() const { return format_; }
+  float sampleRate() const { return header_.sampleRate; }
+  uint64_t rowCount() const { return header_.rowCount; }  // 0 for text captures, whose length is unknown
+  const std::string &filename() const { return filename_; }
+
+  // Malformed lines skipped so far (text captures only)
+  const CaptureLoadReport &report() const { return report_; }
+  // Why reading stopped before the end of the capture, empty if it did not: a binary capture with
+  // fewer rows than its header says, or a read error
+  const std::string &error() const { return error_; }
+
+private:
+  std::string filename_;
+  CaptureFormat format_ = CaptureFormat::Text;
+  CaptureFileHeader header_ = {};
+  CaptureLoadReport report_;
+  std::string error_;
+
+  // Text captures
+  MappedFile text_;
+  const char *cursor_ = nullptr;
+  size_t lineNumber_ = 0;
+
+  // Binary captures
+  FILE *file_ = nullptr;
+  uint64_t rowsRead_ = 0;
+  std::vector<char> staging_;
+};
+
+// Function to check whether a file starts with a binary capture header
+bool isBinaryCapture(const std::string &filename);
+
+// Sample rate of a capture: the rate of its binary header, or `fallback` for text captures, binary
+// captures written without a rate (0) and unreadable files
+double captureSampleRate(const std::string &filename, double fallback);
+
+#endif  // CAPTURE_FILE_HPP
@@ -0,0 +1,162 @@
+// File: capture_playback.cpp
+// Description: Reader thread and ring buffer behind CapturePlayback.
+
+#include "capture_playback.hpp"
+#include "capture_file.hpp"
+
+#include <chrono>
+
+using namespace std;
+
+static size_t roundUpToPowerOfTwo(size_t value) {
+  size_t power = 1;
+  while (power < value)
+    power <<= 1;
+  return power;
+}
+
+CapturePlayback::CapturePlayback(size_t capacity, size_t chunkRows) :
+  capacity_(roundUpToPowerOfTwo(capacity < 2 ? 2 : capacity)),
+  mask_(capacity_ - 1),
+  chunkRows_(chunkRows == 0 ? 1 : chunkRows < capacity_ ? chunkRows : capacity_) {
+  ring_.resize(capacity_);
+}
+
+CapturePlayback::~CapturePlayback() {
+  stop();
+}
+
+bool CapturePlayback::start(const vector<string> &playlist, PlaybackEnd end) {
+  if (playlist.empty() || reader_.joinable())
+    return false;
+
+  playlist_ = playlist;
+  end_ = end;
+  head_.store(0, memory_order_relaxed);
+  tail_.store(0, memory_order_relaxed);
+  stopping_.store(false, memory_order_relaxed);
+  finished_.store(false, memory_order_release);
+  reader_ = thread(&CapturePlayback::readerLoop, this);
+  return true;
+}
+
+void CapturePlayback::stop() {
+  if (!reader_.joinable())
+    return;
+  {
+    lock_guard<mutex> lock(wakeMutex_);
+    stopping_.store(true, memory_order_relaxed);
+  }
+  wake_.notify_one();
+  reader_.join();
+}
+
+size_t CapturePlayback::available() const {
+  return head_.load(memory_order_acquire) - tail_.load(memory_order_relaxed);
+}
+
+bool CapturePlayback::next(float &x, float &y, float &z) {
+  size_t tail = tail_.load(memory_order_relaxed);
+  while (head_.load(memory_order_acquire) == tail) {
+    // The final head_ is published before finished_, so re-check it once finished
+    if (finished_.load(memory_order_acquire)) {
+      if (head_.load(memory_order_acquire) == tail)
+        return false;
+      break;
+    }
+    this_thread::yield();
+  }
+
+  size_t slot = tail & mask_;
+  x = ring_.x()[slot];
+  y = ring_.y()[slot];
+  z = ring_.z()[slot];
+  tail_.store(tail + 1, memory_order_release);
+
+  // Wake the reader thread once a whole chunk of space is free again
+  if (capacity_ - (head_.load(memory_order_relaxed) - tail - 1) == chunkRows_)
+    wake_.notify_one();
+  return true;
+}
+
+vector<CapturePlaybackError> CapturePlayback::takeErrors() {
+  lock_guard<mutex> lock(errorMutex_);
+  vector<CapturePlaybackError> errors;
+  errors.swap(errors_);
+  return errors;
+}
+
+void CapturePlayback::pushError(const string &filename, size_t line, const string &message) {
+  lock_guard<mutex> lock(errorMutex_);
+  errors_.push_back({filename, line, message});
+}
+
+void CapturePlayback::readerLoop() {
+  CaptureReader reader;
+  size_t fileIndex = 0;
+  size_t passRows = 0;        // Rows read since the current file was opened or rewound
+  size_t emptyPasses = 0;     // Consecutive files that could not be opened or had no rows
+  size_t reportedErrors = 0;
+  bool replaying = false;     // Malformed lines are only reported on the first pass
+  bool open = false;
+
+  while (!stopping_.load(memory_order_relaxed)) {
+    if (!open) {
+      string error;
+      open = reader.open(playlist_[fileIndex], &error);
+      passRows = 0;
+      reportedErrors = 0;
+      if (!open) {
+        if (!replaying)
+          pushError(playlist_[fileIndex], 0, error);
+        if (end_ != PlaybackEnd::NextFile || ++emptyPasses == playlist_.size())
+          break;
+        fileIndex = (fileIndex + 1) % playlist_.size();
+        replaying = replaying || fileIndex == 0;
+        continue;
+      }
+    }
+
+    // Wait for room for a whole chunk, so reads stay large
+    size_t head = head_.load(memory_order_relaxed);
+    if (capacity_ - (head - tail_.load(memory_order_acquire)) < chunkRows_) {
+      unique_lock<mutex> lock(wakeMutex_);
+      if (!stopping_.load(memory_order_relaxed))
+        wake_.wait_for(lock, chrono::milliseconds(10));
+      continue;
+    }
+
+    // Read into the ring directly, up to the wrap-around point
+    size_t slot = head & mask_;
+    size_t rows = chunkRows_ < capacity_ - slot ? chunkRows_ : capacity_ - slot;
+    size_t read = reader.read(ring_.x() + slot, ring_.y() + slot, ring_.z() + slot, rows);
+    head_.store(head + read, memory_order_release);
+    passRows += read;
+
+    if (!replaying) {
+      const vector<CaptureParseError> &errors = reader.report().errors;
+      for (; reportedErrors < errors.size(); ++reportedErrors)
+        pushError(reader.filename(), errors[reportedErrors].line, errors[reportedErrors].message);
+    }
+
+    if (read > 0)
+      continue;
+
+    // End of the current file, early if it is truncated
+    if (!replaying && !reader.error().empty())
+      pushError(reader.filename(), 0, reader.error());
+    emptyPasses = passRows == 0 ? emptyPasses + 1 : 0;
+    if (end_ == PlaybackEnd::Stop || (end_ == PlaybackEnd::Loop && emptyPasses > 0) || emptyPasses == playlist_.size())
+      break;
+    if (end_ == PlaybackEnd::Loop) {
+      reader.rewind();
+      passRows = 0;
+      replaying = true;
+    } else {
+      fileIndex = (fileIndex + 1) % playlist_.size();
+      replaying = replaying || fileIndex == 0;
+      open = false;
+    }
+  }
+  finished_.store(true, memory_order_release);
+}
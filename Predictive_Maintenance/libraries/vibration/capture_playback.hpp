@@ -0,0 +1,81 @@
+// File: capture_playback.hpp
+// Description: Bounded playback of captures. A background thread streams the capture files into a
+// single-producer/single-consumer ring buffer, so memory use does not depend on capture length.
+
+#ifndef CAPTURE_PLAYBACK_HPP
+#define CAPTURE_PLAYBACK_HPP
+
+#include "capture.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// What happens when the current capture file has been played back entirely
+enum class PlaybackEnd {
+  Stop,     // Playback finishes
+  Loop,     // The same file starts again
+  NextFile  // The next file of the playlist starts, wrapping around after the last one
+};
+
+// A malformed line, or an unreadable or truncated file, met by the reader thread
+struct CapturePlaybackError {
+  std::string filename;
+  size_t line;  // 0 when the error is about the whole file
+  std::string message;
+};
+
+class CapturePlayback {
+public:
+  // capacity is rounded up to a power of two; chunkRows is how much the reader thread reads at once
+  explicit CapturePlayback(size_t capacity = 16384, size_t chunkRows = 2048);
+  ~CapturePlayback();
+  CapturePlayback(const CapturePlayback &) = delete;
+  CapturePlayback &operator=(const CapturePlayback &) = delete;
+
+  // Start streaming the playlist; returns false if it is empty or already playing
+  bool start(const std::vector<std::string> &playlist, PlaybackEnd end);
+  void stop();
+
+  // Take the next sample, waiting for the reader thread if it is behind.
+  // Returns false once playback has finished and every sample has been consumed.
+  bool next(float &x, float &y, float &z);
+
+  // Samples currently buffered
+  size_t available() const;
+  bool finished() const { return finished_.load(std::memory_order_acquire) && available() == 0; }
+
+  // Errors met by the reader thread since the last call
+  std::vector<CapturePlaybackError> takeErrors();
+
+private:
+  void readerLoop();
+  void pushError(const std::string &filename, size_t line, const std::string &message);
+
+  const size_t capacity_;
+  const size_t mask_;
+  const size_t chunkRows_;
+  CaptureData ring_;
+
+  // head_ is only written by the reader thread, tail_ only by the consumer
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+  std::atomic<bool> finished_{true};
+  std::atomic<bool> stopping_{false};
+
+  // Only used to put the reader thread to sleep while the ring is full
+  std::mutex wakeMutex_;
+  std::condition_variable wake_;
+
+  std::mutex errorMutex_;
+  std::vector<CapturePlaybackError> errors_;
+
+  std::vector<std::string> playlist_;
+  PlaybackEnd end_ = PlaybackEnd::Stop;
+  std::thread reader_;
+};
+
+#endif  // CAPTURE_PLAYBACK_HPP
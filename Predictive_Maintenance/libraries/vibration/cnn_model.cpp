@@ -0,0 +1,572 @@
+// File: cnn_model.cpp
+// Description: TFLite flatbuffer parsing and float kernels for CnnModel.
+
+#include "cnn_model.hpp"
+#include "mapped_file.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+using namespace std;
+
+// TFLite schema constants used by the model
+enum TfLiteBuiltin { kConv2D = 3, kFullyConnected = 9, kMaxPool2D = 17, kReshape = 22, kSoftmax = 25 };
+enum TfLiteTensorType { kFloat32 = 0, kInt32 = 2 };
+enum TfLitePadding { kSame = 0, kValid = 1 };
+enum TfLiteActivation { kActNone = 0, kActRelu = 1, kActRelu6 = 3 };
+
+// Bounds-checked access to flatbuffer tables and vectors
+class FlatBuffer {
+public:
+  FlatBuffer(const unsigned char *data, size_t size) : data_(data), size_(size) {}
+
+  bool valid(size_t offset, size_t bytes) const { return offset <= size_ && bytes <= size_ - offset; }
+  template <typename T> T read(size_t offset) const {
+    T value;
+    memcpy(&value, data_ + offset, sizeof(T));
+    return value;
+  }
+
+  // Offset of the object referenced at `offset`, or 0 if absent or out of bounds
+  size_t follow(size_t offset) const {
+    if (offset == 0 || !valid(offset, 4))
+      return 0;
+    size_t target = offset + read<uint32_t>(offset);
+    return valid(target, 4) ? target : 0;
+  }
+
+  // Offset of field `index` of the table at `table`, or 0 if the field is absent
+  size_t field(size_t table, int index) const {
+    if (table == 0 || !valid(table, 4))
+      return 0;
+    size_t vtable = table - read<int32_t>(table);
+    if (!valid(vtable, 4))
+      return 0;
+    uint16_t vtableSize = read<uint16_t>(vtable);
+    size_t entry = 4 + 2 * (size_t)index;
+    if (entry + 2 > vtableSize || !valid(vtable, entry + 2))
+      return 0;
+    uint16_t fieldOffset = read<uint16_t>(vtable + entry);
+    return fieldOffset ? table + fieldOffset : 0;
+  }
+
+  template <typename T> T scalar(size_t table, int index, T defaultValue) const {
+    size_t offset = field(table, index);
+    return offset && valid(offset, sizeof(T)) ? read<T>(offset) : defaultValue;
+  }
+  size_t table(size_t table, int index) const { return follow(field(table, index)); }
+
+  // Vector referenced by field `index`: offset of the first element and element count
+  bool array(size_t table, int index, size_t elementSize, size_t &begin, size_t &count) const {
+    size_t offset = follow(field(table, index));
+    if (offset == 0)
+      return false;
+    count = read<uint32_t>(offset);
+    begin = offset + 4;
+    return valid(begin, count * elementSize);
+  }
+  size_t vectorTable(size_t begin, size_t i) const { return follow(begin + 4 * i); }
+
+  vector<int> intVector(size_t table, int index) const {
+    size_t begin, count;
+    vector<int> values;
+    if (array(table, index, 4, begin, count))
+      for (size_t i = 0; i < count; ++i)
+        values.push_back(read<int32_t>(begin + 4 * i));
+    return values;
+  }
+
+private:
+  const unsigned char *data_;
+  size_t size_;
+};
+
+static size_t elementCount(const vector<int> &shape) {
+  size_t count = 1;
+  for (int dimension : shape)
+    count *= dimension > 0 ? dimension : 1;
+  return count;
+}
+
+static bool fail(string *error, const string &message) {
+  if (error)
+    *error = message;
+  return false;
+}
+
+bool CnnModel::loadFile(const string &filename, string *error) {
+  shared_ptr<MappedFile> file = make_shared<MappedFile>();
+  if (!file->open(filename))
+    return fail(error, "could not open " + filename);
+  return load((const unsigned char *)file->data(), file->size(), file, error);
+}
+
+bool CnnModel::load(const unsigned char *data, size_t size, string *error) {
+  return load(data, size, nullptr, error);
+}
+
+bool CnnModel::load(const unsigned char *data, size_t size, shared_ptr<const void> storage, string *error) {
+  graph_.reset();
+  activations_.clear();
+  inputSize_ = outputSize_ = 0;
+  batchSize_ = 1;
+
+  // Graphs parsed in this process, by flatbuffer, while a model uses them: loading the same
+  // flatbuffer again (e.g. once per robot) only allocates the activations
+  static mutex cacheMutex;
+  static map<pair<const unsigned char *, size_t>, weak_ptr<const Graph>> cache;
+  {
+    lock_guard<mutex> lock(cacheMutex);
+    weak_ptr<const Graph> &cached = cache[{data, size}];
+    graph_ = cached.lock();
+    if (!graph_) {
+      shared_ptr<Graph> graph = make_shared<Graph>();
+      if (!parse(data, size, *graph, error))
+        return false;
+      graph->storage = storage;
+      graph_ = graph;
+      cached = graph_;
+    }
+  }
+
+  const Graph &graph = *graph_;
+  inputSize_ = graph.tensors[graph.inputTensor].size;
+  outputSize_ = graph.tensors[graph.outputTensor].size;
+  activations_.resize(graph.tensors.size());
+  for (size_t t = 0; t < graph.tensors.size(); ++t)
+    if (!graph.tensors[t].constant)
+      activations_[t].resize(graph.tensors[t].size);
+  return true;
+}
+
+bool CnnModel::parse(const unsigned char *data, size_t size, Graph &graph, string *error) {
+  FlatBuffer fb(data, size);
+  if (!fb.valid(0, 8) || memcmp(data + 4, "TFL3", 4) != 0)
+    return fail(error, "not a TFLite flatbuffer");
+  size_t model = fb.read<uint32_t>(0);
+  if (!fb.valid(model, 4))
+    return fail(error, "truncated TFLite flatbuffer");
+
+  // Operator codes: the builtin code moved from an int8 to an int32 field in later schemas
+  size_t codesBegin, codesCount;
+  if (!fb.array(model, 1, 4, codesBegin, codesCount))
+    return fail(error, "missing operator codes");
+  vector<int> builtinCodes;
+  for (size_t i = 0; i < codesCount; ++i) {
+    size_t code = fb.vectorTable(codesBegin, i);
+    builtinCodes.push_back(max<int>(fb.scalar<int8_t>(code, 0, 0), fb.scalar<int32_t>(code, 3, 0)));
+  }
+
+  size_t buffersBegin, buffersCount, subgraphsBegin, subgraphsCount;
+  if (!fb.array(model, 4, 4, buffersBegin, buffersCount) || !fb.array(model, 2, 4, subgraphsBegin, subgraphsCount) ||
+      subgraphsCount != 1)
+    return fail(error, "expected a single subgraph");
+  size_t subgraph = fb.vectorTable(subgraphsBegin, 0);
+
+  // Tensors, with their constant data in place in the flatbuffer
+  size_t tensorsBegin, tensorsCount;
+  if (!fb.array(subgraph, 0, 4, tensorsBegin, tensorsCount))
+    return fail(error, "missing tensors");
+  vector<Tensor> &tensors = graph.tensors;
+  tensors.resize(tensorsCount);
+  for (size_t t = 0; t < tensorsCount; ++t) {
+    size_t tensor = fb.vectorTable(tensorsBegin, t);
+    Tensor &target = tensors[t];
+    target.shape = fb.intVector(tensor, 0);
+    int type = fb.scalar<int8_t>(tensor, 1, kFloat32);
+    uint32_t bufferIndex = fb.scalar<uint32_t>(tensor, 2, 0);
+
+    size_t dataBegin = 0, dataSize = 0;
+    if (bufferIndex < buffersCount)
+      fb.array(fb.vectorTable(buffersBegin, bufferIndex), 0, 1, dataBegin, dataSize);
+
+    target.constant = dataSize > 0;
+    target.size = 0;
+    target.weights = nullptr;
+    if (type == kFloat32) {
+      target.size = elementCount(target.shape);
+      if (dataSize > 0) {
+        if (dataSize != target.size * sizeof(float))
+          return fail(error, "tensor " + to_string(t) + " has inconsistent data size");
+        // TFLite aligns its buffers, so this only copies if the flatbuffer itself is misaligned
+        if ((uintptr_t)(data + dataBegin) % alignof(float) == 0) {
+          target.weights = (const float *)(data + dataBegin);
+        } else {
+          graph.ownedWeights.emplace_back(target.size);
+          memcpy(graph.ownedWeights.back().data(), data + dataBegin, dataSize);
+          target.weights = graph.ownedWeights.back().data();
+        }
+      }
+    } else if (type != kInt32) {  // int32 tensors only hold reshape targets, which are not needed
+      return fail(error, "tensor " + to_string(t) + " is not float32");
+    }
+  }
+
+  vector<int> inputs = fb.intVector(subgraph, 1), outputs = fb.intVector(subgraph, 2);
+  if (inputs.size() != 1 || outputs.size() != 1)
+    return fail(error, "expected one input and one output tensor");
+  graph.inputTensor = inputs[0];
+  graph.outputTensor = outputs[0];
+
+  // Operators
+  size_t operatorsBegin, operatorsCount;
+  if (!fb.array(subgraph, 3, 4, operatorsBegin, operatorsCount))
+    return fail(error, "missing operators");
+  for (size_t o = 0; o < operatorsCount; ++o) {
+    size_t op = fb.vectorTable(operatorsBegin, o);
+    uint32_t codeIndex = fb.scalar<uint32_t>(op, 0, 0);
+    if (codeIndex >= builtinCodes.size())
+      return fail(error, "operator " + to_string(o) + " has an invalid opcode");
+    vector<int> opInputs = fb.intVector(op, 1), opOutputs = fb.intVector(op, 2);
+    size_t options = fb.table(op, 4);
+
+    Operation operation = {};
+    operation.inputs[0] = operation.inputs[1] = operation.inputs[2] = -1;
+    for (size_t i = 0; i < opInputs.size() && i < 3; ++i)
+      operation.inputs[i] = opInputs[i];
+    operation.output = opOutputs.empty() ? -1 : opOutputs[0];
+    operation.strideW = operation.strideH = operation.dilationW = operation.dilationH = 1;
+    int activation = kActNone;
+
+    switch (builtinCodes[codeIndex]) {
+      case kConv2D:
+        operation.type = OpType::Conv2D;
+        operation.samePadding = fb.scalar<int8_t>(options, 0, kSame) == kSame;
+        operation.strideW = fb.scalar<int32_t>(options, 1, 1);
+        operation.strideH = fb.scalar<int32_t>(options, 2, 1);
+        activation = fb.scalar<int8_t>(options, 3, kActNone);
+        operation.dilationW = fb.scalar<int32_t>(options, 4, 1);
+        operation.dilationH = fb.scalar<int32_t>(options, 5, 1);
+        break;
+      case kMaxPool2D:
+        operation.type = OpType::MaxPool2D;
+        operation.samePadding = fb.scalar<int8_t>(options, 0, kSame) == kSame;
+        operation.strideW = fb.scalar<int32_t>(options, 1, 1);
+        operation.strideH = fb.scalar<int32_t>(options, 2, 1);
+        operation.filterW = fb.scalar<int32_t>(options, 3, 1);
+        operation.filterH = fb.scalar<int32_t>(options, 4, 1);
+        activation = fb.scalar<int8_t>(options, 5, kActNone);
+        break;
+      case kReshape:
+        operation.type = OpType::Reshape;
+        break;
+      case kFullyConnected:
+        operation.type = OpType::FullyConnected;
+        activation = fb.scalar<int8_t>(options, 0, kActNone);
+        break;
+      case kSoftmax:
+        operation.type = OpType::Softmax;
+        operation.beta = fb.scalar<float>(options, 0, 1.0f);
+        break;
+      default:
+        return fail(error, "unsupported operator " + to_string(builtinCodes[codeIndex]));
+    }
+
+    if (activation == kActRelu)
+      operation.activation = Activation::Relu;
+    else if (activation == kActRelu6)
+      operation.activation = Activation::Relu6;
+    else if (activation != kActNone)
+      return fail(error, "unsupported fused activation in operator " + to_string(o));
+
+    int tensorCount = (int)tensors.size();
+    if (operation.output < 0 || operation.output >= tensorCount || operation.inputs[0] < 0 || operation.inputs[0] >= tensorCount ||
+        operation.inputs[1] >= tensorCount || operation.inputs[2] >= tensorCount)
+      return fail(error, "operator " + to_string(o) + " references an invalid tensor");
+    if ((operation.type == OpType::Conv2D || operation.type == OpType::FullyConnected) && operation.inputs[1] < 0)
+      return fail(error, "operator " + to_string(o) + " has no weights");
+    graph.operations.push_back(operation);
+  }
+
+  if (graph.operations.empty())
+    return fail(error, "model has no operators");
+  for (size_t o = 0; o < graph.operations.size(); ++o)
+    if (!validShapes(graph, graph.operations[o]))
+      return fail(error, "operator " + to_string(o) + " has inconsistent tensor shapes");
+
+  // Repack the convolution filters from OHWI to HWIO, the only copy of the weights
+  for (Operation &op : graph.operations) {
+    if (op.type != OpType::Conv2D)
+      continue;
+    const Tensor &filter = tensors[op.inputs[1]];
+    size_t outC = filter.shape[0], taps = filter.size / outC;
+    op.packedWeights.resize(filter.size);
+    for (size_t oc = 0; oc < outC; ++oc)
+      for (size_t t = 0; t < taps; ++t)
+        op.packedWeights[t * outC + oc] = filter.weights[oc * taps + t];
+  }
+
+  graph.batchable = true;
+  for (const Tensor &tensor : tensors)
+    if (!tensor.constant && tensor.size > 0 && (tensor.shape.empty() || tensor.shape[0] != 1))
+      graph.batchable = false;
+  return true;
+}
+
+// Function to resize every activation to `count` batch entries
+void CnnModel::setBatchSize(size_t count) {
+  if (count == batchSize_)
+    return;
+  for (size_t t = 0; t < activations_.size(); ++t)
+    if (!graph_->tensors[t].constant)
+      activations_[t].resize(graph_->tensors[t].size * count);
+  batchSize_ = count;
+}
+
+bool CnnModel::validShapes(const Graph &graph, const Operation &op) {
+  const vector<Tensor> &tensors = graph.tensors;
+  const Tensor &input = tensors[op.inputs[0]], &output = tensors[op.output];
+  if (input.constant || output.constant || input.size == 0 || output.size == 0)
+    return false;
+
+  size_t expected = input.size;
+  if (op.type == OpType::Conv2D || op.type == OpType::MaxPool2D) {
+    const Tensor *filter = op.type == OpType::Conv2D ? &tensors[op.inputs[1]] : nullptr;
+    if (input.shape.size() != 4 || (filter && (filter->shape.size() != 4 || filter->shape[3] != input.shape[3])))
+      return false;
+    if (op.strideW < 1 || op.strideH < 1 || op.dilationW < 1 || op.dilationH < 1)
+      return false;
+    int outH, outW, padH, padW;
+    windowGeometry(op.samePadding, input.shape[1], filter ? filter->shape[1] : op.filterH, op.strideH, op.dilationH, outH, padH);
+    windowGeometry(op.samePadding, input.shape[2], filter ? filter->shape[2] : op.filterW, op.strideW, op.dilationW, outW, padW);
+    if (outH < 1 || outW < 1)
+      return false;
+    expected = (size_t)input.shape[0] * outH * outW * (filter ? filter->shape[0] : input.shape[3]);
+    if (filter && !filter->constant)
+      return false;
+    if (op.inputs[2] >= 0 && filter && (!tensors[op.inputs[2]].constant || tensors[op.inputs[2]].size != (size_t)filter->shape[0]))
+      return false;
+  } else if (op.type == OpType::FullyConnected) {
+    const Tensor &weights = tensors[op.inputs[1]];
+    if (!weights.constant || weights.shape.size() != 2 || weights.shape[1] < 1 || input.size % weights.shape[1] != 0)
+      return false;
+    expected = input.size / weights.shape[1] * weights.shape[0];
+    if (op.inputs[2] >= 0 && (!tensors[op.inputs[2]].constant || tensors[op.inputs[2]].size != (size_t)weights.shape[0]))
+      return false;
+  } else if (op.type == OpType::Softmax) {
+    if (input.shape.empty() || input.shape.back() < 1)
+      return false;
+  }
+  return output.size == expected;
+}
+
+float CnnModel::activate(float value, Activation activation) {
+  if (activation == Activation::Relu)
+    return value > 0.0f ? value : 0.0f;
+  if (activation == Activation::Relu6)
+    return value < 0.0f ? 0.0f : value > 6.0f ? 6.0f : value;
+  return value;
+}
+
+// Start offset and output size of a convolution or pooling window along one dimension
+void CnnModel::windowGeometry(bool samePadding, int inSize, int filterSize, int stride, int dilation, int &outSize, int &padding) {
+  int effectiveFilter = (filterSize - 1) * dilation + 1;
+  if (samePadding) {
+    outSize = (inSize + stride - 1) / stride;
+    int total = max(0, (outSize - 1) * stride + effectiveFilter - inSize);
+    padding = total / 2;
+  } else {
+    outSize = (inSize - effectiveFilter + stride) / stride;
+    padding = 0;
+  }
+}
+
+void CnnModel::runConv2D(const Operation &op) {
+  const Tensor &input = graph_->tensors[op.inputs[0]], &filter = graph_->tensors[op.inputs[1]];
+  const float *bias = op.inputs[2] >= 0 ? graph_->tensors[op.inputs[2]].weights : nullptr;
+
+  // NHWC input, HWIO packed filter
+  int batches = input.shape[0] * (int)batchSize_, inH = input.shape[1], inW = input.shape[2], inC = input.shape[3];
+  int outC = filter.shape[0], filterH = filter.shape[1], filterW = filter.shape[2];
+  int outH, outW, padH, padW;
+  windowGeometry(op.samePadding, inH, filterH, op.strideH, op.dilationH, outH, padH);
+  windowGeometry(op.samePadding, inW, filterW, op.strideW, op.dilationW, outW, padW);
+
+  // Output channels are accumulated a block at a time in local sums, which the compiler keeps in vector registers
+  const int kBlock = 8;
+  float *out = activations_[op.output].data();
+  for (int b = 0; b < batches; ++b) {
+    const float *in = activations_[op.inputs[0]].data() + (size_t)b * inH * inW * inC;
+    for (int oy = 0; oy < outH; ++oy)
+      for (int ox = 0; ox < outW; ++ox, out += outC)
+        for (int block = 0; block < outC; block += kBlock) {
+          int count = min(kBlock, outC - block);
+          float sum[kBlock] = {};
+          for (int j = 0; j < count && bias; ++j)
+            sum[j] = bias[block + j];
+          for (int fy = 0; fy < filterH; ++fy) {
+            int iy = oy * op.strideH - padH + fy * op.dilationH;
+            if (iy < 0 || iy >= inH)
+              continue;
+            for (int fx = 0; fx < filterW; ++fx) {
+              int ix = ox * op.strideW - padW + fx * op.dilationW;
+              if (ix < 0 || ix >= inW)
+                continue;
+              const float *pixel = in + ((size_t)iy * inW + ix) * inC;
+              const float *taps = op.packedWeights.data() + ((size_t)fy * filterW + fx) * inC * outC + block;
+              for (int ic = 0; ic < inC; ++ic) {
+                float value = pixel[ic];
+                const float *weights = taps + (size_t)ic * outC;
+                if (count == kBlock) {
+                  for (int j = 0; j < kBlock; ++j)
+                    sum[j] += value * weights[j];
+                } else {
+                  for (int j = 0; j < count; ++j)
+                    sum[j] += value * weights[j];
+                }
+              }
+            }
+          }
+          for (int j = 0; j < count; ++j)
+            out[block + j] = activate(sum[j], op.activation);
+        }
+  }
+}
+
+void CnnModel::runMaxPool2D(const Operation &op) {
+  const Tensor &input = graph_->tensors[op.inputs[0]];
+
+  int batches = input.shape[0] * (int)batchSize_, inH = input.shape[1], inW = input.shape[2], channels = input.shape[3];
+  int outH, outW, padH, padW;
+  windowGeometry(op.samePadding, inH, op.filterH, op.strideH, 1, outH, padH);
+  windowGeometry(op.samePadding, inW, op.filterW, op.strideW, 1, outW, padW);
+
+  // Channels innermost, so every window position is a contiguous run of channels
+  float *out = activations_[op.output].data();
+  for (int b = 0; b < batches; ++b) {
+    const float *in = activations_[op.inputs[0]].data() + (size_t)b * inH * inW * channels;
+    for (int oy = 0; oy < outH; ++oy)
+      for (int ox = 0; ox < outW; ++ox, out += channels) {
+        fill(out, out + channels, -INFINITY);
+        for (int fy = 0; fy < op.filterH; ++fy) {
+          int iy = oy * op.strideH - padH + fy;
+          if (iy < 0 || iy >= inH)
+            continue;
+          for (int fx = 0; fx < op.filterW; ++fx) {
+            int ix = ox * op.strideW - padW + fx;
+            if (ix < 0 || ix >= inW)
+              continue;
+            const float *pixel = in + ((size_t)iy * inW + ix) * channels;
+            for (int c = 0; c < channels; ++c)
+              out[c] = max(out[c], pixel[c]);
+          }
+        }
+        for (int c = 0; c < channels && op.activation != Activation::None; ++c)
+          out[c] = activate(out[c], op.activation);
+      }
+  }
+}
+
+void CnnModel::runFullyConnected(const Operation &op) {
+  const Tensor &weights = graph_->tensors[op.inputs[1]];
+  const vector<float> &input = activations_[op.inputs[0]];
+  vector<float> &output = activations_[op.output];
+  const float *bias = op.inputs[2] >= 0 ? graph_->tensors[op.inputs[2]].weights : nullptr;
+
+  size_t units = weights.shape[0], depth = weights.shape[1];
+  size_t batches = input.size() / depth;
+  for (size_t b = 0; b < batches; ++b) {
+    const float *in = input.data() + b * depth;
+    for (size_t u = 0; u < units; ++u) {
+      const float *row = weights.weights + u * depth;
+      // Eight independent partial sums, so the dot product vectorises without reassociating
+      float partial[8] = {};
+      size_t d = 0;
+      for (; d + 8 <= depth; d += 8)
+        for (int j = 0; j < 8; ++j)
+          partial[j] += in[d + j] * row[d + j];
+      float sum = bias ? bias[u] : 0.0f;
+      for (; d < depth; ++d)
+        sum += in[d] * row[d];
+      for (int j = 0; j < 8; ++j)
+        sum += partial[j];
+      output[b * units + u] = activate(sum, op.activation);
+    }
+  }
+}
+
+void CnnModel::runSoftmax(const Operation &op) {
+  const vector<float> &input = activations_[op.inputs[0]];
+  vector<float> &output = activations_[op.output];
+
+  size_t depth = graph_->tensors[op.inputs[0]].shape.back();
+  for (size_t offset = 0; offset < input.size(); offset += depth) {
+    const float *in = input.data() + offset;
+    float *out = output.data() + offset;
+    float largest = *max_element(in, in + depth);
+    float sum = 0.0f;
+    for (size_t i = 0; i < depth; ++i)
+      sum += out[i] = expf((in[i] - largest) * op.beta);
+    for (size_t i = 0; i < depth; ++i)
+      out[i] /= sum;
+  }
+}
+
+// Function to run the model on `count` inputs (1 unless the graph is batchable), returning the outputs
+const float *CnnModel::run(const float *inputs, size_t count) {
+  setBatchSize(count);
+  vector<float> &in = activations_[graph_->inputTensor];
+  copy(inputs, inputs + in.size(), in.begin());
+
+  for (const Operation &op : graph_->operations) {
+    switch (op.type) {
+      case OpType::Conv2D:
+        runConv2D(op);
+        break;
+      case OpType::MaxPool2D:
+        runMaxPool2D(op);
+        break;
+      case OpType::Reshape:
+        activations_[op.output] = activations_[op.inputs[0]];
+        break;
+      case OpType::FullyConnected:
+        runFullyConnected(op);
+        break;
+      case OpType::Softmax:
+        runSoftmax(op);
+        break;
+    }
+  }
+
+  return activations_[graph_->outputTensor].data();
+}
+
+void CnnModel::invoke(const float *input, float *output) {
+  const float *scores = run(input, 1);
+  copy(scores, scores + outputSize_, output);
+}
+
+int CnnModel::classify(const float *input) {
+  const float *scores = run(input, 1);
+  return (int)(max_element(scores, scores + outputSize_) - scores);
+}
+
+void CnnModel::invokeBatch(const float *inputs, size_t count, float *outputs) {
+  if (count == 0)
+    return;
+  if (!graph_->batchable) {
+    for (size_t i = 0; i < count; ++i)
+      invoke(inputs + i * inputSize_, outputs + i * outputSize_);
+    return;
+  }
+  const float *scores = run(inputs, count);
+  copy(scores, scores + count * outputSize_, outputs);
+}
+
+void CnnModel::classifyBatch(const float *inputs, size_t count, int *labels) {
+  if (count == 0)
+    return;
+  if (!graph_->batchable) {
+    for (size_t i = 0; i < count; ++i)
+      labels[i] = classify(inputs + i * inputSize_);
+    return;
+  }
+  const float *scores = run(inputs, count);
+  for (size_t i = 0; i < count; ++i) {
+    const float *row = scores + i * outputSize_;
+    labels[i] = (int)(max_element(row, row + outputSize_) - row);
+  }
+}
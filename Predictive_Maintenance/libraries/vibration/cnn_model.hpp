@@ -0,0 +1,103 @@
+// File: cnn_model.hpp
+// Description: Minimal in-process runner for the TFLite CNN (models/cnn_model.tflite). It reads the
+// flatbuffer directly and implements the handful of float operators the model uses, so that robot
+// controllers can classify windows without the TFLite runtime, and the supervisor can classify the
+// windows of a whole fleet in one batched invocation. The weights are used in place in the
+// flatbuffer, and the parsed graph is shared by every model loaded from the same flatbuffer.
+
+#ifndef CNN_MODEL_HPP
+#define CNN_MODEL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class CnnModel {
+public:
+  // Parse a TFLite flatbuffer. Returns false, with a reason in error, if the model uses anything
+  // other than float32 CONV_2D, MAX_POOL_2D, RESHAPE, FULLY_CONNECTED and SOFTMAX.
+  // The weights are not copied (unless misaligned), so data must stay valid and unchanged while a
+  // model loaded from it exists, as the array embedded from models/cnn_model.h does. Models loaded
+  // from the same data in a process share the parsed graph, and only own their activations.
+  bool load(const unsigned char *data, size_t size, std::string *error = nullptr);
+  // The same on the memory-mapped file, which stays mapped while the graph is in use
+  bool loadFile(const std::string &filename, std::string *error = nullptr);
+
+  bool isLoaded() const { return graph_ != nullptr; }
+  const std::vector<int> &inputShape() const { return graph_->tensors[graph_->inputTensor].shape; }
+  // Values of one input and one output (of a single batch entry)
+  size_t inputSize() const { return inputSize_; }
+  size_t outputSize() const { return outputSize_; }
+
+  // Run the model on one input of inputSize() values (NHWC order, i.e. x, y, z of each reading
+  // in turn for the window models); output receives outputSize() values
+  void invoke(const float *input, float *output);
+
+  // Run the model and return the index of the most likely class
+  int classify(const float *input);
+
+  // Run the model once on `count` inputs stored one after the other; outputs receives
+  // count * outputSize() values. The activations grow to the largest batch seen, so steady-state
+  // batches do not allocate.
+  void invokeBatch(const float *inputs, size_t count, float *outputs);
+  void classifyBatch(const float *inputs, size_t count, int *labels);
+
+private:
+  enum class OpType { Conv2D, MaxPool2D, Reshape, FullyConnected, Softmax };
+  enum class Activation { None, Relu, Relu6 };
+
+  struct Tensor {
+    std::vector<int> shape;  // As in the flatbuffer, i.e. a batch of 1 for batchable activations
+    size_t size;             // Float elements of that shape, 0 for the int32 reshape targets
+    bool constant;
+    const float *weights;  // Constant tensors: in the flatbuffer, or in Graph::ownedWeights if misaligned
+  };
+
+  struct Operation {
+    OpType type;
+    int inputs[3];  // Tensor indices, -1 when absent
+    int output;
+    Activation activation;
+    bool samePadding;
+    int strideW, strideH;
+    int filterW, filterH;  // Pooling window
+    int dilationW, dilationH;
+    float beta;  // Softmax
+    std::vector<float> packedWeights;  // Conv2D filter in HWIO order, so the inner loop runs over output channels
+  };
+
+  // Immutable part of a loaded model, shared by the models loaded from the same flatbuffer
+  struct Graph {
+    std::vector<Tensor> tensors;
+    std::vector<Operation> operations;
+    int inputTensor = 0;
+    int outputTensor = 0;
+    bool batchable = false;  // Every activation has a leading batch dimension of 1 in the flatbuffer
+    std::vector<std::vector<float>> ownedWeights;  // Copies of the weights that are not float-aligned
+    std::shared_ptr<const void> storage;           // Keeps the flatbuffer alive, e.g. the mapping of loadFile()
+  };
+
+  friend class QuantizedCnnModel;  // Reads the float weights and calibrates on the float activations
+
+  bool load(const unsigned char *data, size_t size, std::shared_ptr<const void> storage, std::string *error);
+  static bool parse(const unsigned char *data, size_t size, Graph &graph, std::string *error);
+  static bool validShapes(const Graph &graph, const Operation &op);
+  static void windowGeometry(bool samePadding, int inSize, int filterSize, int stride, int dilation, int &outSize, int &padding);
+  void setBatchSize(size_t count);
+  const float *run(const float *inputs, size_t count);
+  static float activate(float value, Activation activation);
+  void runConv2D(const Operation &op);
+  void runMaxPool2D(const Operation &op);
+  void runFullyConnected(const Operation &op);
+  void runSoftmax(const Operation &op);
+
+  std::shared_ptr<const Graph> graph_;
+  std::vector<std::vector<float>> activations_;  // Per tensor, batchSize_ entries; empty for constants
+  size_t inputSize_ = 0;
+  size_t outputSize_ = 0;
+  size_t batchSize_ = 1;
+};
+
+#endif  // CNN_MODEL_HPP
@@ -0,0 +1,225 @@
+// File: fleet.cpp
+// Description: Fleet configuration and the per-step fleet update.
+
+#include "fleet.hpp"
+#include "sample_kernels.hpp"
+#include "vibration_map.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+
+bool loadFleetConfig(const string &filename, vector<RobotConfig> &robots, int firstChannel, string *error) {
+  robots.clear();
+  ifstream file(filename);
+  if (!file.is_open()) {
+    if (error)
+      *error = "could not open " + filename;
+    return false;
+  }
+
+  string line;
+  for (size_t lineNumber = 1; getline(file, line); ++lineNumber) {
+    size_t comment = line.find('#');
+    if (comment != string::npos)
+      line.erase(comment);
+    istringstream fields(line);
+    RobotConfig robot = {0.0, 0.0, firstChannel + (int)robots.size(), 0};
+    if (!(fields >> robot.x)) {
+      if (line.find_first_not_of(" \t\r") == string::npos)
+        continue;  // Blank or comment line
+    } else if (fields >> robot.y) {
+      int channel;
+      if (fields >> channel) {
+        robot.channel = channel;
+        fields >> robot.delay;
+      }
+      if (fields.fail() && !fields.eof()) {
+        if (error)
+          *error = filename + ":" + to_string(lineNumber) + ": invalid channel or delay";
+        return false;
+      }
+      robots.push_back(robot);
+      continue;
+    }
+    if (error)
+      *error = filename + ":" + to_string(lineNumber) + ": expected \"x y [channel] [delay]\"";
+    return false;
+  }
+  return true;
+}
+
+vector<RobotConfig> gridFleet(size_t count, double arenaSize, int firstChannel) {
+  vector<RobotConfig> robots;
+  size_t side = (size_t)ceil(sqrt((double)count));
+  double spacing = side > 0 ? arenaSize / side : arenaSize;
+  for (size_t k = 0; k < count; ++k) {
+    double x = -arenaSize / 2 + spacing * (k % side + 0.5);
+    double y = -arenaSize / 2 + spacing * (k / side + 0.5);
+    robots.push_back({x, y, firstChannel + (int)k, 0});
+  }
+  return robots;
+}
+
+// SampleHistory
+
+SampleHistory::SampleHistory(size_t depth) : capacity_(depth < 1 ? 1 : depth), samples_(3 * capacity_) {
+}
+
+void SampleHistory::push(float x, float y, float z) {
+  float *slot = samples_.data() + 3 * (count_ % capacity_);
+  slot[0] = x;
+  slot[1] = y;
+  slot[2] = z;
+  ++count_;
+}
+
+bool SampleHistory::reached(size_t delay) const {
+  return delay < count_ && delay < capacity_;
+}
+
+bool SampleHistory::get(size_t delay, float &x, float &y, float &z) const {
+  if (delay >= count_ || delay >= capacity_)
+    return false;
+  const float *slot = samples_.data() + 3 * ((count_ - 1 - delay) % capacity_);
+  x = slot[0];
+  y = slot[1];
+  z = slot[2];
+  return true;
+}
+
+// FleetState
+
+FleetState::FleetState(const vector<RobotConfig> &robots, size_t sourceCount, size_t windowLength, size_t windowHop) {
+  for (const RobotConfig &robot : robots) {
+    x.push_back(robot.x);
+    y.push_back(robot.y);
+    channel.push_back(robot.channel);
+    delay.push_back(robot.delay);
+    windows.emplace_back(windowLength, windowHop);
+  }
+  gain.assign(sourceCount * robots.size(), 1.0f);
+  gainX.assign(robots.size(), NAN);
+  gainY.assign(robots.size(), NAN);
+  moved.reserve(robots.size());
+  readingX.resize(robots.size());
+  readingY.resize(robots.size());
+  readingZ.resize(robots.size());
+  ready.reserve(robots.size());
+  label.assign(robots.size(), -1);
+}
+
+size_t FleetState::maxDelay() const {
+  size_t largest = 0;
+  for (size_t d : delay)
+    largest = d > largest ? d : largest;
+  return largest;
+}
+
+size_t FleetState::updateAttenuation(const vector<AttenuationField> &fields, bool interpolate, double tolerance) {
+  size_t robots = size();
+  moved.clear();
+  if (fields.empty())
+    return 0;
+
+  // The nearest node only changes with the grid cell, and every field shares the same grid
+  const AttenuationField &grid = fields[0];
+  for (size_t k = 0; k < robots; ++k) {
+    bool stale;
+    if (std::isnan(gainX[k]))
+      stale = true;
+    else if (interpolate)
+      stale = !(fabs(x[k] - gainX[k]) <= tolerance && fabs(y[k] - gainY[k]) <= tolerance);
+    else
+      stale = grid.nodeColumn(x[k]) != grid.nodeColumn(gainX[k]) || grid.nodeRow(y[k]) != grid.nodeRow(gainY[k]);
+    if (stale) {
+      moved.push_back((uint32_t)k);
+      gainX[k] = x[k];
+      gainY[k] = y[k];
+    }
+  }
+
+  for (size_t s = 0; s < fields.size(); ++s) {
+    float *row = gain.data() + s * robots;
+    if (interpolate) {
+      for (uint32_t k : moved)
+        row[k] = fields[s].bilinear(x[k], y[k]);
+    } else {
+      for (uint32_t k : moved)
+        row[k] = fields[s].nearest(x[k], y[k]);
+    }
+  }
+  return moved.size();
+}
+
+void FleetState::pushReadings(const vector<SampleHistory> &histories) {
+  size_t robots = size();
+  fill(readingX.begin(), readingX.end(), 0.0f);
+  fill(readingY.begin(), readingY.end(), 0.0f);
+  fill(readingZ.begin(), readingZ.end(), 0.0f);
+
+  // Accumulate source by source, so the inner loop runs over contiguous per-robot arrays
+  bool sharedCursor = maxDelay() == 0;
+  for (size_t s = 0; s < histories.size(); ++s) {
+    const float *row = gain.data() + s * robots;
+    float sx, sy, sz;
+    if (sharedCursor) {
+      if (!histories[s].get(0, sx, sy, sz))
+        continue;
+      accumulateScaled(readingX.data(), row, sx, robots);
+      accumulateScaled(readingY.data(), row, sy, robots);
+      accumulateScaled(readingZ.data(), row, sz, robots);
+    } else {
+      for (size_t k = 0; k < robots; ++k) {
+        if (!windows[k].collecting() || !histories[s].get(delay[k], sx, sy, sz))
+          continue;
+        readingX[k] += row[k] * sx;
+        readingY[k] += row[k] * sy;
+        readingZ[k] += row[k] * sz;
+      }
+    }
+  }
+
+  ready.clear();
+  for (size_t k = 0; k < robots; ++k) {
+    // Robots whose cursor has not reached the start of the captures yet wait
+    if (delay[k] > 0 && !histories.empty() && !histories[0].reached(delay[k]))
+      continue;
+    if (!windows[k].collecting())
+      windows[k].skip();
+    else if (windows[k].push(readingX[k], readingY[k], readingZ[k]))
+      ready.push_back((uint32_t)k);
+  }
+}
+
+void FleetState::pushReadings(const VibrationField &map, uint64_t step, bool interpolate) {
+  size_t robots = size();
+  size_t collecting = 0;
+  for (size_t k = 0; k < robots; ++k)
+    collecting += windows[k].collecting() ? 1 : 0;
+  if (maxDelay() == 0 && collecting == robots) {
+    map.query(x.data(), y.data(), robots, step, interpolate, readingX.data(), readingY.data(), readingZ.data());
+  } else {
+    for (size_t k = 0; k < robots; ++k) {
+      float reading[3] = {0.0f, 0.0f, 0.0f};
+      if (step >= delay[k] && windows[k].collecting())
+        map.query(x[k], y[k], step - delay[k], interpolate, reading);
+      readingX[k] = reading[0];
+      readingY[k] = reading[1];
+      readingZ[k] = reading[2];
+    }
+  }
+
+  ready.clear();
+  for (size_t k = 0; k < robots; ++k) {
+    if (step < delay[k])
+      continue;
+    if (!windows[k].collecting())
+      windows[k].skip();
+    else if (windows[k].push(readingX[k], readingY[k], readingZ[k]))
+      ready.push_back((uint32_t)k);
+  }
+}
@@ -0,0 +1,88 @@
+// File: fleet.hpp
+// Description: Per-robot state of a fleet of inspection robots, stored as parallel arrays indexed
+// by robot so that the supervisor can process every robot of a step in one tight loop.
+
+#ifndef FLEET_HPP
+#define FLEET_HPP
+
+#include "attenuation_field.hpp"
+#include "window_assembler.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class VibrationField;
+
+// Settings of one robot of the fleet
+struct RobotConfig {
+  double x, y;   // Spawn position on the arena floor
+  int channel;   // Channel the robot receives its windows on
+  size_t delay;  // Playback cursor, in readings behind the most recent capture reading
+};
+
+// Read a fleet file: one robot per line as "x y [channel] [delay]", '#' starts a comment.
+// Robots without a channel get firstChannel + their index.
+bool loadFleetConfig(const std::string &filename, std::vector<RobotConfig> &robots, int firstChannel, std::string *error = nullptr);
+
+// count robots spread on a regular grid over a square arena of the given size centred on the origin
+std::vector<RobotConfig> gridFleet(size_t count, double arenaSize, int firstChannel);
+
+// The most recent readings of the capture, so that every robot can read it at its own cursor
+class SampleHistory {
+public:
+  explicit SampleHistory(size_t depth = 1);
+
+  void push(float x, float y, float z);
+
+  // Whether a reading `delay` readings before the most recent one has been played
+  bool reached(size_t delay) const;
+
+  // Reading `delay` readings before the most recent one; false if it has not been played yet
+  bool get(size_t delay, float &x, float &y, float &z) const;
+
+private:
+  size_t capacity_;
+  uint64_t count_ = 0;
+  std::vector<float> samples_;  // Interleaved x, y, z ring
+};
+
+struct FleetState {
+  FleetState(const std::vector<RobotConfig> &robots, size_t sourceCount, size_t windowLength, size_t windowHop);
+
+  size_t size() const { return channel.size(); }
+
+  // Largest playback delay of the fleet, to size the SampleHistory
+  size_t maxDelay() const;
+
+  size_t sourceCount() const { return size() ? gain.size() / size() : 0; }
+
+  // Look up the gain of every source at the current position (one field per source) of the robots
+  // that moved to another grid cell since their last lookup or, when interpolating, farther than
+  // `tolerance` meters on either axis. Returns the number of robots looked up, listed in moved.
+  size_t updateAttenuation(const std::vector<AttenuationField> &fields, bool interpolate, double tolerance = 0.0);
+
+  // Push the reading of every robot into its window: the superposition of every source's reading
+  // (at the robot's playback cursor) scaled by the source's gain. Robots whose window completed
+  // are listed in ready. Robots between two windows (hop > length) only count the reading.
+  void pushReadings(const std::vector<SampleHistory> &histories);
+
+  // Same, reading every robot's vibration from a map at its position and its cursor's map step,
+  // `step` being the map step of the most recent reading. Gains are not used, and robots between two
+  // windows are not looked up.
+  void pushReadings(const VibrationField &map, uint64_t step, bool interpolate);
+
+  std::vector<double> x, y;          // Current positions
+  std::vector<float> gain;           // Source gains at the current positions, one row of robots per source
+  std::vector<double> gainX, gainY;  // Positions the gains were looked up at, NaN before the first lookup
+  std::vector<uint32_t> moved;       // Robots looked up by the last updateAttenuation()
+  std::vector<float> readingX, readingY, readingZ;  // Superposed readings of the current step
+  std::vector<int> channel;
+  std::vector<size_t> delay;
+  std::vector<WindowAssembler> windows;
+  std::vector<uint32_t> ready;       // Robots with a window to dispatch this step
+  std::vector<int> label;            // Latest classification of each robot's window, -1 before the first
+};
+
+#endif  // FLEET_HPP
@@ -0,0 +1,205 @@
+// File: headless_pipeline.cpp
+// Description: Scripted trajectories and the in-memory radio of the headless pipeline.
+
+#include "headless_pipeline.hpp"
+#include "result_packet.hpp"
+#include "window_packet.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+using namespace std;
+
+static const double kPi = 3.14159265358979323846;
+
+// Largest feature payload the stand-in robots decode, as the native robot controller
+static const size_t kMaxFeatures = 1024;
+
+bool parseTrajectoryKind(const string &name, TrajectoryKind &kind) {
+  if (name == "still")
+    kind = TrajectoryKind::Still;
+  else if (name == "circle")
+    kind = TrajectoryKind::Circle;
+  else if (name == "random-walk")
+    kind = TrajectoryKind::RandomWalk;
+  else
+    return false;
+  return true;
+}
+
+// ScriptedTrajectories
+
+ScriptedTrajectories::ScriptedTrajectories(const vector<RobotConfig> &robots, TrajectoryKind kind, double arenaSize,
+                                           uint32_t seed) :
+  kind_(kind),
+  limit_(arenaSize / 2 - 0.05),
+  random_(seed) {
+  for (const RobotConfig &robot : robots) {
+    spawnX_.push_back(robot.x);
+    spawnY_.push_back(robot.y);
+  }
+  x_ = spawnX_;
+  y_ = spawnY_;
+  uniform_real_distribution<double> angle(-kPi, kPi);
+  for (size_t k = 0; k < robots.size(); ++k)
+    heading_.push_back(angle(random_));
+  turnRate_.assign(robots.size(), 0.0);
+  turnLeft_.assign(robots.size(), 0.0);
+}
+
+void ScriptedTrajectories::read(double time, vector<double> &x, vector<double> &y) {
+  double dt = max(0.0, time - lastTime_);
+  lastTime_ = time;
+
+  if (kind_ == TrajectoryKind::Circle) {
+    // Each robot starts at its own angle, so that the fleet does not move in lockstep
+    double omega = kSpeed / kCircleRadius;
+    for (size_t k = 0; k < x_.size(); ++k) {
+      x_[k] = spawnX_[k] + kCircleRadius * cos(omega * time + heading_[k]);
+      y_[k] = spawnY_[k] + kCircleRadius * sin(omega * time + heading_[k]);
+    }
+  } else if (kind_ == TrajectoryKind::RandomWalk) {
+    uniform_real_distribution<double> chance(0.0, 1.0);
+    for (size_t k = 0; k < x_.size(); ++k) {
+      if (turnLeft_[k] > 0.0) {
+        // Turning in place
+        heading_[k] += turnRate_[k] * min(dt, turnLeft_[k]);
+        turnLeft_[k] -= dt;
+        continue;
+      }
+      x_[k] += kSpeed * dt * cos(heading_[k]);
+      y_[k] += kSpeed * dt * sin(heading_[k]);
+
+      // Bounce off the walls, and start a turn with a 10% chance per 64 ms, as the robot controllers
+      if (fabs(x_[k]) > limit_) {
+        x_[k] = copysign(limit_, x_[k]);
+        heading_[k] = kPi - heading_[k];
+      }
+      if (fabs(y_[k]) > limit_) {
+        y_[k] = copysign(limit_, y_[k]);
+        heading_[k] = -heading_[k];
+      }
+      if (chance(random_) < 0.1 * dt / 0.064) {
+        turnRate_[k] = chance(random_) < 0.5 ? 2.0 : -2.0;  // rad/s
+        turnLeft_[k] = 0.064 * (5 + 15 * chance(random_));
+      }
+    }
+  }
+
+  copy(x_.begin(), x_.end(), x.begin());
+  copy(y_.begin(), y_.end(), y.begin());
+}
+
+// RecordedTrajectories
+
+RecordedTrajectories::RecordedTrajectories(const vector<RobotConfig> &robots) :
+  samples_(robots.size()),
+  cursor_(robots.size(), 0) {
+  for (const RobotConfig &robot : robots) {
+    spawnX_.push_back(robot.x);
+    spawnY_.push_back(robot.y);
+  }
+}
+
+bool RecordedTrajectories::load(const string &filename, string *error) {
+  ifstream file(filename);
+  if (!file) {
+    if (error)
+      *error = "could not open " + filename;
+    return false;
+  }
+
+  // position,time,robot,index,label,x,y,...
+  string line;
+  size_t rows = 0;
+  while (getline(file, line)) {
+    if (line.compare(0, 9, "position,") != 0)
+      continue;
+    double time, x, y;
+    unsigned robot, index;
+    int label;
+    if (sscanf(line.c_str() + 9, "%lf,%u,%u,%d,%lf,%lf", &time, &robot, &index, &label, &x, &y) != 6 ||
+        robot >= samples_.size())
+      continue;
+    samples_[robot].push_back({time, x, y});
+    duration_ = max(duration_, time);
+    ++rows;
+  }
+  if (rows == 0) {
+    if (error)
+      *error = "no position of the fleet's robots in " + filename;
+    return false;
+  }
+  for (vector<Sample> &robot : samples_)
+    stable_sort(robot.begin(), robot.end(), [](const Sample &a, const Sample &b) { return a.time < b.time; });
+  fill(cursor_.begin(), cursor_.end(), 0);
+  return true;
+}
+
+void RecordedTrajectories::read(double time, vector<double> &x, vector<double> &y) {
+  for (size_t k = 0; k < samples_.size(); ++k) {
+    const vector<Sample> &robot = samples_[k];
+    size_t &cursor = cursor_[k];
+    if (cursor > 0 && robot[cursor - 1].time > time)
+      cursor = 0;  // Going back in time
+    while (cursor < robot.size() && robot[cursor].time <= time)
+      ++cursor;
+    x[k] = cursor > 0 ? robot[cursor - 1].x : spawnX_[k];
+    y[k] = cursor > 0 ? robot[cursor - 1].y : spawnY_[k];
+  }
+}
+
+// LoopbackRadio
+
+bool LoopbackRadio::loadModel(const void *data, size_t size, string *error) {
+  if (!model_.load((const unsigned char *)data, size, error))
+    return false;
+  input_.resize(model_.inputSize());
+  probabilities_.resize(model_.outputSize());
+  classCount_ = (uint8_t)min(probabilities_.size(), kMaxResultClasses);
+  return true;
+}
+
+void LoopbackRadio::send(int, const void *data, size_t size) {
+  // The window goes to the robot named in the packet, whatever the channel
+  WindowPacketHeader header;
+  ++windowsReceived_;
+  if (!model_.isLoaded())
+    return;
+  features_.resize(kMaxFeatures);
+  if (!decodeWindowPacket(data, size, header, input_.data(), input_.size(), features_.data(), features_.size())) {
+    ++malformedWindows_;
+    return;
+  }
+  if (header.sampleCount != input_.size())
+    return;  // Features only, which the CNN cannot classify
+
+  auto inferenceStart = chrono::steady_clock::now();
+  model_.invoke(input_.data(), probabilities_.data());
+  float inferenceTime = chrono::duration<float, micro>(chrono::steady_clock::now() - inferenceStart).count();
+  int label = (int)(max_element(probabilities_.begin(), probabilities_.end()) - probabilities_.begin());
+  ResultPacketHeader result = {header.robotId, header.sequence, label, inferenceTime, classCount_};
+  size_t offset = outbox_.size();
+  outbox_.resize(offset + resultPacketSize(classCount_));
+  outboxSizes_.push_back(encodeResultPacket(result, probabilities_.data(), &outbox_[offset]));
+}
+
+void LoopbackRadio::deliver() {
+  // Results not taken yet stay in front of the new ones
+  inbox_.erase(inbox_.begin(), inbox_.begin() + inboxOffset_);
+  inboxSizes_.erase(inboxSizes_.begin(), inboxSizes_.begin() + inboxCursor_);
+  inbox_.insert(inbox_.end(), outbox_.begin(), outbox_.end());
+  inboxSizes_.insert(inboxSizes_.end(), outboxSizes_.begin(), outboxSizes_.end());
+  inboxCursor_ = 0;
+  inboxOffset_ = 0;
+  outbox_.clear();
+  outboxSizes_.clear();
+}
+
+void LoopbackRadio::nextPacket() {
+  inboxOffset_ += inboxSizes_[inboxCursor_];
+  ++inboxCursor_;
+}
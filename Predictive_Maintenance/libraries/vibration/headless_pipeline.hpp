@@ -0,0 +1,104 @@
+// File: headless_pipeline.hpp
+// Description: Stand-ins for the simulator, to run the SupervisorPipeline without Webots: scripted
+// robot trajectories, and an in-memory radio whose robots classify their windows with the native
+// CNN and answer with result packets. Everything is deterministic for a given seed.
+
+#ifndef HEADLESS_PIPELINE_HPP
+#define HEADLESS_PIPELINE_HPP
+
+#include "cnn_model.hpp"
+#include "supervisor_pipeline.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+enum class TrajectoryKind {
+  Still,      // The robots stay where they spawned
+  Circle,     // Circles of kCircleRadius around the spawn positions
+  RandomWalk  // Straight runs and random turns, bouncing off the arena walls, as the e-puck controllers
+};
+
+// Parse "still", "circle" or "random-walk"; returns false for anything else
+bool parseTrajectoryKind(const std::string &name, TrajectoryKind &kind);
+
+class ScriptedTrajectories : public RobotPoses {
+public:
+  static constexpr double kSpeed = 0.064;        // m/s, an e-puck at half its top wheel speed
+  static constexpr double kCircleRadius = 0.5;   // m
+
+  ScriptedTrajectories(const std::vector<RobotConfig> &robots, TrajectoryKind kind, double arenaSize, uint32_t seed = 1);
+
+  void read(double time, std::vector<double> &x, std::vector<double> &y) override;
+
+private:
+  TrajectoryKind kind_;
+  double limit_;  // Largest coordinate a robot can reach
+  std::vector<double> spawnX_, spawnY_;
+  std::vector<double> x_, y_, heading_;
+  std::vector<double> turnRate_, turnLeft_;  // Angular speed and remaining time of the turn in progress
+  double lastTime_ = 0.0;
+  std::mt19937 random_;
+};
+
+// Positions recorded by a supervisor run: the "position" rows of a CSV telemetry file (see
+// telemetry.hpp). Each robot is at its latest recorded position at or before the requested time,
+// and stays where it spawned before its first one.
+class RecordedTrajectories : public RobotPoses {
+public:
+  explicit RecordedTrajectories(const std::vector<RobotConfig> &robots);
+
+  // Returns false, with a reason in error, if the file cannot be read or has no position row
+  bool load(const std::string &filename, std::string *error = nullptr);
+  // Time of the last recorded position
+  double duration() const { return duration_; }
+
+  void read(double time, std::vector<double> &x, std::vector<double> &y) override;
+
+private:
+  struct Sample {
+    double time, x, y;
+  };
+
+  std::vector<double> spawnX_, spawnY_;
+  std::vector<std::vector<Sample>> samples_;  // Per robot, in time order
+  std::vector<size_t> cursor_;
+  double duration_ = 0.0;
+};
+
+// Delivers window packets to stand-in robots, which run the CNN and queue their results. Results
+// reach the supervisor at the next step, as they would through Webots.
+class LoopbackRadio : public WindowEmitter, public ResultReceiver {
+public:
+  // The robots classify with the given TFLite flatbuffer; without one, they only count the windows
+  bool loadModel(const void *data, size_t size, std::string *error = nullptr);
+
+  // Make the results of the windows sent so far available to the receiver
+  void deliver();
+
+  void send(int channel, const void *data, size_t size) override;
+  size_t queueLength() const override { return inboxSizes_.size() - inboxCursor_; }
+  const void *data() const override { return &inbox_[inboxOffset_]; }
+  size_t dataSize() const override { return inboxSizes_[inboxCursor_]; }
+  void nextPacket() override;
+
+  uint64_t windowsReceived() const { return windowsReceived_; }
+  uint64_t malformedWindows() const { return malformedWindows_; }
+
+private:
+  CnnModel model_;
+  std::vector<float> input_, features_, probabilities_;
+  uint8_t classCount_ = 0;
+
+  // Result packets back to back, with their sizes: outbox_ is filled by send(), inbox_ read by the receiver
+  std::vector<unsigned char> outbox_, inbox_;
+  std::vector<size_t> outboxSizes_, inboxSizes_;
+  size_t inboxCursor_ = 0, inboxOffset_ = 0;
+
+  uint64_t windowsReceived_ = 0;
+  uint64_t malformedWindows_ = 0;
+};
+
+#endif  // HEADLESS_PIPELINE_HPP
@@ -0,0 +1,125 @@
+// File: instrumentation.cpp
+// Description: Percentiles, summaries and CSV dumps of the instrumentation histograms and counters.
+
+#include "instrumentation.hpp"
+
+#include <fstream>
+#include <iomanip>
+
+using namespace std;
+
+// Histogram
+
+Histogram::Histogram() {
+  reset();
+}
+
+void Histogram::reset() {
+  for (atomic<uint64_t> &bucket : buckets_)
+    bucket.store(0, memory_order_relaxed);
+  count_.store(0, memory_order_relaxed);
+  sum_.store(0, memory_order_relaxed);
+  max_.store(0, memory_order_relaxed);
+}
+
+uint64_t Histogram::bucketUpperBound(size_t index) {
+  const size_t kSubBuckets = (size_t)1 << kSubBucketBits;
+  if (index < kSubBuckets)
+    return index;
+  int shift = (int)(index >> kSubBucketBits) - 1;
+  uint64_t lower = (uint64_t)(kSubBuckets + (index & (kSubBuckets - 1))) << shift;
+  return lower + (((uint64_t)1 << shift) - 1);
+}
+
+double Histogram::mean() const {
+  uint64_t n = count();
+  return n > 0 ? (double)sum_.load(memory_order_relaxed) / n : 0.0;
+}
+
+uint64_t Histogram::percentile(double percent) const {
+  // The buckets are read one by one while other threads may record, so rank against their own total
+  uint64_t total = 0;
+  for (const atomic<uint64_t> &bucket : buckets_)
+    total += bucket.load(memory_order_relaxed);
+  if (total == 0)
+    return 0;
+  uint64_t rank = (uint64_t)(percent / 100.0 * (total - 1)) + 1, seen = 0;
+  for (size_t i = 0; i < kBucketCount; ++i) {
+    seen += buckets_[i].load(memory_order_relaxed);
+    if (seen >= rank)
+      return min(bucketUpperBound(i), max());
+  }
+  return max();
+}
+
+// Metrics
+
+Histogram &Metrics::histogram(const string &name, const string &unit) {
+  histograms_.push_back({name, unit, unique_ptr<Histogram>(new Histogram())});
+  return *histograms_.back().histogram;
+}
+
+Counter &Metrics::counter(const string &name) {
+  counters_.push_back({name, unique_ptr<Counter>(new Counter())});
+  return *counters_.back().counter;
+}
+
+// Function to print a value in its unit, nanoseconds as microseconds
+static void printValue(ostream &out, double value, const string &unit) {
+  if (unit == "ns")
+    out << setw(10) << value / 1000.0;
+  else
+    out << setw(10) << value;
+}
+
+void Metrics::printSummary(ostream &out, double seconds) const {
+  ios::fmtflags flags = out.flags();
+  streamsize precision = out.precision();
+  out << fixed << setprecision(1) << left << setw(24) << "metric" << right << setw(6) << "unit" << setw(10) << "count"
+      << setw(10) << "mean" << setw(10) << "p50" << setw(10) << "p90" << setw(10) << "p99" << setw(10) << "p99.9"
+      << setw(10) << "max" << "\n";
+  for (const NamedHistogram &entry : histograms_) {
+    const Histogram &h = *entry.histogram;
+    out << left << setw(24) << entry.name << right << setw(6) << (entry.unit == "ns" ? "us" : entry.unit) << setw(10)
+        << h.count();
+    printValue(out, h.mean(), entry.unit);
+    for (double percent : {50.0, 90.0, 99.0, 99.9})
+      printValue(out, (double)h.percentile(percent), entry.unit);
+    printValue(out, (double)h.max(), entry.unit);
+    out << "\n";
+  }
+  for (const NamedCounter &entry : counters_)
+    out << left << setw(24) << entry.name << right << setw(16) << entry.counter->value() << "  ("
+        << (seconds > 0.0 ? entry.counter->value() / seconds : 0.0) << "/s)\n";
+  out.flags(flags);
+  out.precision(precision);
+  out.flush();
+}
+
+bool Metrics::writeCsv(const string &filename, double seconds) const {
+  ofstream file(filename);
+  if (!file.is_open())
+    return false;
+
+  file << "kind,name,unit,count,mean,p50,p90,p99,p99.9,max,rate\n";
+  for (const NamedHistogram &entry : histograms_) {
+    const Histogram &h = *entry.histogram;
+    file << "histogram," << entry.name << "," << entry.unit << "," << h.count() << "," << h.mean();
+    for (double percent : {50.0, 90.0, 99.0, 99.9})
+      file << "," << h.percentile(percent);
+    file << "," << h.max() << ",\n";
+  }
+  for (const NamedCounter &entry : counters_)
+    file << "counter," << entry.name << ",," << entry.counter->value() << ",,,,,,,"
+         << (seconds > 0.0 ? entry.counter->value() / seconds : 0.0) << "\n";
+
+  // Non-empty buckets, as the upper bound of each, so the histograms can be merged or replotted
+  file << "\nbucket,name,upper_bound,count\n";
+  for (const NamedHistogram &entry : histograms_)
+    for (size_t i = 0; i < Histogram::kBucketCount; ++i) {
+      uint64_t count = entry.histogram->bucketCount(i);
+      if (count > 0)
+        file << "bucket," << entry.name << "," << Histogram::bucketUpperBound(i) << "," << count << "\n";
+    }
+  return file.good();
+}
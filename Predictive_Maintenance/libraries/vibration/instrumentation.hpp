@@ -0,0 +1,136 @@
+// File: instrumentation.hpp
+// Description: Low-overhead timing and counting for the supervisor loop: log-linear (HDR-style)
+// histograms and counters, updated with relaxed atomics so that any thread can record while another
+// prints a summary, and a clock that splits a step into phases.
+//
+// Compile-time switch: recording is compiled in only when VIBRATION_INSTRUMENTATION is 1. Otherwise
+// every record, add and lap call is an empty inline function. The supervisor pipeline records from
+// inside the library, so the library and the controllers must be built with the same setting: the
+// Webots Makefiles of both take it from instrumentation.mk.
+
+#ifndef INSTRUMENTATION_HPP
+#define INSTRUMENTATION_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#ifndef VIBRATION_INSTRUMENTATION
+#define VIBRATION_INSTRUMENTATION 0
+#endif
+
+const bool kInstrumentationEnabled = VIBRATION_INSTRUMENTATION != 0;
+
+// Histogram of non-negative integers (e.g. nanoseconds). Values below 2^kSubBucketBits have their
+// own bucket; above, each power of two is split in 2^kSubBucketBits buckets, so a value is known to
+// within 1 / 2^kSubBucketBits (3%) of itself over the whole 64-bit range, in a fixed 15 kB.
+class Histogram {
+public:
+  static const int kSubBucketBits = 5;
+  static const size_t kBucketCount = (size_t)(65 - kSubBucketBits) << kSubBucketBits;
+
+  Histogram();
+
+  void record(uint64_t value) {
+    if (!kInstrumentationEnabled)
+      return;
+    buckets_[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+    uint64_t largest = max_.load(std::memory_order_relaxed);
+    while (value > largest && !max_.compare_exchange_weak(largest, value, std::memory_order_relaxed)) {
+    }
+  }
+
+  uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+  uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+  uint64_t bucketCount(size_t index) const { return buckets_[index].load(std::memory_order_relaxed); }
+  double mean() const;
+  // Upper bound of the bucket holding the given percentile (0 to 100), 0 when empty
+  uint64_t percentile(double percent) const;
+  void reset();
+
+  static size_t bucketIndex(uint64_t value) {
+    if (value < (1u << kSubBucketBits))
+      return (size_t)value;
+    int shift = 63 - __builtin_clzll(value) - kSubBucketBits;  // Bits below the kSubBucketBits after the leading one
+    return ((size_t)(shift + 1) << kSubBucketBits) + (size_t)((value >> shift) & ((1u << kSubBucketBits) - 1));
+  }
+  static uint64_t bucketUpperBound(size_t index);
+
+private:
+  std::atomic<uint64_t> buckets_[kBucketCount];
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> sum_;
+  std::atomic<uint64_t> max_;
+};
+
+class Counter {
+public:
+  void add(uint64_t amount = 1) {
+    if (kInstrumentationEnabled)
+      value_.fetch_add(amount, std::memory_order_relaxed);
+  }
+  uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<uint64_t> value_{0};
+};
+
+// Named histograms and counters, reported together. Histograms and counters stay at the same address
+// once added, so callers keep references to them.
+class Metrics {
+public:
+  // unit is printed with the values; "ns" values are printed in microseconds
+  Histogram &histogram(const std::string &name, const std::string &unit);
+  Counter &counter(const std::string &name);
+
+  // Human-readable table of count, mean, p50, p90, p99, p99.9 and max, and counters with their rate
+  // over `seconds` (of wall-clock time)
+  void printSummary(std::ostream &out, double seconds) const;
+  // Machine-readable dump: one CSV row per histogram and counter, then the non-empty buckets
+  bool writeCsv(const std::string &filename, double seconds) const;
+
+private:
+  struct NamedHistogram {
+    std::string name;
+    std::string unit;
+    std::unique_ptr<Histogram> histogram;
+  };
+  struct NamedCounter {
+    std::string name;
+    std::unique_ptr<Counter> counter;
+  };
+
+  std::vector<NamedHistogram> histograms_;
+  std::vector<NamedCounter> counters_;
+};
+
+// Splits a loop iteration into phases: each lap() records the nanoseconds since the previous lap
+// (or start()) into a histogram
+class PhaseClock {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  void start() {
+    if (kInstrumentationEnabled)
+      last_ = Clock::now();
+  }
+  void lap(Histogram &phase) {
+    if (!kInstrumentationEnabled)
+      return;
+    Clock::time_point now = Clock::now();
+    phase.record((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_).count());
+    last_ = now;
+  }
+
+private:
+  Clock::time_point last_;
+};
+
+#endif  // INSTRUMENTATION_HPP
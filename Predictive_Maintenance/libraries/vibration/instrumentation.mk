@@ -0,0 +1,7 @@
+# Build setting of the vibration instrumentation (instrumentation.hpp), included by the Makefile of
+# the library and by the supervisor's: the pipeline records from inside the library, so both must be
+# built with the same setting. Set it to 1 here to time the phases of each step and the window
+# latencies, then run `make clean` in both directories so that no object keeps the old setting.
+
+VIBRATION_INSTRUMENTATION = 0
+CFLAGS += -DVIBRATION_INSTRUMENTATION=$(VIBRATION_INSTRUMENTATION)
@@ -0,0 +1,470 @@
+// File: map_store.cpp
+// Description: Chunk codec, writer and LRU-cached reader of the vibration map store.
+
+#include "map_store.hpp"
+
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+const char kMapStoreMagic[4] = {'P', 'M', 'V', 'M'};
+
+static const size_t kBlockValues = 128;  // Values packed at the same bit width
+static const float kMaxQuantized = 536870912.0f;  // 2^29, so that deltas (up to 2^30) zigzag into 32 bits
+
+MapStoreLayout mapStoreLayout(const VibrationMap &map, size_t chunkSteps, size_t tileSize, float quantum) {
+  MapStoreLayout layout;
+  if (!map.fields().empty()) {
+    const AttenuationField &grid = map.fields()[0];
+    layout.minX = grid.minX();
+    layout.minY = grid.minY();
+    layout.resolution = grid.resolution();
+    layout.columns = grid.columns();
+    layout.rows = grid.rows();
+  }
+  layout.steps = map.steps();
+  layout.stepRate = map.stepRate();
+  layout.loops = map.loops();
+  layout.chunkSteps = chunkSteps;
+  layout.tileSize = tileSize;
+  layout.quantum = quantum;
+  return layout;
+}
+
+// Chunk codec
+
+void encodeMapChunk(const float *values, size_t steps, size_t nodes, float quantum, vector<unsigned char> &out) {
+  // Zigzagged deltas along the steps of each node's x, y and z series
+  size_t count = steps * nodes * 3;
+  vector<uint32_t> deltas(count);
+  float inverse = 1.0f / quantum;
+  for (size_t series = 0; series < nodes * 3; ++series) {
+    int64_t previous = 0;
+    for (size_t t = 0; t < steps; ++t) {
+      float scaled = values[t * nodes * 3 + series] * inverse;
+      scaled = scaled < -kMaxQuantized ? -kMaxQuantized : scaled > kMaxQuantized ? kMaxQuantized : scaled;
+      int64_t quantized = (int64_t)lrintf(scaled);
+      int64_t delta = quantized - previous;
+      previous = quantized;
+      deltas[series * steps + t] = (uint32_t)((delta << 1) ^ (delta >> 63));
+    }
+  }
+
+  // Blocks of a width byte and the deltas packed at that width, least significant bit first
+  for (size_t block = 0; block < count; block += kBlockValues) {
+    size_t blockCount = min(kBlockValues, count - block);
+    uint32_t all = 0;
+    for (size_t i = 0; i < blockCount; ++i)
+      all |= deltas[block + i];
+    unsigned width = 0;
+    while (width < 32 && (all >> width) != 0)
+      ++width;
+    out.push_back((unsigned char)width);
+
+    uint64_t bits = 0;
+    unsigned pending = 0;
+    for (size_t i = 0; i < blockCount && width > 0; ++i) {
+      bits |= (uint64_t)deltas[block + i] << pending;
+      pending += width;
+      while (pending >= 8) {
+        out.push_back((unsigned char)bits);
+        bits >>= 8;
+        pending -= 8;
+      }
+    }
+    if (pending > 0)
+      out.push_back((unsigned char)bits);
+  }
+}
+
+bool decodeMapChunk(const unsigned char *data, size_t size, size_t steps, size_t nodes, float quantum, float *values) {
+  size_t count = steps * nodes * 3;
+  const unsigned char *end = data + size;
+  size_t series = 0, t = 0;
+  int64_t previous = 0;
+  for (size_t block = 0; block < count; block += kBlockValues) {
+    size_t blockCount = min(kBlockValues, count - block);
+    if (data == end)
+      return false;
+    unsigned width = *data++;
+    if (width > 32 || (size_t)(end - data) < (blockCount * width + 7) / 8)
+      return false;
+
+    uint64_t bits = 0;
+    unsigned available = 0;
+    uint64_t mask = width == 32 ? 0xffffffffull : ((uint64_t)1 << width) - 1;
+    for (size_t i = 0; i < blockCount; ++i) {
+      while (available < width) {
+        bits |= (uint64_t)*data++ << available;
+        available += 8;
+      }
+      uint32_t zigzag = (uint32_t)(bits & mask);
+      bits >>= width;
+      available -= width;
+
+      int64_t delta = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+      previous += delta;
+      values[t * nodes * 3 + series] = (float)previous * quantum;
+      if (++t == steps) {
+        t = 0;
+        ++series;
+        previous = 0;
+      }
+    }
+  }
+  return data == end;
+}
+
+// MapStoreWriter
+
+MapStoreWriter::~MapStoreWriter() {
+  close();
+}
+
+bool MapStoreWriter::open(const string &filename, const MapStoreLayout &layout, string *error) {
+  close();
+  if (layout.columns == 0 || layout.rows == 0 || layout.steps == 0 || layout.chunkSteps == 0 || layout.tileSize == 0 ||
+      !(layout.quantum > 0.0f)) {
+    if (error)
+      *error = "empty map or invalid chunk layout";
+    return false;
+  }
+  file_ = fopen(filename.c_str(), "wb");
+  if (!file_) {
+    if (error)
+      *error = "could not create " + filename;
+    return false;
+  }
+  layout_ = layout;
+  index_.assign(layout.chunkCount(), MapChunkEntry());
+
+  // Placeholder header, rewritten with the index offset on close()
+  MapStoreHeader header = {};
+  offset_ = sizeof(header);
+  if (fwrite(&header, sizeof(header), 1, file_) != 1) {
+    if (error)
+      *error = "could not write " + filename;
+    fclose(file_);
+    file_ = nullptr;
+    return false;
+  }
+  return true;
+}
+
+bool MapStoreWriter::writeChunk(size_t timeChunk, size_t tileRow, size_t tileColumn, const float *values) {
+  if (!file_ || timeChunk >= layout_.timeChunks() || tileRow >= layout_.tileRows() || tileColumn >= layout_.tileColumns())
+    return false;
+  encoded_.clear();
+  size_t nodes = layout_.rowsIn(tileRow) * layout_.columnsIn(tileColumn);
+  encodeMapChunk(values, layout_.stepsIn(timeChunk), nodes, layout_.quantum, encoded_);
+  return writeEncodedChunk(layout_.chunkIndex(timeChunk, tileRow, tileColumn), encoded_.data(), encoded_.size());
+}
+
+bool MapStoreWriter::writeEncodedChunk(size_t chunk, const unsigned char *data, size_t size) {
+  if (!file_ || chunk >= index_.size() || size > 0xffffffffu)
+    return false;
+  if (fwrite(data, 1, size, file_) != size)
+    return false;
+  index_[chunk].offset = offset_;
+  index_[chunk].size = (uint32_t)size;
+  offset_ += size;
+  return true;
+}
+
+bool MapStoreWriter::close(string *error) {
+  if (!file_)
+    return true;
+
+  MapStoreHeader header = {};
+  memcpy(header.magic, kMapStoreMagic, sizeof(header.magic));
+  header.version = kMapStoreVersion;
+  header.flags = layout_.loops ? kMapStoreLoops : 0;
+  header.minX = layout_.minX;
+  header.minY = layout_.minY;
+  header.resolution = layout_.resolution;
+  header.stepRate = layout_.stepRate;
+  header.quantum = layout_.quantum;
+  header.columns = (uint32_t)layout_.columns;
+  header.rows = (uint32_t)layout_.rows;
+  header.chunkSteps = (uint32_t)layout_.chunkSteps;
+  header.tileSize = (uint32_t)layout_.tileSize;
+  header.steps = layout_.steps;
+
+  // The index starts 8-byte aligned, so that the reader can use it in place
+  static const char padding[8] = {};
+  size_t paddingSize = (8 - offset_ % 8) % 8;
+  header.indexOffset = offset_ + paddingSize;
+
+  bool ok = fwrite(padding, 1, paddingSize, file_) == paddingSize &&
+            fwrite(index_.data(), sizeof(MapChunkEntry), index_.size(), file_) == index_.size() &&
+            fseek(file_, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file_) == 1;
+  ok = fclose(file_) == 0 && ok;
+  file_ = nullptr;
+  if (!ok && error)
+    *error = "could not write the map store";
+  return ok;
+}
+
+bool writeMapStore(const VibrationMap &map, const string &filename, const MapStoreLayout &layout, size_t threads,
+                   string *error) {
+  MapStoreLayout mapLayout = mapStoreLayout(map);
+  if (layout.columns != mapLayout.columns || layout.rows != mapLayout.rows || layout.steps != mapLayout.steps) {
+    if (error)
+      *error = "the layout does not match the map's grid";
+    return false;
+  }
+  if (!map.periodic()) {
+    if (error)
+      *error = "looping sources of different lengths cannot be stored";
+    return false;
+  }
+  MapStoreWriter writer;
+  if (!writer.open(filename, layout, error))
+    return false;
+
+  size_t chunks = layout.chunkCount();
+  if (threads == 0)
+    threads = max(1u, thread::hardware_concurrency());
+  threads = min(threads, chunks);
+
+  // Chunks are claimed in index order and written in that order as soon as the previous ones are;
+  // a worker waits when its chunk would be more than `window` chunks ahead of the file
+  size_t window = 4 * threads;
+  vector<vector<unsigned char>> pending(window);
+  vector<bool> ready(window, false);
+  size_t nextChunk = 0, nextWrite = 0;
+  bool failed = false;
+  mutex chunksMutex;
+  condition_variable written;
+
+  auto work = [&]() {
+    vector<float> values(layout.chunkSteps * layout.tileSize * layout.tileSize * 3);
+    vector<unsigned char> encoded;
+    for (;;) {
+      size_t chunk;
+      {
+        unique_lock<mutex> lock(chunksMutex);
+        written.wait(lock, [&]() { return failed || nextChunk >= chunks || nextChunk < nextWrite + window; });
+        if (failed || nextChunk >= chunks)
+          return;
+        chunk = nextChunk++;
+      }
+
+      // The nodes of the chunk's tile at each of its steps, computed in place
+      size_t tileColumns = layout.tileColumns(), tileRows = layout.tileRows();
+      size_t timeChunk = chunk / (tileRows * tileColumns);
+      size_t tileRow = chunk / tileColumns % tileRows, tileColumn = chunk % tileColumns;
+      size_t steps = layout.stepsIn(timeChunk);
+      size_t columns = layout.columnsIn(tileColumn), rows = layout.rowsIn(tileRow);
+      for (size_t t = 0; t < steps; ++t)
+        map.queryNodes((uint64_t)timeChunk * layout.chunkSteps + t, tileColumn * layout.tileSize,
+                       tileRow * layout.tileSize, columns, rows, &values[t * rows * columns * 3]);
+      encoded.clear();
+      encodeMapChunk(values.data(), steps, rows * columns, layout.quantum, encoded);
+
+      unique_lock<mutex> lock(chunksMutex);
+      pending[chunk % window].swap(encoded);
+      ready[chunk % window] = true;
+      while (!failed && nextWrite < chunks && ready[nextWrite % window]) {
+        const vector<unsigned char> &data = pending[nextWrite % window];
+        failed = !writer.writeEncodedChunk(nextWrite, data.data(), data.size());
+        ready[nextWrite % window] = false;
+        ++nextWrite;
+      }
+      written.notify_all();
+    }
+  };
+  vector<thread> workers;
+  for (size_t t = 1; t < threads; ++t)
+    workers.emplace_back(work);
+  work();
+  for (thread &worker : workers)
+    worker.join();
+
+  if (failed) {
+    if (error)
+      *error = "could not write " + filename;
+    writer.close();
+    return false;
+  }
+  return writer.close(error);
+}
+
+// MapStoreReader
+
+bool MapStoreReader::open(const string &filename, string *error) {
+  close();
+  // Queries touch a few chunks scattered over the file, so read-ahead would only waste the page cache
+  if (!file_.open(filename, FileAccess::Random)) {
+    if (error)
+      *error = "could not open " + filename;
+    return false;
+  }
+
+  MapStoreHeader header;
+  const char *problem = nullptr;
+  if (file_.size() < sizeof(header))
+    problem = "not a vibration map store";
+  else {
+    memcpy(&header, file_.data(), sizeof(header));
+    if (memcmp(header.magic, kMapStoreMagic, sizeof(header.magic)) != 0)
+      problem = "not a vibration map store";
+    else if (header.version != kMapStoreVersion)
+      problem = "unsupported vibration map store version";
+    else if (header.columns == 0 || header.rows == 0 || header.steps == 0 || header.chunkSteps == 0 ||
+             header.tileSize == 0 || !(header.quantum > 0.0f))
+      problem = "invalid vibration map store layout";
+  }
+  if (!problem) {
+    layout_.minX = header.minX;
+    layout_.minY = header.minY;
+    layout_.resolution = header.resolution;
+    layout_.columns = header.columns;
+    layout_.rows = header.rows;
+    layout_.steps = header.steps;
+    layout_.stepRate = header.stepRate;
+    layout_.loops = (header.flags & kMapStoreLoops) != 0;
+    layout_.chunkSteps = header.chunkSteps;
+    layout_.tileSize = header.tileSize;
+    layout_.quantum = header.quantum;
+    if (header.indexOffset > file_.size() || header.indexOffset % 8 != 0 ||
+        (file_.size() - header.indexOffset) / sizeof(MapChunkEntry) < layout_.chunkCount())
+      problem = "truncated vibration map store";
+    else
+      index_ = (const MapChunkEntry *)(file_.data() + header.indexOffset);
+  }
+  if (problem) {
+    if (error)
+      *error = problem;
+    close();
+    return false;
+  }
+  return true;
+}
+
+void MapStoreReader::close() {
+  file_.close();
+  layout_ = MapStoreLayout();
+  index_ = nullptr;
+  cache_.clear();
+  use_.clear();
+  lastChunk_ = (size_t)-1;
+  last_ = nullptr;
+}
+
+const MapStoreReader::CachedChunk &MapStoreReader::chunk(size_t index) const {
+  if (index == lastChunk_)
+    return *last_;
+
+  auto cached = cache_.find(index);
+  if (cached != cache_.end()) {
+    ++hits_;
+    use_.splice(use_.begin(), use_, cached->second.use);
+  } else {
+    ++misses_;
+    if (cache_.size() >= cacheChunks_) {
+      cache_.erase(use_.back());
+      use_.pop_back();
+    }
+    use_.push_front(index);
+    cached = cache_.emplace(index, CachedChunk()).first;
+    cached->second.use = use_.begin();
+
+    size_t tileColumns = layout_.tileColumns(), tileRows = layout_.tileRows();
+    size_t timeChunk = index / (tileRows * tileColumns);
+    size_t tileRow = index / tileColumns % tileRows, tileColumn = index % tileColumns;
+    size_t steps = layout_.stepsIn(timeChunk);
+    size_t nodes = layout_.rowsIn(tileRow) * layout_.columnsIn(tileColumn);
+    vector<float> &values = cached->second.values;
+    values.assign(steps * nodes * 3, 0.0f);
+
+    // Unwritten chunks read as zeros, corrupt ones too
+    const MapChunkEntry &entry = index_[index];
+    bool inFile = entry.offset >= sizeof(MapStoreHeader) && entry.offset <= file_.size() &&
+                  entry.size <= file_.size() - entry.offset;
+    if (entry.offset != 0 &&
+        (!inFile || !decodeMapChunk((const unsigned char *)file_.data() + entry.offset, entry.size, steps, nodes,
+                                    layout_.quantum, values.data()))) {
+      ++corrupt_;
+      fill(values.begin(), values.end(), 0.0f);
+    }
+  }
+  lastChunk_ = index;
+  last_ = &cached->second;
+  return cached->second;
+}
+
+const float *MapStoreReader::node(size_t i, size_t j, uint64_t step) const {
+  size_t timeChunk = (size_t)(step / layout_.chunkSteps);
+  size_t tileRow = j / layout_.tileSize, tileColumn = i / layout_.tileSize;
+  const CachedChunk &cached = chunk(layout_.chunkIndex(timeChunk, tileRow, tileColumn));
+  size_t t = (size_t)(step % layout_.chunkSteps);
+  size_t columns = layout_.columnsIn(tileColumn);
+  size_t nodes = layout_.rowsIn(tileRow) * columns;
+  return &cached.values[(t * nodes + (j % layout_.tileSize) * columns + i % layout_.tileSize) * 3];
+}
+
+size_t MapStoreReader::nodeColumn(double x) const {
+  double cell = floor((x - layout_.minX) * layout_.resolution);
+  return cell <= 0.0 ? 0 : cell >= layout_.columns - 1 ? layout_.columns - 1 : (size_t)cell;
+}
+
+size_t MapStoreReader::nodeRow(double y) const {
+  double cell = floor((y - layout_.minY) * layout_.resolution);
+  return cell <= 0.0 ? 0 : cell >= layout_.rows - 1 ? layout_.rows - 1 : (size_t)cell;
+}
+
+void MapStoreReader::query(double x, double y, uint64_t step, bool interpolate, float reading[3]) const {
+  reading[0] = reading[1] = reading[2] = 0.0f;
+  if (!index_)
+    return;
+  if (step >= layout_.steps) {
+    if (!layout_.loops)
+      return;
+    step %= layout_.steps;
+  }
+
+  if (!interpolate) {
+    const float *value = node(nodeColumn(x), nodeRow(y), step);
+    reading[0] = value[0];
+    reading[1] = value[1];
+    reading[2] = value[2];
+    return;
+  }
+
+  // Same weights as AttenuationField::bilinear; the four nodes may lie in different chunks
+  size_t nx = layout_.columns, ny = layout_.rows;
+  double u = (x - layout_.minX) * layout_.resolution;
+  double v = (y - layout_.minY) * layout_.resolution;
+  u = u < 0.0 ? 0.0 : u > nx - 1 ? nx - 1 : u;
+  v = v < 0.0 ? 0.0 : v > ny - 1 ? ny - 1 : v;
+  size_t i = (size_t)u, j = (size_t)v;
+  size_t i1 = i + 1 < nx ? i + 1 : i;
+  size_t j1 = j + 1 < ny ? j + 1 : j;
+  float fu = (float)(u - i), fv = (float)(v - j);
+  float n00[3], n10[3], n01[3], n11[3];
+  memcpy(n00, node(i, j, step), sizeof(n00));
+  memcpy(n10, node(i1, j, step), sizeof(n10));
+  memcpy(n01, node(i, j1, step), sizeof(n01));
+  memcpy(n11, node(i1, j1, step), sizeof(n11));
+  for (int axis = 0; axis < 3; ++axis) {
+    float bottom = n00[axis] + fu * (n10[axis] - n00[axis]);
+    float top = n01[axis] + fu * (n11[axis] - n01[axis]);
+    reading[axis] = bottom + fv * (top - bottom);
+  }
+}
+
+void MapStoreReader::query(const double *x, const double *y, size_t count, uint64_t step, bool interpolate, float *outX,
+                           float *outY, float *outZ) const {
+  float reading[3];
+  for (size_t k = 0; k < count; ++k) {
+    query(x[k], y[k], step, interpolate, reading);
+    outX[k] = reading[0];
+    outY[k] = reading[1];
+    outZ[k] = reading[2];
+  }
+}
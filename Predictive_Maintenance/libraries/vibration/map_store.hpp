@@ -0,0 +1,175 @@
+// File: map_store.hpp
+// Description: Chunked, compressed on-disk store of a vibration map, so that maps too large for
+// memory (fine grids over long captures) can be precomputed once and read back at random.
+//
+// The map is cut into chunks of chunkSteps steps by tileSize x tileSize grid nodes. Every chunk is
+// compressed on its own: its values are quantized to multiples of `quantum`, each node's x, y and z
+// series is delta-coded along the steps, and the zigzagged deltas are bit-packed by blocks of 128
+// at the width of the block's largest delta. Decoded values are within quantum / 2 of the map's,
+// which are clamped to +-2^29 quanta.
+//
+// File layout (little-endian):
+//   MapStoreHeader (80 bytes)
+//   the compressed chunks, in the order they were written
+//   the index, 8-byte aligned: one MapChunkEntry per chunk in (time chunk, tile row, tile column) order
+//
+// The reader maps the file and decompresses only the chunks its queries touch, keeping the most
+// recently used ones decoded.
+
+#ifndef MAP_STORE_HPP
+#define MAP_STORE_HPP
+
+#include "mapped_file.hpp"
+#include "vibration_map.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct MapStoreHeader {
+  char magic[4];         // "PMVM"
+  uint16_t version;      // kMapStoreVersion
+  uint16_t flags;        // kMapStoreLoops
+  double minX, minY;     // Position of grid node (0, 0)
+  double resolution;     // Grid nodes per meter
+  double stepRate;       // Steps per second
+  float quantum;         // Quantization step of the values
+  uint32_t columns, rows;  // Grid nodes
+  uint32_t chunkSteps, tileSize;
+  uint32_t reserved;
+  uint64_t steps;
+  uint64_t indexOffset;  // Offset of the chunk index, written last
+};
+static_assert(sizeof(MapStoreHeader) == 80, "MapStoreHeader must stay 80 bytes");
+
+struct MapChunkEntry {
+  uint64_t offset;  // 0 for a chunk that was never written, which reads as zeros
+  uint32_t size;
+  uint32_t reserved;
+};
+static_assert(sizeof(MapChunkEntry) == 16, "MapChunkEntry must stay 16 bytes");
+
+extern const char kMapStoreMagic[4];
+const uint16_t kMapStoreVersion = 1;
+const uint16_t kMapStoreLoops = 1;  // The map is periodic, as with PlaybackEnd::Loop
+
+// Geometry of a stored map and of its chunks
+struct MapStoreLayout {
+  double minX = 0.0, minY = 0.0;
+  double resolution = 1.0;
+  size_t columns = 0, rows = 0;  // Grid nodes
+  uint64_t steps = 0;
+  double stepRate = 0.0;
+  bool loops = false;
+  size_t chunkSteps = 256;
+  size_t tileSize = 16;
+  float quantum = 1e-4f;
+
+  size_t timeChunks() const { return (size_t)((steps + chunkSteps - 1) / chunkSteps); }
+  size_t tileColumns() const { return (columns + tileSize - 1) / tileSize; }
+  size_t tileRows() const { return (rows + tileSize - 1) / tileSize; }
+  size_t chunkCount() const { return timeChunks() * tileRows() * tileColumns(); }
+  size_t chunkIndex(size_t timeChunk, size_t tileRow, size_t tileColumn) const {
+    return (timeChunk * tileRows() + tileRow) * tileColumns() + tileColumn;
+  }
+
+  // Steps and nodes of a chunk, fewer in the last time chunk and the last tile row and column
+  size_t stepsIn(size_t timeChunk) const {
+    return (size_t)std::min<uint64_t>(chunkSteps, steps - (uint64_t)timeChunk * chunkSteps);
+  }
+  size_t columnsIn(size_t tileColumn) const { return std::min(tileSize, columns - tileColumn * tileSize); }
+  size_t rowsIn(size_t tileRow) const { return std::min(tileSize, rows - tileRow * tileSize); }
+};
+
+// Geometry of the grid of a vibration map (the attenuation grid of its sources)
+MapStoreLayout mapStoreLayout(const VibrationMap &map, size_t chunkSteps = 256, size_t tileSize = 16,
+                              float quantum = 1e-4f);
+
+// Compress the values of a chunk of `steps` steps of `nodes` nodes, laid out [step][node][axis],
+// appending them to out. Decoding writes the same layout.
+void encodeMapChunk(const float *values, size_t steps, size_t nodes, float quantum, std::vector<unsigned char> &out);
+bool decodeMapChunk(const unsigned char *data, size_t size, size_t steps, size_t nodes, float quantum, float *values);
+
+// Writes the chunks of a map in any order; the index and the header are written on close()
+class MapStoreWriter {
+public:
+  ~MapStoreWriter();
+
+  bool open(const std::string &filename, const MapStoreLayout &layout, std::string *error = nullptr);
+  // Compress and append a chunk, its values laid out [step][row][column][axis] over the chunk
+  bool writeChunk(size_t timeChunk, size_t tileRow, size_t tileColumn, const float *values);
+  // Append a chunk compressed by encodeMapChunk
+  bool writeEncodedChunk(size_t chunk, const unsigned char *data, size_t size);
+  bool close(std::string *error = nullptr);
+
+  const MapStoreLayout &layout() const { return layout_; }
+  uint64_t bytesWritten() const { return offset_; }
+
+private:
+  FILE *file_ = nullptr;
+  MapStoreLayout layout_;
+  std::vector<MapChunkEntry> index_;
+  uint64_t offset_ = 0;
+  std::vector<unsigned char> encoded_;
+};
+
+// Compress a whole vibration map into a store. Worker threads (one per core with 0) compute and
+// encode a chunk at a time straight from the map, and at most a few chunks per thread wait to be
+// written, so memory does not grow with the map. The file is the same whatever the thread count.
+bool writeMapStore(const VibrationMap &map, const std::string &filename, const MapStoreLayout &layout,
+                   size_t threads = 0, std::string *error = nullptr);
+
+// Random access to a stored map. Queries decode the chunks they touch into an LRU cache, so a
+// reader must not be shared by threads; readers of the same file share its pages.
+class MapStoreReader : public VibrationField {
+public:
+  explicit MapStoreReader(size_t cacheChunks = 64) : cacheChunks_(cacheChunks ? cacheChunks : 1) {}
+
+  bool open(const std::string &filename, std::string *error = nullptr);
+  void close();
+  bool isOpen() const { return file_.isOpen(); }
+
+  // Same grid lookups as the VibrationMap the store was written from
+  void query(double x, double y, uint64_t step, bool interpolate, float reading[3]) const override;
+  void query(const double *x, const double *y, size_t count, uint64_t step, bool interpolate, float *outX, float *outY,
+             float *outZ) const override;
+  uint64_t steps() const override { return layout_.steps; }
+  bool loops() const override { return layout_.loops; }
+
+  // Vibration at grid node (i, j), at a step before steps(); valid until the next lookup
+  const float *node(size_t i, size_t j, uint64_t step) const;
+
+  const MapStoreLayout &layout() const { return layout_; }
+  uint64_t cacheHits() const { return hits_; }
+  uint64_t chunksDecoded() const { return misses_; }
+  uint64_t corruptChunks() const { return corrupt_; }
+
+private:
+  struct CachedChunk {
+    std::vector<float> values;
+    std::list<size_t>::iterator use;
+  };
+
+  const CachedChunk &chunk(size_t index) const;
+  size_t nodeColumn(double x) const;
+  size_t nodeRow(double y) const;
+
+  MappedFile file_;
+  MapStoreLayout layout_;
+  const MapChunkEntry *index_ = nullptr;
+
+  // Decoded chunks, the most recently used first in use_
+  size_t cacheChunks_;
+  mutable std::unordered_map<size_t, CachedChunk> cache_;
+  mutable std::list<size_t> use_;
+  mutable size_t lastChunk_ = (size_t)-1;
+  mutable const CachedChunk *last_ = nullptr;
+  mutable uint64_t hits_ = 0, misses_ = 0, corrupt_ = 0;
+};
+
+#endif  // MAP_STORE_HPP
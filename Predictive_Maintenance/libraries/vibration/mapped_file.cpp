@@ -0,0 +1,77 @@
+// File: mapped_file.cpp
+// Description: mmap-backed read-only file view, with a plain read fallback on Windows.
+
+#include "mapped_file.hpp"
+
+#include <fstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+MappedFile::~MappedFile() {
+  close();
+}
+
+bool MappedFile::open(const string &filename, FileAccess access) {
+  close();
+#ifndef _WIN32
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    ::close(fd);
+    return false;
+  }
+
+  size_ = (size_t)st.st_size;
+  opened_ = true;
+  if (size_ > 0) {
+    void *address = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (address == MAP_FAILED) {
+      ::close(fd);
+      size_ = 0;
+      opened_ = false;
+      return false;
+    }
+    madvise(address, size_, access == FileAccess::Random ? MADV_RANDOM : MADV_SEQUENTIAL);
+    data_ = (const char *)address;
+    mapped_ = true;
+  }
+  ::close(fd);  // The mapping stays valid after the descriptor is closed
+  return true;
+#else
+  (void)access;
+  ifstream file(filename, ios::binary | ios::ate);
+  if (!file.is_open())
+    return false;
+
+  size_ = (size_t)file.tellg();
+  fallback_.resize(size_);
+  file.seekg(0);
+  file.read(fallback_.data(), size_);
+  data_ = fallback_.data();
+  opened_ = true;
+  return true;
+#endif
+}
+
+void MappedFile::close() {
+#ifndef _WIN32
+  if (mapped_)
+    munmap((void *)data_, size_);
+#endif
+  fallback_.clear();
+  fallback_.shrink_to_fit();
+  data_ = nullptr;
+  size_ = 0;
+  opened_ = false;
+  mapped_ = false;
+}
@@ -0,0 +1,40 @@
+// File: mapped_file.hpp
+// Description: Read-only view of a whole file, memory-mapped where the platform allows it.
+
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// How the mapping will be read, passed on to the kernel's read-ahead
+enum class FileAccess {
+  Sequential,  // Front to back, once (the capture loaders)
+  Random       // Scattered reads (the chunks of a map store)
+};
+
+class MappedFile {
+public:
+  MappedFile() = default;
+  ~MappedFile();
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  // Map the file read-only; returns false (and keeps the object empty) if it cannot be opened
+  bool open(const std::string &filename, FileAccess access = FileAccess::Sequential);
+  void close();
+
+  bool isOpen() const { return opened_; }
+  const char *data() const { return data_; }
+  size_t size() const { return size_; }
+
+private:
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+  bool opened_ = false;
+  bool mapped_ = false;
+  std::vector<char> fallback_;  // Used when mmap is not available
+};
+
+#endif  // MAPPED_FILE_HPP
@@ -0,0 +1,43 @@
+// File: pose_sampler.cpp
+// Description: Subsampled robot positions with dead reckoning in between.
+
+#include "pose_sampler.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+PoseSampler::PoseSampler(RobotPoses &source, size_t robots, size_t period, double limit) :
+  source_(source),
+  period_(max<size_t>(period, 1)),
+  limit_(limit),
+  sampleX_(robots),
+  sampleY_(robots),
+  velocityX_(robots, 0.0),
+  velocityY_(robots, 0.0) {
+}
+
+void PoseSampler::read(double time, vector<double> &x, vector<double> &y) {
+  size_t robots = sampleX_.size();
+  if (reads_++ % period_ == 0) {
+    source_.read(time, x, y);
+    double dt = time - sampleTime_;
+    if (sourceReads_++ > 0 && dt > 0.0) {
+      for (size_t k = 0; k < robots; ++k) {
+        velocityX_[k] = (x[k] - sampleX_[k]) / dt;
+        velocityY_[k] = (y[k] - sampleY_[k]) / dt;
+      }
+    }
+    sampleTime_ = time;
+    copy(x.begin(), x.begin() + robots, sampleX_.begin());
+    copy(y.begin(), y.begin() + robots, sampleY_.begin());
+    return;
+  }
+
+  // Straight on at the last velocity; a robot that turned or stopped is corrected at the next sample
+  double dt = time - sampleTime_;
+  for (size_t k = 0; k < robots; ++k) {
+    x[k] = min(limit_, max(-limit_, sampleX_[k] + velocityX_[k] * dt));
+    y[k] = min(limit_, max(-limit_, sampleY_[k] + velocityY_[k] * dt));
+  }
+}
@@ -0,0 +1,40 @@
+// File: pose_sampler.hpp
+// Description: Robot positions sampled from the simulator every few steps only, and extrapolated
+// from each robot's latest velocity (dead reckoning) in between, so that the supervisor does not pay
+// the per-robot cost of reading every position at every step. Positions go straight into the
+// fleet's x and y arrays, as with any RobotPoses.
+
+#ifndef POSE_SAMPLER_HPP
+#define POSE_SAMPLER_HPP
+
+#include "supervisor_pipeline.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class PoseSampler : public RobotPoses {
+public:
+  // Read the positions of `robots` robots from source at every `period`-th step, the first one
+  // included; with a period of 1, every read goes to the source. Extrapolated positions are clamped
+  // to [-limit, limit] on both axes, the walls of an arena centred on the origin.
+  PoseSampler(RobotPoses &source, size_t robots, size_t period, double limit);
+
+  void read(double time, std::vector<double> &x, std::vector<double> &y) override;
+
+  size_t period() const { return period_; }
+  uint64_t sourceReads() const { return sourceReads_; }
+
+private:
+  RobotPoses &source_;
+  size_t period_;
+  double limit_;
+  uint64_t reads_ = 0, sourceReads_ = 0;
+
+  // Positions at the last source read, and the velocities between the last two
+  double sampleTime_ = 0.0;
+  std::vector<double> sampleX_, sampleY_;
+  std::vector<double> velocityX_, velocityY_;
+};
+
+#endif  // POSE_SAMPLER_HPP
@@ -0,0 +1,408 @@
+// File: quantized_cnn_model.cpp
+// Description: Calibration, quantization and integer kernels of QuantizedCnnModel.
+
+#include "quantized_cnn_model.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+using namespace std;
+
+const size_t kCalibrationBatch = 64;
+const size_t kMaxUnits = 64;  // Dense outputs requantized together
+const size_t kBlock = 8;      // Channels per fixed-length inner loop
+
+static bool fail(string *error, const string &message) {
+  if (error)
+    *error = message;
+  return false;
+}
+
+// Function to round a value to an integer offset by zeroPoint, clamped to [low, high] first. The
+// value is clamped in float, then rounded to nearest by adding 1.5 * 2^23 so that the integer lands
+// in the low mantissa bits: this is XNNPACK's fp32 requantization, which vectorises where 64-bit
+// fixed-point arithmetic and lrintf() do not
+static inline int32_t roundClamped(float value, float low, float high, int32_t zeroPoint) {
+  const float kMagic = 12582912.0f;
+  const int32_t kMagicBits = 0x4B400000;
+  value = min(high, max(low, value)) + kMagic;
+  int32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits - kMagicBits + zeroPoint;
+}
+
+// Function to requantize an accumulator to an int8 value clamped to the fused activation
+static inline int32_t requantize(int32_t accumulator, float scale, float low, float high, int32_t zeroPoint) {
+  return roundClamped(accumulator * scale, low, high, zeroPoint);
+}
+
+// Function to requantize count accumulators, with per-channel scales, to int8. Full blocks of
+// kBlock channels go through a local array, so that the loop has a fixed trip count and no aliasing
+static void requantizeChannels(const int32_t *accumulators, size_t count, const float *scale, size_t channels,
+                               int32_t zeroPoint, int32_t activationMin, int32_t activationMax, int8_t *out) {
+  float low = (float)(activationMin - zeroPoint), high = (float)(activationMax - zeroPoint);
+  int32_t values[kBlock];
+  for (size_t offset = 0; offset < count; offset += channels) {
+    size_t c = 0;
+    for (; c + kBlock <= channels; c += kBlock) {
+      for (size_t j = 0; j < kBlock; ++j)
+        values[j] = requantize(accumulators[offset + c + j], scale[c + j], low, high, zeroPoint);
+      for (size_t j = 0; j < kBlock; ++j)
+        out[offset + c + j] = (int8_t)values[j];
+    }
+    for (; c < channels; ++c)
+      out[offset + c] = (int8_t)requantize(accumulators[offset + c], scale[c], low, high, zeroPoint);
+  }
+}
+
+// Asymmetric int8 parameters covering [low, high], which always includes 0 so that it is exact
+static void chooseQuantization(float low, float high, float &scale, int32_t &zeroPoint) {
+  low = min(low, 0.0f);
+  high = max(high, 0.0f);
+  scale = high > low ? (high - low) / 255.0f : 1.0f;
+  zeroPoint = (int32_t)lround(-128.0 - low / scale);
+  zeroPoint = min(127, max(-128, zeroPoint));
+}
+
+static inline int8_t saturate(int32_t value) {
+  return (int8_t)min(127, max(-128, value));
+}
+
+bool QuantizedCnnModel::build(const CnnModel &model, const float *calibrationInputs, size_t count, string *error) {
+  tensors_.clear();
+  operations_.clear();
+  batchSize_ = 0;
+  if (!model.isLoaded())
+    return fail(error, "the float model is not loaded");
+  if (count == 0)
+    return fail(error, "no calibration inputs");
+  const CnnModel::Graph &graph = *model.graph_;
+  if (!graph.batchable)
+    return fail(error, "the model has no unit batch dimension");
+
+  // Range of every activation over the calibration inputs, from a copy of the float model
+  CnnModel calibration = model;
+  size_t tensorCount = graph.tensors.size();
+  vector<float> low(tensorCount, numeric_limits<float>::max()), high(tensorCount, numeric_limits<float>::lowest());
+  for (size_t first = 0; first < count; first += kCalibrationBatch) {
+    size_t batch = min(kCalibrationBatch, count - first);
+    calibration.run(calibrationInputs + first * model.inputSize_, batch);
+    for (size_t t = 0; t < tensorCount; ++t) {
+      const vector<float> &activation = calibration.activations_[t];
+      if (activation.empty())
+        continue;
+      auto range = minmax_element(activation.begin(), activation.end());
+      low[t] = min(low[t], *range.first);
+      high[t] = max(high[t], *range.second);
+    }
+  }
+
+  // Activation tensors, for a single batch entry
+  tensors_.resize(tensorCount);
+  for (size_t t = 0; t < tensorCount; ++t) {
+    const CnnModel::Tensor &source = graph.tensors[t];
+    if (source.constant || source.size == 0)
+      continue;
+    tensors_[t].shape = source.shape;
+    tensors_[t].size = source.size;
+    chooseQuantization(low[t], high[t], tensors_[t].quantization.scale, tensors_[t].quantization.zeroPoint);
+  }
+  inputTensor_ = graph.inputTensor;
+  inputSize_ = model.inputSize_;
+  outputSize_ = model.outputSize_;
+
+  // A reshape keeps the int8 values and their order, so its output is its input: later operations
+  // read the input tensor instead, and no reshape is run
+  vector<int> alias(tensorCount);
+  for (size_t t = 0; t < tensorCount; ++t)
+    alias[t] = (int)t;
+  for (size_t o = 0; o < graph.operations.size(); ++o) {
+    const CnnModel::Operation &source = graph.operations[o];
+    if (source.type == CnnModel::OpType::Softmax && o + 1 != graph.operations.size())
+      return fail(error, "softmax is only supported as the last operator");
+    if (source.type == CnnModel::OpType::Reshape) {
+      alias[source.output] = alias[source.inputs[0]];
+      tensors_[source.output] = Tensor();
+      continue;
+    }
+    Operation op = {};
+    op.type = source.type;
+    op.input = alias[source.inputs[0]];
+    op.output = source.output;
+    op.samePadding = source.samePadding;
+    op.strideW = source.strideW;
+    op.strideH = source.strideH;
+    op.filterW = source.filterW;
+    op.filterH = source.filterH;
+    op.dilationW = source.dilationW;
+    op.dilationH = source.dilationH;
+    op.beta = source.beta;
+    Tensor &input = tensors_[op.input], &output = tensors_[op.output];
+
+    // Max pooling keeps the values, hence the quantization, of its input
+    if (op.type == CnnModel::OpType::MaxPool2D)
+      output.quantization = input.quantization;
+
+    if (op.type == CnnModel::OpType::Conv2D || op.type == CnnModel::OpType::FullyConnected) {
+      const CnnModel::Tensor &filter = graph.tensors[source.inputs[1]];
+      const float *bias = source.inputs[2] >= 0 ? graph.tensors[source.inputs[2]].weights : nullptr;
+      const float *weights = op.type == CnnModel::OpType::Conv2D ? source.packedWeights.data() : filter.weights;
+      op.outChannels = filter.shape[0];
+      size_t channels = op.outChannels, taps = filter.size / channels;
+      op.filterH = op.type == CnnModel::OpType::Conv2D ? filter.shape[1] : 1;
+      op.filterW = op.type == CnnModel::OpType::Conv2D ? filter.shape[2] : 1;
+
+      // Per-channel symmetric weight scales; HWIO weights interleave the channels
+      bool interleaved = op.type == CnnModel::OpType::Conv2D;
+      vector<float> weightScale(channels);
+      for (size_t c = 0; c < channels; ++c) {
+        float largest = 0.0f;
+        for (size_t t = 0; t < taps; ++t)
+          largest = max(largest, fabs(weights[interleaved ? t * channels + c : c * taps + t]));
+        weightScale[c] = largest > 0.0f ? largest / 127.0f : 1.0f;
+      }
+      op.weights.resize(filter.size);
+      for (size_t i = 0; i < filter.size; ++i) {
+        size_t c = interleaved ? i % channels : i / taps;
+        op.weights[i] = saturate((int32_t)lround(weights[i] / weightScale[c]));
+      }
+
+      op.bias.resize(channels);
+      op.scale.resize(channels);
+      for (size_t c = 0; c < channels; ++c) {
+        double accumulatorScale = (double)input.quantization.scale * weightScale[c];
+        op.bias[c] = bias ? (int32_t)llround(bias[c] / accumulatorScale) : 0;
+        if (!interleaved) {
+          // sum((in - zp) * w) = sum(in * w) - zp * sum(w), so the dense kernel works on raw int8 inputs
+          int32_t weightSum = 0;
+          for (size_t t = 0; t < taps; ++t)
+            weightSum += op.weights[c * taps + t];
+          op.bias[c] -= input.quantization.zeroPoint * weightSum;
+        }
+        op.scale[c] = (float)(accumulatorScale / output.quantization.scale);
+      }
+      if (interleaved) {
+        op.wideWeights.assign(op.weights.begin(), op.weights.end());
+        accumulators_.resize(max(accumulators_.size(), output.size));
+      }
+    }
+
+    // Fused activation as a clamp in the output's quantized domain
+    const Quantization &q = output.quantization;
+    op.activationMin = -128;
+    op.activationMax = 127;
+    if (source.activation != CnnModel::Activation::None)
+      op.activationMin = max(op.activationMin, q.zeroPoint);
+    if (source.activation == CnnModel::Activation::Relu6)
+      op.activationMax = min(op.activationMax, q.zeroPoint + (int32_t)lround(6.0f / q.scale));
+    operations_.push_back(op);
+  }
+  outputTensor_ = alias[graph.outputTensor];
+  return true;
+}
+
+size_t QuantizedCnnModel::parameterBytes() const {
+  size_t bytes = 0;
+  for (const Operation &op : operations_)
+    bytes += op.weights.size() + op.bias.size() * sizeof(int32_t);
+  return bytes;
+}
+
+void QuantizedCnnModel::setBatchSize(size_t count) {
+  if (count == batchSize_)
+    return;
+  for (Tensor &tensor : tensors_)
+    tensor.data.resize(tensor.size * count);
+  output_.resize(outputSize_ * count);
+  batchSize_ = count;
+}
+
+void QuantizedCnnModel::runConv2D(const Operation &op) {
+  const Tensor &input = tensors_[op.input];
+  Tensor &output = tensors_[op.output];
+  int inH = input.shape[1], inW = input.shape[2], inC = input.shape[3], outC = op.outChannels;
+  int outH, outW, padH, padW;
+  CnnModel::windowGeometry(op.samePadding, inH, op.filterH, op.strideH, op.dilationH, outH, padH);
+  CnnModel::windowGeometry(op.samePadding, inW, op.filterW, op.strideW, op.dilationW, outW, padW);
+  int32_t inputZeroPoint = input.quantization.zeroPoint;
+
+  // Accumulate the whole layer of a batch entry first, then requantize it at once, so that neither
+  // the multiply-accumulate nor the requantization loop has per-pixel overhead
+  int32_t *accumulators = accumulators_.data();
+  for (size_t b = 0; b < batchSize_; ++b) {
+    for (int p = 0; p < outH * outW; ++p)
+      for (int j = 0; j < outC; ++j)
+        accumulators[(size_t)p * outC + j] = op.bias[j];
+    const int8_t *in = input.data.data() + b * input.size;
+    for (int oy = 0; oy < outH; ++oy)
+      for (int fy = 0; fy < op.filterH; ++fy) {
+        int iy = oy * op.strideH - padH + fy * op.dilationH;
+        if (iy < 0 || iy >= inH)
+          continue;
+        for (int ox = 0; ox < outW; ++ox) {
+          int32_t *sum = accumulators + ((size_t)oy * outW + ox) * outC;
+          for (int fx = 0; fx < op.filterW; ++fx) {
+            int ix = ox * op.strideW - padW + fx * op.dilationW;
+            if (ix < 0 || ix >= inW)
+              continue;
+            const int8_t *pixel = in + ((size_t)iy * inW + ix) * inC;
+            const int16_t *weights = op.wideWeights.data() + ((size_t)fy * op.filterW + fx) * inC * outC;
+            for (int ic = 0; ic < inC; ++ic, weights += outC) {
+              int16_t value = (int16_t)(pixel[ic] - inputZeroPoint);  // 16 x 16 -> 32-bit products
+              int j = 0;
+              for (; j + (int)kBlock <= outC; j += kBlock)
+                for (size_t k = 0; k < kBlock; ++k)
+                  sum[j + k] += value * weights[j + k];
+              for (; j < outC; ++j)
+                sum[j] += value * weights[j];
+            }
+          }
+        }
+      }
+    requantizeChannels(accumulators, output.size, op.scale.data(), outC, output.quantization.zeroPoint,
+                       op.activationMin, op.activationMax, output.data.data() + b * output.size);
+  }
+}
+
+void QuantizedCnnModel::runMaxPool2D(const Operation &op) {
+  const Tensor &input = tensors_[op.input];
+  Tensor &output = tensors_[op.output];
+  int inH = input.shape[1], inW = input.shape[2], channels = input.shape[3];
+  int outH, outW, padH, padW;
+  CnnModel::windowGeometry(op.samePadding, inH, op.filterH, op.strideH, 1, outH, padH);
+  CnnModel::windowGeometry(op.samePadding, inW, op.filterW, op.strideW, 1, outW, padW);
+
+  // Blocks of kBlock channels are reduced in a local array, as int8 pointers may alias anything
+  int8_t *out = output.data.data();
+  int8_t largest[kBlock];
+  for (size_t b = 0; b < batchSize_; ++b) {
+    const int8_t *in = input.data.data() + b * input.size;
+    for (int oy = 0; oy < outH; ++oy)
+      for (int ox = 0; ox < outW; ++ox, out += channels)
+        for (int block = 0; block < channels; block += kBlock) {
+          int count = min((int)kBlock, channels - block);
+          fill(largest, largest + kBlock, (int8_t)op.activationMin);
+          for (int fy = 0; fy < op.filterH; ++fy) {
+            int iy = oy * op.strideH - padH + fy;
+            if (iy < 0 || iy >= inH)
+              continue;
+            for (int fx = 0; fx < op.filterW; ++fx) {
+              int ix = ox * op.strideW - padW + fx;
+              if (ix < 0 || ix >= inW)
+                continue;
+              const int8_t *pixel = in + ((size_t)iy * inW + ix) * channels + block;
+              if (count == (int)kBlock) {
+                for (size_t c = 0; c < kBlock; ++c)
+                  largest[c] = max(largest[c], pixel[c]);
+              } else {
+                for (int c = 0; c < count; ++c)
+                  largest[c] = max(largest[c], pixel[c]);
+              }
+            }
+          }
+          for (int c = 0; c < count; ++c)
+            out[block + c] = min((int8_t)op.activationMax, largest[c]);
+        }
+  }
+}
+
+void QuantizedCnnModel::runFullyConnected(const Operation &op) {
+  const Tensor &input = tensors_[op.input];
+  Tensor &output = tensors_[op.output];
+  size_t units = op.outChannels, depth = input.size;
+  int32_t sums[kMaxUnits];
+  for (size_t b = 0; b < batchSize_; ++b) {
+    const int8_t *in = input.data.data() + b * depth;
+    int8_t *out = output.data.data() + b * units;
+    for (size_t first = 0; first < units; first += kMaxUnits) {
+      size_t count = min(kMaxUnits, units - first);
+      for (size_t u = 0; u < count; ++u) {
+        const int8_t *row = op.weights.data() + (first + u) * depth;
+        int32_t sum = op.bias[first + u];
+        for (size_t d = 0; d < depth; ++d)
+          sum += in[d] * row[d];
+        sums[u] = sum;
+      }
+      requantizeChannels(sums, count, op.scale.data() + first, count, output.quantization.zeroPoint,
+                         op.activationMin, op.activationMax, out + first);
+    }
+  }
+}
+
+// Function to run the model on `count` inputs, returning the float outputs
+const float *QuantizedCnnModel::run(const float *inputs, size_t count) {
+  setBatchSize(count);
+  Tensor &in = tensors_[inputTensor_];
+  float inverseScale = 1.0f / in.quantization.scale;
+  float low = (float)(-128 - in.quantization.zeroPoint), high = (float)(127 - in.quantization.zeroPoint);
+  for (size_t i = 0; i < in.data.size(); ++i)
+    in.data[i] = (int8_t)roundClamped(inputs[i] * inverseScale, low, high, in.quantization.zeroPoint);
+
+  bool softmaxOutput = false;
+  for (const Operation &op : operations_) {
+    switch (op.type) {
+      case CnnModel::OpType::Conv2D:
+        runConv2D(op);
+        break;
+      case CnnModel::OpType::MaxPool2D:
+        runMaxPool2D(op);
+        break;
+      case CnnModel::OpType::Reshape:  // Aliased in build()
+        break;
+      case CnnModel::OpType::FullyConnected:
+        runFullyConnected(op);
+        break;
+      case CnnModel::OpType::Softmax: {
+        // Float softmax of the dequantized logits
+        const Tensor &logits = tensors_[op.input];
+        size_t depth = logits.shape.back();
+        for (size_t offset = 0; offset < logits.data.size(); offset += depth) {
+          int8_t largest = *max_element(logits.data.begin() + offset, logits.data.begin() + offset + depth);
+          float sum = 0.0f;
+          for (size_t i = 0; i < depth; ++i)
+            sum += output_[offset + i] = expf((logits.data[offset + i] - largest) * logits.quantization.scale * op.beta);
+          for (size_t i = 0; i < depth; ++i)
+            output_[offset + i] /= sum;
+        }
+        softmaxOutput = op.output == outputTensor_;
+        break;
+      }
+    }
+  }
+
+  if (!softmaxOutput) {
+    const Tensor &out = tensors_[outputTensor_];
+    for (size_t i = 0; i < output_.size(); ++i)
+      output_[i] = (out.data[i] - out.quantization.zeroPoint) * out.quantization.scale;
+  }
+  return output_.data();
+}
+
+void QuantizedCnnModel::invoke(const float *input, float *output) {
+  const float *scores = run(input, 1);
+  copy(scores, scores + outputSize_, output);
+}
+
+int QuantizedCnnModel::classify(const float *input) {
+  const float *scores = run(input, 1);
+  return (int)(max_element(scores, scores + outputSize_) - scores);
+}
+
+void QuantizedCnnModel::invokeBatch(const float *inputs, size_t count, float *outputs) {
+  if (count == 0)
+    return;
+  const float *scores = run(inputs, count);
+  copy(scores, scores + count * outputSize_, outputs);
+}
+
+void QuantizedCnnModel::classifyBatch(const float *inputs, size_t count, int *labels) {
+  if (count == 0)
+    return;
+  const float *scores = run(inputs, count);
+  for (size_t i = 0; i < count; ++i) {
+    const float *row = scores + i * outputSize_;
+    labels[i] = (int)(max_element(row, row + outputSize_) - row);
+  }
+}
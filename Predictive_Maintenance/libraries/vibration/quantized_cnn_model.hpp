@@ -0,0 +1,84 @@
+// File: quantized_cnn_model.hpp
+// Description: int8 post-training quantization of a CnnModel, and integer kernels to run it, as on
+// the target microcontrollers. Follows the TFLite int8 scheme: per-channel symmetric int8 weights,
+// asymmetric int8 activations whose ranges are calibrated on sample inputs, int32 biases, and
+// per-channel requantization between layers. Softmax runs in float on the dequantized logits.
+// This simulates the accuracy of the model on the robots' microcontrollers; without int8 dot
+// product instructions it is no faster than CnnModel on a desktop CPU.
+
+#ifndef QUANTIZED_CNN_MODEL_HPP
+#define QUANTIZED_CNN_MODEL_HPP
+
+#include "cnn_model.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class QuantizedCnnModel {
+public:
+  // Quantize `model`, calibrating the activation ranges on `count` inputs of model.inputSize()
+  // values. Returns false, with a reason in error, if the model is not loaded or count is 0.
+  bool build(const CnnModel &model, const float *calibrationInputs, size_t count, std::string *error = nullptr);
+
+  bool isBuilt() const { return !operations_.empty(); }
+  size_t inputSize() const { return inputSize_; }
+  size_t outputSize() const { return outputSize_; }
+  // Bytes of int8 weights and int32 biases, the flash footprint of the parameters
+  size_t parameterBytes() const;
+
+  // Float input in, dequantized (or softmax) float output out, as CnnModel::invoke()
+  void invoke(const float *input, float *output);
+  int classify(const float *input);
+  // Run the integer kernels once on `count` inputs stored one after the other, as
+  // CnnModel::invokeBatch(); the activations grow to the largest batch seen
+  void invokeBatch(const float *inputs, size_t count, float *outputs);
+  void classifyBatch(const float *inputs, size_t count, int *labels);
+
+private:
+  struct Quantization {
+    float scale;
+    int32_t zeroPoint;
+  };
+
+  struct Tensor {
+    std::vector<int> shape;  // Of a single batch entry
+    size_t size = 0;         // Values of a single batch entry, 0 for constants and reshaped tensors
+    std::vector<int8_t> data;  // batchSize_ entries
+    Quantization quantization;
+  };
+
+  struct Operation {
+    CnnModel::OpType type;
+    int input, output;
+    bool samePadding;
+    int strideW, strideH;
+    int filterW, filterH, dilationW, dilationH;
+    int outChannels;
+    float beta;
+    std::vector<int8_t> weights;      // Conv2D in HWIO order, FullyConnected in [unit][depth] order
+    std::vector<int16_t> wideWeights;  // Conv2D weights widened once, as CMSIS-NN does, so the kernel vectorises
+    std::vector<int32_t> bias;        // Scaled by input scale * weight scale, with the input zero point folded in for FullyConnected
+    std::vector<float> scale;         // Per output channel requantization: input scale * weight scale / output scale
+    int32_t activationMin, activationMax;  // Fused activation, in the output's quantized domain
+  };
+
+  void setBatchSize(size_t count);
+  void runConv2D(const Operation &op);
+  void runMaxPool2D(const Operation &op);
+  void runFullyConnected(const Operation &op);
+  const float *run(const float *inputs, size_t count);
+
+  std::vector<Tensor> tensors_;
+  std::vector<Operation> operations_;  // Without the reshapes, whose outputs alias their inputs
+  int inputTensor_ = 0;
+  int outputTensor_ = 0;
+  size_t inputSize_ = 0;
+  size_t outputSize_ = 0;
+  size_t batchSize_ = 0;
+  std::vector<float> output_;
+  std::vector<int32_t> accumulators_;  // Conv2D accumulators of a whole layer, for one batch entry
+};
+
+#endif  // QUANTIZED_CNN_MODEL_HPP
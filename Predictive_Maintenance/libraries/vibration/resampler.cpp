@@ -0,0 +1,156 @@
+// File: resampler.cpp
+// Description: Filter bank design and block processing of the Resampler.
+
+#include "resampler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+const size_t kPhases = 256;           // Resolution of the fractional input position
+const double kSincZeroCrossings = 8;  // Half-width of the sinc kernel, in zero crossings
+const double kPi = 3.14159265358979323846;
+
+bool parseResampleMethod(const string &name, ResampleMethod &method) {
+  if (name == "none")
+    method = ResampleMethod::None;
+  else if (name == "linear")
+    method = ResampleMethod::Linear;
+  else if (name == "cubic")
+    method = ResampleMethod::Cubic;
+  else if (name == "sinc")
+    method = ResampleMethod::Sinc;
+  else
+    return false;
+  return true;
+}
+
+// Blackman window over [-1, 1]
+static double blackman(double u) {
+  if (fabs(u) >= 1.0)
+    return 0.0;
+  return 0.42 + 0.5 * cos(kPi * u) + 0.08 * cos(2.0 * kPi * u);
+}
+
+Resampler::Resampler(Source source, double inputRate, double outputRate, ResampleMethod method, size_t blockSize)
+  : source_(move(source)), method_(method), blockSize_(max<size_t>(blockSize, 1)) {
+  step_ = method == ResampleMethod::None || inputRate <= 0.0 || outputRate <= 0.0 ? 1.0 : inputRate / outputRate;
+
+  // Cut-off relative to the input Nyquist frequency: lowered to the output Nyquist frequency when downsampling
+  double cutoff = min(1.0, 1.0 / step_);
+  size_t halfWidth = 1;
+  if (method == ResampleMethod::Cubic)
+    halfWidth = 2;
+  else if (method == ResampleMethod::Sinc)
+    halfWidth = (size_t)ceil(kSincZeroCrossings / cutoff);
+  phases_ = method == ResampleMethod::None ? 1 : kPhases;
+  taps_ = 2 * halfWidth;
+
+  bank_.assign((phases_ + 1) * taps_, 0.0f);
+  for (size_t p = 0; p <= phases_; ++p) {
+    double fraction = (double)p / phases_;
+    float *row = &bank_[p * taps_];
+    if (method == ResampleMethod::None) {
+      row[halfWidth - 1] = 1.0f;
+      continue;
+    }
+    double sum = 0.0;
+    vector<double> weights(taps_);
+    for (size_t t = 0; t < taps_; ++t) {
+      // Distance of the tap's input reading from the output position
+      double d = (double)t - (double)(halfWidth - 1) - fraction;
+      double w = 0.0, a = fabs(d);
+      if (method == ResampleMethod::Linear) {
+        w = max(0.0, 1.0 - a);
+      } else if (method == ResampleMethod::Cubic) {
+        if (a < 1.0)
+          w = 1.5 * a * a * a - 2.5 * a * a + 1.0;
+        else if (a < 2.0)
+          w = -0.5 * a * a * a + 2.5 * a * a - 4.0 * a + 2.0;
+      } else {
+        double x = cutoff * d;
+        w = (x == 0.0 ? 1.0 : sin(kPi * x) / (kPi * x)) * blackman(d / halfWidth);
+      }
+      weights[t] = w;
+      sum += w;
+    }
+    // Unity gain at DC for every phase
+    for (size_t t = 0; t < taps_; ++t)
+      row[t] = (float)(sum != 0.0 ? weights[t] / sum : 0.0);
+  }
+
+  blockX_.resize(blockSize_);
+  blockY_.resize(blockSize_);
+  blockZ_.resize(blockSize_);
+}
+
+// Read input readings until `index` is buffered or the source ends
+bool Resampler::fetchUntil(long long index) {
+  while (inputEnd_ <= index && !sourceDone_) {
+    float x, y, z;
+    if (!source_(x, y, z)) {
+      sourceDone_ = true;
+      break;
+    }
+    inputX_.push_back(x);
+    inputY_.push_back(y);
+    inputZ_.push_back(z);
+    ++inputEnd_;
+  }
+  return inputEnd_ > index;
+}
+
+float Resampler::input(const vector<float> &axis, long long index) const {
+  index = min(max(index, inputBase_), inputEnd_ - 1);
+  return axis[(size_t)(index - inputBase_)];
+}
+
+// Function to compute the next block of output readings
+bool Resampler::refill() {
+  long long half = (long long)taps_ / 2;
+  blockCount_ = 0;
+  cursor_ = 0;
+  for (; blockCount_ < blockSize_; ++blockCount_, ++outputIndex_) {
+    double position = (double)outputIndex_ * step_;
+    long long index = (long long)position;
+    size_t phase = (size_t)llround((position - (double)index) * phases_);
+    // Output past the last input reading: the stream has ended
+    if (!fetchUntil(index + half) && (inputEnd_ == 0 || index >= inputEnd_ || (index == inputEnd_ - 1 && phase > 0)))
+      break;
+
+    const float *row = &bank_[phase * taps_];
+    long long first = index - half + 1;
+    float x = 0.0f, y = 0.0f, z = 0.0f;
+    if (first >= inputBase_ && first + (long long)taps_ <= inputEnd_) {
+      size_t offset = (size_t)(first - inputBase_);
+      const float *inX = &inputX_[offset], *inY = &inputY_[offset], *inZ = &inputZ_[offset];
+      for (size_t t = 0; t < taps_; ++t) {
+        x += row[t] * inX[t];
+        y += row[t] * inY[t];
+        z += row[t] * inZ[t];
+      }
+    } else {
+      // Near the ends of the stream, clamped to the first and last reading
+      for (size_t t = 0; t < taps_; ++t) {
+        x += row[t] * input(inputX_, first + (long long)t);
+        y += row[t] * input(inputY_, first + (long long)t);
+        z += row[t] * input(inputZ_, first + (long long)t);
+      }
+    }
+    blockX_[blockCount_] = x;
+    blockY_[blockCount_] = y;
+    blockZ_[blockCount_] = z;
+  }
+
+  // Drop the input readings no later output needs
+  long long keep = (long long)((double)outputIndex_ * step_) - half + 1;
+  if (keep - inputBase_ >= (long long)max<size_t>(4 * taps_, 1024)) {
+    size_t drop = (size_t)(min(keep, inputEnd_ - 1) - inputBase_);
+    inputX_.erase(inputX_.begin(), inputX_.begin() + drop);
+    inputY_.erase(inputY_.begin(), inputY_.begin() + drop);
+    inputZ_.erase(inputZ_.begin(), inputZ_.begin() + drop);
+    inputBase_ += (long long)drop;
+  }
+  return blockCount_ > 0;
+}
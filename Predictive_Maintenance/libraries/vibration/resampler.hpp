@@ -0,0 +1,109 @@
+// File: resampler.hpp
+// Description: Resampling of a capture stream from its sample rate to the reading rate of the
+// windows (the rate the CNN was trained on), and the number of those readings due at each
+// simulation step, so the vibration is replayed in physical time whatever the world's basicTimeStep.
+//
+// Output reading n is the capture interpolated at capture time n / outputRate. Every method is a
+// bank of precomputed FIR taps indexed by the fractional input position (polyphase); outputs are
+// produced a block at a time.
+
+#ifndef RESAMPLER_HPP
+#define RESAMPLER_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+enum class ResampleMethod {
+  None,    // One capture reading per output reading, whatever the rates
+  Linear,  // Linear interpolation between the two neighbouring readings
+  Cubic,   // Catmull-Rom interpolation over four readings
+  Sinc     // Windowed sinc, low-passed below the output Nyquist frequency when downsampling
+};
+
+// Parse "none", "linear", "cubic" or "sinc"; returns false for anything else
+bool parseResampleMethod(const std::string &name, ResampleMethod &method);
+
+class Resampler {
+public:
+  // Pulls the next input reading, returning false at the end of the stream
+  typedef std::function<bool(float &, float &, float &)> Source;
+
+  Resampler(Source source, double inputRate, double outputRate, ResampleMethod method = ResampleMethod::Sinc,
+            size_t blockSize = 64);
+
+  // Take the next output reading. Returns false once the output time passed the last input reading.
+  bool next(float &x, float &y, float &z) {
+    if (cursor_ == blockCount_ && !refill())
+      return false;
+    x = blockX_[cursor_];
+    y = blockY_[cursor_];
+    z = blockZ_[cursor_];
+    ++cursor_;
+    return true;
+  }
+
+  ResampleMethod method() const { return method_; }
+  size_t taps() const { return taps_; }
+  // Input readings consumed per output reading
+  double step() const { return step_; }
+
+private:
+  bool refill();
+  bool fetchUntil(long long index);
+  float input(const std::vector<float> &axis, long long index) const;
+
+  Source source_;
+  ResampleMethod method_;
+  double step_;
+
+  // Filter bank: phases_ + 1 rows of taps_ coefficients; row p applies at fractional position p / phases_,
+  // tap t to input index floor(position) - taps_ / 2 + 1 + t
+  size_t phases_;
+  size_t taps_;
+  std::vector<float> bank_;
+
+  // Input readings from index inputBase_ on; the stream is clamped at its first and last reading
+  std::vector<float> inputX_, inputY_, inputZ_;
+  long long inputBase_ = 0;
+  long long inputEnd_ = 0;
+  bool sourceDone_ = false;
+
+  // Current output block
+  size_t blockSize_;
+  std::vector<float> blockX_, blockY_, blockZ_;
+  size_t blockCount_ = 0;
+  size_t cursor_ = 0;
+  unsigned long long outputIndex_ = 0;
+};
+
+// Readings due at each step when the readings run at readingRate and the steps at stepRate: 3 or 4
+// readings of 60 Hz per 64 ms step. Counted from the total of the readings due at the end of each
+// step, so the fraction left over by a step carries to the next one without drifting.
+class ReadingClock {
+public:
+  ReadingClock(double readingRate, double stepRate)
+    : ratio_(readingRate > 0.0 && stepRate > 0.0 ? readingRate / stepRate : 1.0) {}
+
+  // Readings to play at the next step
+  size_t next() {
+    uint64_t due = (uint64_t)std::floor((double)++steps_ * ratio_ + 1e-9);
+    size_t count = (size_t)(due - played_);
+    played_ = due;
+    return count;
+  }
+
+  // Most readings a step can play
+  size_t maxPerStep() const { return (size_t)std::ceil(ratio_ - 1e-9); }
+  double ratio() const { return ratio_; }
+
+private:
+  double ratio_;
+  uint64_t steps_ = 0;
+  uint64_t played_ = 0;
+};
+
+#endif  // RESAMPLER_HPP
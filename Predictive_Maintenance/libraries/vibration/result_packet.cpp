@@ -0,0 +1,75 @@
+// File: result_packet.cpp
+// Description: Encoder and decoder for result packets, and the windows awaiting a result. Fields are
+// copied with memcpy, so packets can be read from any buffer alignment; all supported platforms are
+// little-endian.
+
+#include "result_packet.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+size_t encodeResultPacket(const ResultPacketHeader &header, const float *probabilities, void *buffer) {
+  unsigned char *out = (unsigned char *)buffer;
+  out[0] = 'R';
+  out[1] = 'P';
+  out[2] = kResultPacketVersion;
+  out[3] = header.classCount;
+  memcpy(out + 4, &header.robotId, 4);
+  memcpy(out + 8, &header.sequence, 4);
+  memcpy(out + 12, &header.label, 4);
+  memcpy(out + 16, &header.inferenceTime, 4);
+  memcpy(out + kResultPacketHeaderSize, probabilities, header.classCount * sizeof(float));
+  return resultPacketSize(header.classCount);
+}
+
+bool decodeResultPacket(const void *data, size_t size, ResultPacketHeader &header, float *probabilities, size_t capacity) {
+  const unsigned char *in = (const unsigned char *)data;
+  if (size < kResultPacketHeaderSize || in[0] != 'R' || in[1] != 'P' || in[2] != kResultPacketVersion)
+    return false;
+
+  header.classCount = in[3];
+  memcpy(&header.robotId, in + 4, 4);
+  memcpy(&header.sequence, in + 8, 4);
+  memcpy(&header.label, in + 12, 4);
+  memcpy(&header.inferenceTime, in + 16, 4);
+  if (header.classCount > capacity || size < resultPacketSize(header.classCount) || header.label < 0 ||
+      (header.classCount > 0 && header.label >= header.classCount))
+    return false;
+
+  memcpy(probabilities, in + kResultPacketHeaderSize, header.classCount * sizeof(float));
+  return true;
+}
+
+// PendingWindows
+
+PendingWindows::PendingWindows(size_t robots, size_t depth) :
+  robots_(robots),
+  depth_(max<size_t>(depth, 1)),
+  entries_(robots_ * depth_, Entry{0, false, 0.0, Clock::time_point()}) {
+}
+
+void PendingWindows::sent(uint32_t robot, uint32_t sequence, double simulationTime, Clock::time_point wallTime) {
+  if (robot >= robots_)
+    return;
+  Entry &entry = entries_[robot * depth_ + sequence % depth_];
+  if (entry.pending)
+    ++dropped_;
+  else
+    ++inFlight_;
+  entry = {sequence, true, simulationTime, wallTime};
+}
+
+bool PendingWindows::take(uint32_t robot, uint32_t sequence, double &simulationTime, Clock::time_point &wallTime) {
+  if (robot >= robots_)
+    return false;
+  Entry &entry = entries_[robot * depth_ + sequence % depth_];
+  if (!entry.pending || entry.sequence != sequence)
+    return false;
+  entry.pending = false;
+  --inFlight_;
+  simulationTime = entry.simulationTime;
+  wallTime = entry.wallTime;
+  return true;
+}
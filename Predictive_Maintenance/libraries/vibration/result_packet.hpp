@@ -0,0 +1,77 @@
+// File: result_packet.hpp
+// Description: Binary packet carrying the classification of one window from a robot back to the
+// supervisor, and the bookkeeping of the windows awaiting one, to measure end-to-end latency.
+//
+// Layout (little-endian, 20-byte header followed by the class probabilities):
+//   offset  0  char[2]  magic "RP"
+//   offset  2  uint8    version (kResultPacketVersion)
+//   offset  3  uint8    class count
+//   offset  4  uint32   id of the robot
+//   offset  8  uint32   sequence number of the classified window
+//   offset 12  int32    label, the most likely class
+//   offset 16  float32  inference time on the robot, in microseconds
+//   offset 20  float32  probability of each class
+
+#ifndef RESULT_PACKET_HPP
+#define RESULT_PACKET_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+const uint8_t kResultPacketVersion = 1;
+const size_t kResultPacketHeaderSize = 20;
+const size_t kMaxResultClasses = 255;
+
+struct ResultPacketHeader {
+  uint32_t robotId;
+  uint32_t sequence;
+  int32_t label;
+  float inferenceTime;  // Microseconds
+  uint8_t classCount;
+};
+
+inline size_t resultPacketSize(size_t classCount) {
+  return kResultPacketHeaderSize + classCount * sizeof(float);
+}
+
+// Encode a result with header.classCount probabilities into buffer, which must hold
+// resultPacketSize(header.classCount) bytes. Returns the packet size.
+size_t encodeResultPacket(const ResultPacketHeader &header, const float *probabilities, void *buffer);
+
+// Decode a packet, copying up to capacity probabilities. Returns false if the packet is malformed,
+// of another version, or has more classes than capacity.
+bool decodeResultPacket(const void *data, size_t size, ResultPacketHeader &header, float *probabilities, size_t capacity);
+
+// Send times of the windows awaiting a result, in a ring of `depth` windows per robot indexed by
+// sequence number. A window still unanswered `depth` windows later is dropped as lost.
+class PendingWindows {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  explicit PendingWindows(size_t robots, size_t depth = 64);
+
+  void sent(uint32_t robot, uint32_t sequence, double simulationTime, Clock::time_point wallTime);
+  // Take the send times of a window; false if it was not sent, already answered or dropped
+  bool take(uint32_t robot, uint32_t sequence, double &simulationTime, Clock::time_point &wallTime);
+
+  size_t inFlight() const { return inFlight_; }
+  size_t dropped() const { return dropped_; }
+
+private:
+  struct Entry {
+    uint32_t sequence;
+    bool pending;
+    double simulationTime;
+    Clock::time_point wallTime;
+  };
+
+  size_t robots_;
+  size_t depth_;
+  std::vector<Entry> entries_;  // depth_ entries per robot
+  size_t inFlight_ = 0;
+  size_t dropped_ = 0;
+};
+
+#endif  // RESULT_PACKET_HPP
@@ -0,0 +1,182 @@
+// File: sample_kernels.cpp
+// Description: Scalar, SSE and AVX2 implementations of the sample kernels and their runtime dispatch.
+// The SIMD versions are compiled with function-level target attributes, so the library itself does
+// not require the instruction sets it can use.
+
+#include "sample_kernels.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SAMPLE_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+// Scalar
+
+static void accumulateScaledScalar(float *dst, const float *gains, float value, size_t count) {
+  for (size_t k = 0; k < count; ++k)
+    dst[k] += gains[k] * value;
+}
+
+static void scaleAndCalibrateScalar(const float *in, const float *readingGain, size_t readings,
+                                    const AxisCalibration &calibration, float *out) {
+  for (size_t r = 0; r < readings; ++r) {
+    float scale = readingGain ? readingGain[r] : 1.0f;
+    for (int axis = 0; axis < 3; ++axis)
+      out[3 * r + axis] = in[3 * r + axis] * scale * calibration.gain[axis] + calibration.offset[axis];
+  }
+}
+
+#ifdef SAMPLE_KERNELS_X86
+
+// SSE: 4 readings (12 floats, 3 vectors) per iteration
+
+__attribute__((target("sse2"))) static void accumulateScaledSse(float *dst, const float *gains, float value, size_t count) {
+  __m128 v = _mm_set1_ps(value);
+  size_t k = 0;
+  for (; k + 4 <= count; k += 4)
+    _mm_storeu_ps(dst + k, _mm_add_ps(_mm_loadu_ps(dst + k), _mm_mul_ps(_mm_loadu_ps(gains + k), v)));
+  accumulateScaledScalar(dst + k, gains + k, value, count - k);
+}
+
+__attribute__((target("sse2"))) static void scaleAndCalibrateSse(const float *in, const float *readingGain, size_t readings,
+                                                                 const AxisCalibration &calibration, float *out) {
+  const float *g = calibration.gain, *o = calibration.offset;
+  // Axis patterns of the three vectors covering 4 interleaved readings
+  __m128 gain0 = _mm_setr_ps(g[0], g[1], g[2], g[0]), gain1 = _mm_setr_ps(g[1], g[2], g[0], g[1]), gain2 = _mm_setr_ps(g[2], g[0], g[1], g[2]);
+  __m128 offset0 = _mm_setr_ps(o[0], o[1], o[2], o[0]), offset1 = _mm_setr_ps(o[1], o[2], o[0], o[1]), offset2 = _mm_setr_ps(o[2], o[0], o[1], o[2]);
+
+  size_t r = 0;
+  for (; r + 4 <= readings; r += 4) {
+    const float *src = in + 3 * r;
+    float *dst = out + 3 * r;
+    __m128 a = _mm_loadu_ps(src), b = _mm_loadu_ps(src + 4), c = _mm_loadu_ps(src + 8);
+    if (readingGain) {
+      __m128 s = _mm_loadu_ps(readingGain + r);  // s0 s1 s2 s3
+      a = _mm_mul_ps(a, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 0, 0, 0)));
+      b = _mm_mul_ps(b, _mm_shuffle_ps(s, s, _MM_SHUFFLE(2, 2, 1, 1)));
+      c = _mm_mul_ps(c, _mm_shuffle_ps(s, s, _MM_SHUFFLE(3, 3, 3, 2)));
+    }
+    _mm_storeu_ps(dst, _mm_add_ps(_mm_mul_ps(a, gain0), offset0));
+    _mm_storeu_ps(dst + 4, _mm_add_ps(_mm_mul_ps(b, gain1), offset1));
+    _mm_storeu_ps(dst + 8, _mm_add_ps(_mm_mul_ps(c, gain2), offset2));
+  }
+  scaleAndCalibrateScalar(in + 3 * r, readingGain ? readingGain + r : nullptr, readings - r, calibration, out + 3 * r);
+}
+
+// AVX2: 8 readings (24 floats, 3 vectors) per iteration
+
+__attribute__((target("avx2,fma"))) static void accumulateScaledAvx2(float *dst, const float *gains, float value, size_t count) {
+  __m256 v = _mm256_set1_ps(value);
+  size_t k = 0;
+  for (; k + 8 <= count; k += 8)
+    _mm256_storeu_ps(dst + k, _mm256_fmadd_ps(_mm256_loadu_ps(gains + k), v, _mm256_loadu_ps(dst + k)));
+  accumulateScaledScalar(dst + k, gains + k, value, count - k);
+}
+
+__attribute__((target("avx2,fma"))) static void scaleAndCalibrateAvx2(const float *in, const float *readingGain, size_t readings,
+                                                                      const AxisCalibration &calibration, float *out) {
+  const float *g = calibration.gain, *o = calibration.offset;
+  __m256 gain0 = _mm256_setr_ps(g[0], g[1], g[2], g[0], g[1], g[2], g[0], g[1]);
+  __m256 gain1 = _mm256_setr_ps(g[2], g[0], g[1], g[2], g[0], g[1], g[2], g[0]);
+  __m256 gain2 = _mm256_setr_ps(g[1], g[2], g[0], g[1], g[2], g[0], g[1], g[2]);
+  __m256 offset0 = _mm256_setr_ps(o[0], o[1], o[2], o[0], o[1], o[2], o[0], o[1]);
+  __m256 offset1 = _mm256_setr_ps(o[2], o[0], o[1], o[2], o[0], o[1], o[2], o[0]);
+  __m256 offset2 = _mm256_setr_ps(o[1], o[2], o[0], o[1], o[2], o[0], o[1], o[2]);
+  // Reading of each lane of the three vectors covering 8 interleaved readings
+  __m256i spread0 = _mm256_setr_epi32(0, 0, 0, 1, 1, 1, 2, 2);
+  __m256i spread1 = _mm256_setr_epi32(2, 3, 3, 3, 4, 4, 4, 5);
+  __m256i spread2 = _mm256_setr_epi32(5, 5, 6, 6, 6, 7, 7, 7);
+
+  size_t r = 0;
+  for (; r + 8 <= readings; r += 8) {
+    const float *src = in + 3 * r;
+    float *dst = out + 3 * r;
+    __m256 a = _mm256_loadu_ps(src), b = _mm256_loadu_ps(src + 8), c = _mm256_loadu_ps(src + 16);
+    if (readingGain) {
+      __m256 s = _mm256_loadu_ps(readingGain + r);
+      a = _mm256_mul_ps(a, _mm256_permutevar8x32_ps(s, spread0));
+      b = _mm256_mul_ps(b, _mm256_permutevar8x32_ps(s, spread1));
+      c = _mm256_mul_ps(c, _mm256_permutevar8x32_ps(s, spread2));
+    }
+    _mm256_storeu_ps(dst, _mm256_fmadd_ps(a, gain0, offset0));
+    _mm256_storeu_ps(dst + 8, _mm256_fmadd_ps(b, gain1, offset1));
+    _mm256_storeu_ps(dst + 16, _mm256_fmadd_ps(c, gain2, offset2));
+  }
+  // Clear the upper halves before the legacy SSE tail, which would otherwise pay the AVX-SSE transition
+  _mm256_zeroupper();
+  scaleAndCalibrateSse(in + 3 * r, readingGain ? readingGain + r : nullptr, readings - r, calibration, out + 3 * r);
+}
+
+#endif  // SAMPLE_KERNELS_X86
+
+// Dispatch
+
+struct KernelTable {
+  SimdLevel level;
+  void (*accumulateScaled)(float *, const float *, float, size_t);
+  void (*scaleAndCalibrate)(const float *, const float *, size_t, const AxisCalibration &, float *);
+};
+
+static KernelTable kernelTable(SimdLevel level) {
+#ifdef SAMPLE_KERNELS_X86
+  if (level == SimdLevel::Avx2)
+    return {SimdLevel::Avx2, accumulateScaledAvx2, scaleAndCalibrateAvx2};
+  if (level == SimdLevel::Sse)
+    return {SimdLevel::Sse, accumulateScaledSse, scaleAndCalibrateSse};
+#else
+  (void)level;
+#endif
+  return {SimdLevel::Scalar, accumulateScaledScalar, scaleAndCalibrateScalar};
+}
+
+SimdLevel detectSimdLevel() {
+#ifdef SAMPLE_KERNELS_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return SimdLevel::Avx2;
+  if (__builtin_cpu_supports("sse2"))
+    return SimdLevel::Sse;
+#endif
+  return SimdLevel::Scalar;
+}
+
+static KernelTable &kernels() {
+  static KernelTable table = kernelTable(detectSimdLevel());
+  return table;
+}
+
+SimdLevel simdLevel() {
+  return kernels().level;
+}
+
+void setSimdLevel(SimdLevel level) {
+  SimdLevel detected = detectSimdLevel();
+  kernels() = kernelTable((int)level < (int)detected ? level : detected);
+}
+
+const char *simdLevelName(SimdLevel level) {
+  switch (level) {
+    case SimdLevel::Avx2:
+      return "avx2";
+    case SimdLevel::Sse:
+      return "sse";
+    default:
+      return "scalar";
+  }
+}
+
+void accumulateScaled(float *dst, const float *gains, float value, size_t count) {
+  kernels().accumulateScaled(dst, gains, value, count);
+}
+
+void scaleAndCalibrate(const float *in, const float *readingGain, size_t readings, const AxisCalibration &calibration,
+                       float *out) {
+  kernels().scaleAndCalibrate(in, readingGain, readings, calibration, out);
+}
+
+void scaleAndCalibrateBatch(const float *const *in, const float *const *readingGains, size_t windows, size_t readings,
+                            const AxisCalibration &calibration, float *const *out) {
+  auto kernel = kernels().scaleAndCalibrate;
+  for (size_t w = 0; w < windows; ++w)
+    kernel(in[w], readingGains ? readingGains[w] : nullptr, readings, calibration, out[w]);
+}
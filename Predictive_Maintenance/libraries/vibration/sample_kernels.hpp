@@ -0,0 +1,40 @@
+// File: sample_kernels.hpp
+// Description: Innermost per-sample loops of the supervisor: accumulating attenuated source readings
+// over the fleet, and applying attenuation and per-axis calibration to windows while packing them.
+// AVX2 and SSE versions are selected at runtime, with a portable scalar fallback.
+
+#ifndef SAMPLE_KERNELS_HPP
+#define SAMPLE_KERNELS_HPP
+
+#include <cstddef>
+
+enum class SimdLevel { Scalar, Sse, Avx2 };
+
+// Per-axis calibration applied to every reading: value * gain + offset
+struct AxisCalibration {
+  float gain[3] = {1.0f, 1.0f, 1.0f};
+  float offset[3] = {0.0f, 0.0f, 0.0f};
+};
+
+// Best level supported by this CPU
+SimdLevel detectSimdLevel();
+
+// Level used by the kernels, the detected one unless lowered (e.g. to compare levels in a benchmark)
+SimdLevel simdLevel();
+void setSimdLevel(SimdLevel level);  // Clamped to detectSimdLevel()
+const char *simdLevelName(SimdLevel level);
+
+// dst[k] += gains[k] * value for k < count
+void accumulateScaled(float *dst, const float *gains, float value, size_t count);
+
+// Scale and calibrate `readings` interleaved x, y, z readings into out (which may alias in):
+//   out = in * readingGain[r] * calibration.gain[axis] + calibration.offset[axis]
+// readingGain holds one attenuation per reading, or is null for none.
+void scaleAndCalibrate(const float *in, const float *readingGain, size_t readings, const AxisCalibration &calibration,
+                       float *out);
+
+// The same over a batch of windows of `readings` readings each
+void scaleAndCalibrateBatch(const float *const *in, const float *const *readingGains, size_t windows, size_t readings,
+                            const AxisCalibration &calibration, float *const *out);
+
+#endif  // SAMPLE_KERNELS_HPP
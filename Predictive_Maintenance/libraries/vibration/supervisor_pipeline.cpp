@@ -0,0 +1,348 @@
+// File: supervisor_pipeline.cpp
+// Description: Step of the supervisor pipeline, from the capture readings to the labels.
+
+#include "supervisor_pipeline.hpp"
+#include "capture.hpp"
+#include "capture_file.hpp"
+#include "window_packet.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+using namespace std;
+
+static const float kUnknown = numeric_limits<float>::quiet_NaN();
+
+SupervisorPipeline::SupervisorPipeline(const PipelineSettings &settings, const vector<RobotConfig> &robots,
+                                       const vector<VibrationSource> &sources) :
+  settings_(settings),
+  sources_(sources),
+  fleet_(robots, sources.size(), settings.windowLength, settings.windowHop),
+  readingClock_(settings.readingRate, settings.stepRate),
+  stepReadings_(readingClock_.maxPerStep() * sources.size() * 3),
+  histories_(sources.size(), SampleHistory(fleet_.maxDelay() + 1)),
+  sourceFinished_(sources.size(), false),
+  features_(settings.windowLength, settings.featureBands),
+  maxStepWindows_(fleet_.size() * ((readingClock_.maxPerStep() + settings.windowHop - 1) / settings.windowHop)),
+  sampleCount_(settings.sendSamples ? settings.windowLength * 3 : 0),
+  featureCount_(settings.sendFeatures ? features_.featureCount() : 0),
+  packetSize_(windowPacketSize(sampleCount_, featureCount_)),
+  packets_(packetSize_ * maxStepWindows_),
+  calibratedWindows_(settings.sendSamples ? 0 : maxStepWindows_ * settings.windowLength * 3),
+  packetWindows_(maxStepWindows_),
+  packetSamples_(maxStepWindows_),
+  pendingWindows_(fleet_.size()),
+  probabilities_(kMaxResultClasses),
+  playbackTime_(metrics_.histogram("phase.playback", "ns")),
+  positionsTime_(metrics_.histogram("phase.positions", "ns")),
+  attenuationTime_(metrics_.histogram("phase.attenuation", "ns")),
+  windowsTime_(metrics_.histogram("phase.windows", "ns")),
+  inferenceTime_(metrics_.histogram("phase.inference", "ns")),
+  emitTime_(metrics_.histogram("phase.emit", "ns")),
+  receiveTime_(metrics_.histogram("phase.receive", "ns")),
+  windowLatency_(metrics_.histogram("window.latency", "ns")),
+  simulatedLatency_(metrics_.histogram("window.latency_simulated", "ms")),
+  inFlight_(metrics_.histogram("windows.in_flight", "")),
+  attenuationLookups_(metrics_.counter("attenuation.lookups")),
+  windowsCompletedCount_(metrics_.counter("windows.completed")),
+  windowsSent_(metrics_.counter("windows.sent")),
+  labelsCount_(metrics_.counter("labels")) {
+  // Attenuation of every source over the arena floor, precomputed once (or loaded from its cache)
+  // and shared by all robots. With a vibration map, it is only looked up for the telemetry.
+  double half = settings_.arenaSize / 2;
+  attenuationFields_ = buildSourceFields(sources_, -half, -half, settings_.arenaSize, settings_.arenaSize,
+                                         settings_.fieldResolution, settings_.fieldCache);
+  if (settings_.vibrationMap)
+    return;
+
+  // Stream the captures of every source through a bounded ring buffer filled by a background thread,
+  // skipping the readings of its phase offset, and resample them to the reading rate of the windows
+  for (const VibrationSource &source : sources_) {
+    playbacks_.emplace_back(new CapturePlayback());
+    playbacks_.back()->start(source.playlist, settings_.playbackEnd);
+    float skipped[3];
+    for (size_t p = 0; p < source.phase && playbacks_.back()->next(skipped[0], skipped[1], skipped[2]); ++p) {
+    }
+    CapturePlayback *playback = playbacks_.back().get();
+    double captureRate = source.playlist.empty() ? settings_.captureRate
+                                                 : captureSampleRate(source.playlist[0], settings_.captureRate);
+    resamplers_.emplace_back([playback](float &x, float &y, float &z) { return playback->next(x, y, z); }, captureRate,
+                             settings_.readingRate, settings_.resampleMethod);
+  }
+}
+
+bool SupervisorPipeline::loadModel(const void *data, size_t size, string *error) {
+  batchInference_ = false;
+  if (!model_.load((const unsigned char *)data, size, error))
+    return false;
+  if (model_.inputSize() != settings_.windowLength * 3) {
+    if (error)
+      *error = "the CNN expects windows of " + to_string(model_.inputSize() / 3) + " readings";
+    return false;
+  }
+  calibratedWindows_.resize(maxStepWindows_ * settings_.windowLength * 3);
+  batchLabels_.resize(maxStepWindows_);
+  batchInference_ = true;
+  return true;
+}
+
+// Attenuations the calibration windows cycle through, from a robot on a source to one far from it, so
+// the activation ranges also cover the quiet windows most of the fleet sends
+static const float kCalibrationGains[] = {1.0f, 0.5f, 0.2f, 0.1f, 0.05f};
+
+bool loadCalibrationWindows(const string &filename, const PipelineSettings &settings, size_t windows,
+                            vector<float> &inputs, string *error) {
+  inputs.clear();
+  CaptureReader reader;
+  if (!reader.open(filename, error))
+    return false;
+
+  // Resample the capture to the reading rate as the playback does, reading it a chunk at a time and
+  // only as far as the windows need
+  const size_t kChunkRows = 1024;
+  vector<float> x(kChunkRows), y(kChunkRows), z(kChunkRows);
+  size_t rows = 0, cursor = 0;
+  Resampler resampler(
+    [&](float &rx, float &ry, float &rz) {
+      if (cursor == rows) {
+        rows = reader.read(x.data(), y.data(), z.data(), kChunkRows);
+        cursor = 0;
+        if (rows == 0)
+          return false;
+      }
+      rx = x[cursor];
+      ry = y[cursor];
+      rz = z[cursor];
+      ++cursor;
+      return true;
+    },
+    reader.sampleRate() > 0.0f ? reader.sampleRate() : settings.captureRate, settings.readingRate,
+    settings.resampleMethod);
+  size_t windowLength = settings.windowLength;
+  inputs.resize(windows * windowLength * 3);
+  size_t readings = 0;
+  while (readings < windows * windowLength &&
+         resampler.next(inputs[3 * readings], inputs[3 * readings + 1], inputs[3 * readings + 2]))
+    ++readings;
+  size_t calibrationWindows = windowLength > 0 ? readings / windowLength : 0;
+  if (!reader.error().empty()) {
+    if (error)
+      *error = filename + ": " + reader.error();
+    return false;
+  }
+  if (calibrationWindows == 0) {
+    if (error)
+      *error = "no window to calibrate on in " + filename;
+    return false;
+  }
+
+  inputs.resize(calibrationWindows * windowLength * 3);
+  const size_t gainCount = sizeof(kCalibrationGains) / sizeof(kCalibrationGains[0]);
+  vector<float> gains(windowLength);
+  for (size_t w = 0; w < calibrationWindows; ++w) {
+    fill(gains.begin(), gains.end(), kCalibrationGains[w % gainCount]);
+    float *window = &inputs[w * windowLength * 3];
+    scaleAndCalibrate(window, gains.data(), windowLength, settings.calibration, window);
+  }
+  return true;
+}
+
+bool SupervisorPipeline::quantizeModel(size_t windows, string *error) {
+  if (!batchInference_) {
+    if (error)
+      *error = "no CNN model is loaded";
+    return false;
+  }
+
+  vector<float> calibrationInputs;
+  if (!loadCalibrationWindows(sources_[0].playlist[0], settings_, windows, calibrationInputs, error))
+    return false;
+  return quantizedModel_.build(model_, calibrationInputs.data(), calibrationInputs.size() / model_.inputSize(), error);
+}
+
+void SupervisorPipeline::setTelemetry(TelemetrySink *telemetry, bool stepRecords) {
+  telemetry_ = telemetry;
+  stepTelemetry_ = telemetry != nullptr && stepRecords;
+}
+
+vector<CapturePlaybackError> SupervisorPipeline::takePlaybackErrors() {
+  vector<CapturePlaybackError> errors;
+  for (const unique_ptr<CapturePlayback> &playback : playbacks_) {
+    vector<CapturePlaybackError> sourceErrors = playback->takeErrors();
+    errors.insert(errors.end(), sourceErrors.begin(), sourceErrors.end());
+  }
+  return errors;
+}
+
+void SupervisorPipeline::step(double time, RobotPoses &poses, WindowEmitter &emitter, ResultReceiver &receiver) {
+  PhaseClock phaseClock;
+  phaseClock.start();
+  stepWindows_ = 0;
+
+  // Readings of every vibration source due at this step, at the reading rate of the windows; a source
+  // that ran out of data is silent, and the data runs out when every source has
+  const VibrationField *map = settings_.vibrationMap.get();
+  size_t sourceCount = sources_.size();
+  size_t readingCount = outOfData_ ? 0 : readingClock_.next();
+  bool exhausted = false;
+  if (map && !map->loops() && mapStep_ + readingCount > map->steps()) {
+    readingCount = (size_t)(map->steps() - min(mapStep_, map->steps()));
+    exhausted = true;
+  }
+  for (size_t r = 0; r < readingCount && !map; ++r) {
+    size_t playingSources = 0;
+    for (size_t s = 0; s < sourceCount; ++s) {
+      float *reading = &stepReadings_[(r * sourceCount + s) * 3];
+      reading[0] = reading[1] = reading[2] = 0.0f;
+      if (!sourceFinished_[s] && resamplers_[s].next(reading[0], reading[1], reading[2]))
+        ++playingSources;
+      else
+        sourceFinished_[s] = true;
+    }
+    if (playingSources == 0) {
+      readingCount = r;
+      exhausted = true;
+    }
+  }
+  phaseClock.lap(playbackTime_);
+
+  if (!outOfData_) {
+    // Get robot positions
+    poses.read(time, fleet_.x, fleet_.y);
+    phaseClock.lap(positionsTime_);
+
+    // Attenuation from every vibration source at the closest rounded point, or interpolated, for the
+    // robots that changed cell or moved. The vibration map applies it itself, so the gains are only
+    // looked up for the telemetry.
+    if (!map || stepTelemetry_)
+      attenuationLookups_.add(fleet_.updateAttenuation(attenuationFields_, settings_.interpolate,
+                                                       settings_.attenuationTolerance));
+    phaseClock.lap(attenuationTime_);
+    for (size_t k = 0; k < fleet_.size() && stepTelemetry_; ++k) {
+      telemetry_->position(time, (uint32_t)k, fleet_.x[k], fleet_.y[k]);
+      for (size_t s = 0; s < fleet_.sourceCount(); ++s)
+        telemetry_->attenuation(time, (uint32_t)k, (uint32_t)s, fleet_.gain[s * fleet_.size() + k]);
+    }
+
+    // Append the superposition of the attenuated source readings of the step to every robot's window,
+    // encoding the header of every window completed on the way; its samples are overwritten by the
+    // next reading, so they are calibrated and packed after each reading, in one pass
+    size_t windowLength = settings_.windowLength;
+    stepReady_.clear();
+    stepSequence_.clear();
+    for (size_t r = 0; r < readingCount; ++r) {
+      if (map) {
+        fleet_.pushReadings(*map, mapStep_++, settings_.interpolate);
+      } else {
+        for (size_t s = 0; s < sourceCount; ++s) {
+          const float *reading = &stepReadings_[(r * sourceCount + s) * 3];
+          histories_[s].push(reading[0], reading[1], reading[2]);
+        }
+        fleet_.pushReadings(histories_);
+      }
+      size_t first = stepReady_.size();
+      for (uint32_t k : fleet_.ready) {
+        size_t i = stepReady_.size();
+        const WindowAssembler &windows = fleet_.windows[k];
+        stepReady_.push_back(k);
+        stepSequence_.push_back((uint32_t)windows.windowCount() - 1);
+        WindowPacketHeader header = {k, stepSequence_[i], time, (uint16_t)windowLength, (uint16_t)sampleCount_,
+                                     (uint16_t)featureCount_, (uint16_t)features_.bandCount()};
+        packetWindows_[i] = windows.window();
+        packetSamples_[i] = encodeWindowPacketHeader(header, &packets_[i * packetSize_]);
+        if (!settings_.sendSamples || batchInference_)
+          packetSamples_[i] = &calibratedWindows_[i * windowLength * 3];
+      }
+      scaleAndCalibrateBatch(&packetWindows_[first], nullptr, stepReady_.size() - first, windowLength,
+                             settings_.calibration, &packetSamples_[first]);
+    }
+    PhaseClock::Clock::time_point windowsCompletedAt = PhaseClock::Clock::now();
+    size_t readyCount = stepReady_.size();
+    readings_ += fleet_.size() * readingCount;
+    windowsCompleted_ += readyCount;
+    stepWindows_ = readyCount;
+    windowsCompletedCount_.add(readyCount);
+
+    // Central inference: one run of the CNN over every window of the step, labels written back per robot
+    if (batchInference_) {
+      phaseClock.lap(windowsTime_);
+      if (quantizedModel_.isBuilt())
+        quantizedModel_.classifyBatch(calibratedWindows_.data(), readyCount, batchLabels_.data());
+      else
+        model_.classifyBatch(calibratedWindows_.data(), readyCount, batchLabels_.data());
+      phaseClock.lap(inferenceTime_);
+      uint64_t latency = chrono::duration_cast<chrono::nanoseconds>(PhaseClock::Clock::now() - windowsCompletedAt).count();
+      for (size_t i = 0; i < readyCount; ++i) {
+        uint32_t k = stepReady_[i];
+        fleet_.label[k] = batchLabels_[i];
+        windowLatency_.record(latency);
+        if (telemetry_)
+          telemetry_->label(time, k, stepSequence_[i], batchLabels_[i], kUnknown, kUnknown, latency / 1e6f, 0.0f);
+      }
+      labels_ += readyCount;
+      labelsCount_.add(readyCount);
+      readyCount = 0;  // Nothing to send
+    }
+
+    // Features of the calibrated windows, after the samples
+    for (size_t i = 0; i < readyCount && settings_.sendFeatures; ++i)
+      features_.compute(packetSamples_[i], (float *)&packets_[i * packetSize_ + windowPacketSize(sampleCount_)]);
+    if (!batchInference_)
+      phaseClock.lap(windowsTime_);
+
+    // Dispatch them, each on its robot's channel
+    for (size_t i = 0; i < readyCount; ++i) {
+      uint32_t k = stepReady_[i];
+      emitter.send(fleet_.channel[k], &packets_[i * packetSize_], packetSize_);
+      pendingWindows_.sent(k, stepSequence_[i], time, windowsCompletedAt);
+    }
+    windowsSent_.add(readyCount);
+    phaseClock.lap(emitTime_);
+  }
+  if (exhausted) {
+    // Reported once; the simulation keeps running without vibration data
+    if (telemetry_)
+      telemetry_->event(time, TelemetryEvent::OutOfData);
+    outOfData_ = true;
+  }
+
+  receiveResults(time, receiver);
+  phaseClock.lap(receiveTime_);
+  inFlight_.record(pendingWindows_.inFlight());
+}
+
+void SupervisorPipeline::receiveResults(double time, ResultReceiver &receiver) {
+  // Receiving the results of the robots, all of those queued since the last step
+  while (receiver.queueLength() > 0) {
+    ResultPacketHeader result;
+    if (!decodeResultPacket(receiver.data(), receiver.dataSize(), result, probabilities_.data(), probabilities_.size())) {
+      if (telemetry_)
+        telemetry_->event(time, TelemetryEvent::MalformedResult);
+    } else {
+      if (result.robotId < fleet_.size())
+        fleet_.label[result.robotId] = result.label;
+
+      // Log the classification label, with the end-to-end latency of the window
+      float latencyMs = kUnknown, simulatedLatencyS = kUnknown;
+      double sentTime;
+      PendingWindows::Clock::time_point sentWallTime;
+      if (pendingWindows_.take(result.robotId, result.sequence, sentTime, sentWallTime)) {
+        chrono::nanoseconds latency = PendingWindows::Clock::now() - sentWallTime;
+        windowLatency_.record(latency.count());
+        simulatedLatency_.record((uint64_t)((time - sentTime) * 1000.0 + 0.5));
+        latencyMs = latency.count() / 1e6f;
+        simulatedLatencyS = (float)(time - sentTime);
+      }
+      if (telemetry_)
+        telemetry_->label(time, result.robotId, result.sequence, result.label,
+                          result.classCount > 0 ? probabilities_[result.label] : kUnknown, result.inferenceTime, latencyMs,
+                          simulatedLatencyS);
+      ++labels_;
+      labelsCount_.add();
+    }
+
+    // Move on to the next packet of the queue
+    receiver.nextPacket();
+  }
+}
@@ -0,0 +1,187 @@
+// File: supervisor_pipeline.hpp
+// Description: The supervisor's work at every step: capture playback, attenuation at the robot
+// positions, windowing, window packets, central inference and result packets. The simulator is only
+// reached through three small interfaces (robot positions, the emitter and the receiver), so the
+// same pipeline runs in the Webots supervisor and headless (see headless_pipeline.hpp).
+
+#ifndef SUPERVISOR_PIPELINE_HPP
+#define SUPERVISOR_PIPELINE_HPP
+
+#include "attenuation_field.hpp"
+#include "capture_playback.hpp"
+#include "cnn_model.hpp"
+#include "fleet.hpp"
+#include "instrumentation.hpp"
+#include "quantized_cnn_model.hpp"
+#include "resampler.hpp"
+#include "result_packet.hpp"
+#include "sample_kernels.hpp"
+#include "telemetry.hpp"
+#include "vibration_map.hpp"
+#include "vibration_sources.hpp"
+#include "window_features.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Positions of the robots on the arena floor
+class RobotPoses {
+public:
+  virtual ~RobotPoses() {}
+  // Write the position of every robot at simulation time `time` into x and y, sized to the fleet
+  virtual void read(double time, std::vector<double> &x, std::vector<double> &y) = 0;
+};
+
+// Sends window packets to the robots, as a Webots Emitter
+class WindowEmitter {
+public:
+  virtual ~WindowEmitter() {}
+  virtual void send(int channel, const void *data, size_t size) = 0;
+};
+
+// Queue of the result packets sent back by the robots, as a Webots Receiver
+class ResultReceiver {
+public:
+  virtual ~ResultReceiver() {}
+  virtual size_t queueLength() const = 0;
+  virtual const void *data() const = 0;
+  virtual size_t dataSize() const = 0;
+  virtual void nextPacket() = 0;
+};
+
+struct PipelineSettings {
+  double stepRate = 1000.0 / 64;  // Supervisor steps per second
+  double arenaSize = 10.0;        // Side of the square floor centred on the origin, in meters
+  size_t windowLength = 24;       // Readings per window, the CNN input length
+  size_t windowHop = 24;          // Readings between windows; less than windowLength for overlapping windows
+  bool interpolate = false;       // Bilinear attenuation between grid nodes instead of floor()ed positions
+  double attenuationTolerance = 0.0;  // With interpolate, meters a robot moves before its gains are looked up again
+  double fieldResolution = 1.0;   // Attenuation grid nodes per meter
+  std::string fieldCache;         // Prefix of the binary caches of the attenuation grids
+  AxisCalibration calibration;
+  double captureRate = 60.0;      // Sample rate of text captures, in Hz; binary captures carry their own
+  double readingRate = 60.0;      // Readings per second in the windows, the sample rate the CNN was trained on
+  ResampleMethod resampleMethod = ResampleMethod::Sinc;
+  PlaybackEnd playbackEnd = PlaybackEnd::Stop;
+  bool sendSamples = true, sendFeatures = false;
+  size_t featureBands = 4;        // FFT band energies per axis in the features
+  // Read the vibration from a map built from the same sources, arena and attenuation grid instead of
+  // streaming the captures: a VibrationMap, shared with other readers of the process, or a stored map
+  std::shared_ptr<const VibrationField> vibrationMap;
+};
+
+// Model inputs to quantize the CNN with, built as the pipeline builds its windows: up to `windows`
+// consecutive windows of a capture (text or binary), resampled to settings.readingRate, attenuated by
+// gains from 1 down to 0.05 in turn, interleaved x, y, z and calibrated. Only the rows those windows
+// need are read. Returns false, with a reason in error, if the capture has no whole window.
+bool loadCalibrationWindows(const std::string &filename, const PipelineSettings &settings, size_t windows,
+                            std::vector<float> &inputs, std::string *error = nullptr);
+
+class SupervisorPipeline {
+public:
+  // Starts the playback of every source, unless the settings carry a vibration map; sources must not be empty
+  SupervisorPipeline(const PipelineSettings &settings, const std::vector<RobotConfig> &robots,
+                     const std::vector<VibrationSource> &sources);
+
+  // Classify the windows in the supervisor with the given TFLite flatbuffer instead of sending them.
+  // Returns false, with a reason in error, if the model cannot be loaded or takes other windows.
+  bool loadModel(const void *data, size_t size, std::string *error = nullptr);
+  // Run the int8 variant of the loaded model instead, calibrated on up to `windows` windows of the
+  // first capture of the first source (see loadCalibrationWindows). The float model is kept on failure.
+  bool quantizeModel(size_t windows, std::string *error = nullptr);
+  bool centralInference() const { return batchInference_; }
+  const QuantizedCnnModel &quantizedModel() const { return quantizedModel_; }
+
+  // Labels and events go to telemetry; with stepRecords, the positions and gains of every step too
+  void setTelemetry(TelemetrySink *telemetry, bool stepRecords);
+
+  // One step at simulation time `time`: read the robot positions, push the readings due at the step
+  // (readingRate / stepRate on average) for every robot, classify or send the completed windows, and
+  // take the results queued by the receiver
+  void step(double time, RobotPoses &poses, WindowEmitter &emitter, ResultReceiver &receiver);
+
+  // Unreadable files and malformed lines met by the playback threads since the last call
+  std::vector<CapturePlaybackError> takePlaybackErrors();
+  bool outOfData() const { return outOfData_; }
+
+  const FleetState &fleet() const { return fleet_; }
+  const PendingWindows &pendingWindows() const { return pendingWindows_; }
+  size_t sampleCount() const { return sampleCount_; }
+  size_t featureCount() const { return featureCount_; }
+
+  // Totals since the start, whatever the instrumentation setting
+  uint64_t readings() const { return readings_; }                  // Robot readings pushed into windows
+  uint64_t windowsCompleted() const { return windowsCompleted_; }
+  uint64_t labels() const { return labels_; }                      // Classified centrally or received
+  size_t stepWindows() const { return stepWindows_; }              // Completed at the last step
+
+  // Phase timings and window latencies, recorded when built with instrumentation
+  Metrics &metrics() { return metrics_; }
+
+private:
+  void receiveResults(double time, ResultReceiver &receiver);
+
+  PipelineSettings settings_;
+  std::vector<VibrationSource> sources_;
+  FleetState fleet_;
+
+  std::vector<std::unique_ptr<CapturePlayback>> playbacks_;
+  std::vector<Resampler> resamplers_;
+  ReadingClock readingClock_;
+  std::vector<float> stepReadings_;  // Readings due at the step, [reading][source][axis]
+  std::vector<SampleHistory> histories_;
+  std::vector<bool> sourceFinished_;
+  bool outOfData_ = false;
+  uint64_t mapStep_ = 0;  // Readings played from the vibration map
+  std::vector<AttenuationField> attenuationFields_;
+
+  bool batchInference_ = false;
+  CnnModel model_;
+  QuantizedCnnModel quantizedModel_;
+  std::vector<int> batchLabels_;
+
+  // Window packets encoded at a step, one per completed window: a robot completes several when its
+  // hop is shorter than the readings of a step. Without raw samples in the payload, or with central
+  // inference, the calibrated windows go to a separate contiguous buffer.
+  WindowFeatures features_;
+  size_t maxStepWindows_;
+  std::vector<uint32_t> stepReady_, stepSequence_;  // Robot and sequence number of every window of the step
+  size_t sampleCount_, featureCount_, packetSize_;
+  std::vector<unsigned char> packets_;
+  std::vector<float> calibratedWindows_;
+  std::vector<const float *> packetWindows_;
+  std::vector<float *> packetSamples_;
+
+  // Windows sent to the robots and not answered yet, to match the results to them
+  PendingWindows pendingWindows_;
+  std::vector<float> probabilities_;
+
+  TelemetrySink *telemetry_ = nullptr;
+  bool stepTelemetry_ = false;
+
+  uint64_t readings_ = 0;
+  uint64_t windowsCompleted_ = 0;
+  uint64_t labels_ = 0;
+  size_t stepWindows_ = 0;
+
+  Metrics metrics_;
+  Histogram &playbackTime_;
+  Histogram &positionsTime_;
+  Histogram &attenuationTime_;
+  Histogram &windowsTime_;
+  Histogram &inferenceTime_;
+  Histogram &emitTime_;
+  Histogram &receiveTime_;
+  Histogram &windowLatency_;
+  Histogram &simulatedLatency_;
+  Histogram &inFlight_;
+  Counter &attenuationLookups_;
+  Counter &windowsCompletedCount_;
+  Counter &windowsSent_;
+  Counter &labelsCount_;
+};
+
+#endif  // SUPERVISOR_PIPELINE_HPP
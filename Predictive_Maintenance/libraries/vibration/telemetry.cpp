@@ -0,0 +1,264 @@
+// File: telemetry.cpp
+// Description: Bounded multi-producer/single-consumer queue (sequence-numbered slots, as in Vyukov's
+// bounded queue) and writer thread behind TelemetrySink.
+
+#include "telemetry.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+using namespace std;
+
+// Formatted output is written in blocks of about this size
+static const size_t kWriteBlock = 1 << 16;
+
+TelemetryFormat telemetryFormatFor(const string &filename) {
+  size_t dot = filename.rfind('.');
+  string extension = dot == string::npos ? "" : filename.substr(dot);
+  if (extension == ".csv")
+    return TelemetryFormat::Csv;
+  if (extension == ".bin")
+    return TelemetryFormat::Binary;
+  return TelemetryFormat::Text;
+}
+
+static size_t roundUpToPowerOfTwo(size_t value) {
+  size_t power = 1;
+  while (power < value)
+    power <<= 1;
+  return power;
+}
+
+TelemetrySink::TelemetrySink(size_t capacity) :
+  capacity_(roundUpToPowerOfTwo(capacity < 2 ? 2 : capacity)),
+  mask_(capacity_ - 1),
+  slots_(new Slot[capacity_]) {
+  for (size_t i = 0; i < capacity_; ++i)
+    slots_[i].sequence.store(i, memory_order_relaxed);
+}
+
+TelemetrySink::~TelemetrySink() {
+  close();
+}
+
+bool TelemetrySink::open(const string &filename, TelemetryFormat format, string *error) {
+  if (writer_.joinable()) {
+    if (error)
+      *error = "the telemetry sink is already open";
+    return false;
+  }
+
+  if (filename == "-") {
+    out_ = &cout;
+  } else {
+    file_.open(filename, format == TelemetryFormat::Binary ? ios::out | ios::binary : ios::out);
+    if (!file_) {
+      if (error)
+        *error = "could not create " + filename;
+      return false;
+    }
+    out_ = &file_;
+  }
+
+  format_ = format;
+  buffer_.clear();
+  buffer_.reserve(kWriteBlock + 256);
+  if (format_ == TelemetryFormat::Csv) {
+    buffer_ += "kind,time,robot,index,label,value0,value1,value2,value3\n";
+  } else if (format_ == TelemetryFormat::Binary) {
+    const char header[kTelemetryHeaderSize] = {'T', 'L', (char)kTelemetryVersion, (char)kTelemetryRecordSize};
+    buffer_.append(header, kTelemetryHeaderSize);
+  }
+
+  stopping_.store(false, memory_order_relaxed);
+  accepting_.store(true, memory_order_release);
+  writer_ = thread(&TelemetrySink::writerLoop, this);
+  return true;
+}
+
+void TelemetrySink::close() {
+  if (!writer_.joinable())
+    return;
+  // A producer counts itself in pushing_ before it checks accepting_ (both sequentially consistent),
+  // so once no producer is left, any later one sees the sink closed and counts its record as dropped,
+  // and every accepted record is in the queue before the writer's final pass
+  accepting_.store(false, memory_order_seq_cst);
+  while (pushing_.load(memory_order_seq_cst) != 0)
+    this_thread::yield();
+  {
+    lock_guard<mutex> lock(wakeMutex_);
+    stopping_.store(true, memory_order_release);
+  }
+  wake_.notify_one();
+  writer_.join();
+  if (file_.is_open())
+    file_.close();
+  out_ = nullptr;
+}
+
+bool TelemetrySink::push(const TelemetryRecord &record) {
+  pushing_.fetch_add(1, memory_order_seq_cst);
+  bool queued = accepting_.load(memory_order_seq_cst) && enqueue(record);
+  if (!queued)
+    dropped_.fetch_add(1, memory_order_relaxed);
+  pushing_.fetch_sub(1, memory_order_release);
+  return queued;
+}
+
+bool TelemetrySink::enqueue(const TelemetryRecord &record) {
+  // Claim the next slot, unless the writer has not freed it yet: then the queue is full
+  size_t position = enqueue_.load(memory_order_relaxed);
+  Slot *slot;
+  for (;;) {
+    slot = &slots_[position & mask_];
+    size_t sequence = slot->sequence.load(memory_order_acquire);
+    ptrdiff_t difference = (ptrdiff_t)sequence - (ptrdiff_t)position;
+    if (difference == 0) {
+      if (enqueue_.compare_exchange_weak(position, position + 1, memory_order_relaxed))
+        break;
+    } else if (difference < 0) {
+      return false;
+    } else {
+      position = enqueue_.load(memory_order_relaxed);
+    }
+  }
+  slot->record = record;
+  slot->sequence.store(position + 1, memory_order_release);
+  return true;
+}
+
+bool TelemetrySink::label(double time, uint32_t robot, uint32_t sequence, int32_t label, float probability,
+                          float inferenceTime, float latency, float simulatedLatency) {
+  return push({TelemetryKind::Label, robot, sequence, label, time, {probability, inferenceTime, latency, simulatedLatency}});
+}
+
+bool TelemetrySink::position(double time, uint32_t robot, double x, double y) {
+  return push({TelemetryKind::Position, robot, 0, -1, time, {(float)x, (float)y, 0.0f, 0.0f}});
+}
+
+bool TelemetrySink::attenuation(double time, uint32_t robot, uint32_t source, float gain) {
+  return push({TelemetryKind::Attenuation, robot, source, -1, time, {gain, 0.0f, 0.0f, 0.0f}});
+}
+
+bool TelemetrySink::timing(double time, uint32_t step, float simulationTime, float controllerTime, size_t windows,
+                           size_t inFlight) {
+  return push({TelemetryKind::Timing, 0, step, -1, time, {simulationTime, controllerTime, (float)windows, (float)inFlight}});
+}
+
+bool TelemetrySink::event(double time, TelemetryEvent event) {
+  return push({TelemetryKind::Event, 0, (uint32_t)event, -1, time, {0.0f, 0.0f, 0.0f, 0.0f}});
+}
+
+// Writer thread
+
+static const char *kindName(TelemetryKind kind) {
+  switch (kind) {
+    case TelemetryKind::Label:
+      return "label";
+    case TelemetryKind::Position:
+      return "position";
+    case TelemetryKind::Attenuation:
+      return "attenuation";
+    case TelemetryKind::Timing:
+      return "timing";
+    case TelemetryKind::Event:
+      return "event";
+  }
+  return "unknown";
+}
+
+// Function to append the text format of a record: the messages the supervisor used to print
+static void appendText(string &buffer, const TelemetryRecord &record) {
+  char line[256];
+  int length = 0;
+  if (record.kind == TelemetryKind::Label) {
+    if (isnan(record.values[1])) {
+      // Classified by the supervisor
+      length = snprintf(line, sizeof(line), "Classification label of robot %u: %d\n", record.robot, record.label);
+    } else {
+      length = snprintf(line, sizeof(line), "Received classification label from robot %u for window %u: %d", record.robot,
+                        record.index, record.label);
+      if (!isnan(record.values[0]))
+        length += snprintf(line + length, sizeof(line) - length, " (probability %g)", record.values[0]);
+      length += snprintf(line + length, sizeof(line) - length, ", inference %g us", record.values[1]);
+      if (!isnan(record.values[2]))
+        length += snprintf(line + length, sizeof(line) - length, ", end-to-end %g ms (%g s simulated)", record.values[2],
+                           record.values[3]);
+      length += snprintf(line + length, sizeof(line) - length, "\n");
+    }
+  } else if (record.kind == TelemetryKind::Event) {
+    if (record.index == (uint32_t)TelemetryEvent::OutOfData)
+      length = snprintf(line, sizeof(line), "Out of data\n");
+    else if (record.index == (uint32_t)TelemetryEvent::MalformedResult)
+      length = snprintf(line, sizeof(line), "Ignoring malformed result packet\n");
+  }
+  // Positions, attenuation and timings are only written to CSV and binary files
+  buffer.append(line, (size_t)length);
+}
+
+void TelemetrySink::format(const TelemetryRecord &record) {
+  if (format_ == TelemetryFormat::Text) {
+    appendText(buffer_, record);
+  } else if (format_ == TelemetryFormat::Csv) {
+    char line[256];
+    int length = snprintf(line, sizeof(line), "%s,%.9g,%u,%u,%d,%.9g,%.9g,%.9g,%.9g\n", kindName(record.kind), record.time,
+                          record.robot, record.index, record.label, record.values[0], record.values[1], record.values[2],
+                          record.values[3]);
+    buffer_.append(line, (size_t)length);
+  } else {
+    unsigned char out[kTelemetryRecordSize] = {};
+    out[0] = (unsigned char)record.kind;
+    memcpy(out + 4, &record.robot, 4);
+    memcpy(out + 8, &record.index, 4);
+    memcpy(out + 12, &record.label, 4);
+    memcpy(out + 16, &record.time, 8);
+    memcpy(out + 24, record.values, 16);
+    buffer_.append((const char *)out, kTelemetryRecordSize);
+  }
+}
+
+void TelemetrySink::writeBuffer() {
+  out_->write(buffer_.data(), (streamsize)buffer_.size());
+  buffer_.clear();
+}
+
+void TelemetrySink::writerLoop() {
+  bool unflushed = !buffer_.empty();
+  for (;;) {
+    // Records queued before stopping_ was set are all taken by the pass that follows
+    bool stopping = stopping_.load(memory_order_acquire);
+    size_t taken = 0;
+    for (;;) {
+      Slot &slot = slots_[dequeue_ & mask_];
+      if (slot.sequence.load(memory_order_acquire) != dequeue_ + 1)
+        break;
+      format(slot.record);
+      slot.sequence.store(dequeue_ + capacity_, memory_order_release);
+      ++dequeue_;
+      ++taken;
+      if (buffer_.size() >= kWriteBlock)
+        writeBuffer();
+    }
+    written_.fetch_add(taken, memory_order_relaxed);
+    unflushed = unflushed || taken > 0;
+
+    if (taken > 0)
+      continue;
+
+    // Idle: flush what was written, so the console and files stay current between bursts
+    if (unflushed) {
+      writeBuffer();
+      out_->flush();
+      unflushed = false;
+    }
+    if (stopping)
+      break;
+    unique_lock<mutex> lock(wakeMutex_);
+    if (!stopping_.load(memory_order_relaxed))
+      wake_.wait_for(lock, chrono::milliseconds(5));
+  }
+}
@@ -0,0 +1,132 @@
+// File: telemetry.hpp
+// Description: Asynchronous telemetry sink. Any thread queues fixed-size records (labels, positions,
+// attenuation, step timings, events) into a bounded lock-free multi-producer/single-consumer queue,
+// without blocking, allocating or flushing; a background writer thread formats them as text, CSV or
+// binary and writes them out in large blocks. When the writer falls behind, the queue is full and new
+// records are dropped and counted, so memory stays bounded.
+//
+// Binary files start with a 4-byte header (magic "TL", version, record size), followed by records of
+// kTelemetryRecordSize little-endian bytes:
+//   offset  0  uint8     kind (TelemetryKind)
+//   offset  1  uint8[3]  reserved, 0
+//   offset  4  uint32    robot
+//   offset  8  uint32    index: window sequence, source, step or event, depending on the kind
+//   offset 12  int32     label, -1 for other kinds
+//   offset 16  float64   simulation time (s)
+//   offset 24  float32[4] values, depending on the kind (see TelemetryRecord)
+
+#ifndef TELEMETRY_HPP
+#define TELEMETRY_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+
+const uint8_t kTelemetryVersion = 1;
+const size_t kTelemetryHeaderSize = 4;
+const size_t kTelemetryRecordSize = 40;
+
+enum class TelemetryKind : uint8_t {
+  Label = 1,        // values: probability, inference time (us), end-to-end latency (ms), simulated latency (s)
+  Position = 2,     // values: x, y
+  Attenuation = 3,  // index: source; values: gain
+  Timing = 4,       // index: step; values: simulation step (us), controller step (us), windows completed, windows in flight
+  Event = 5         // index: TelemetryEvent
+};
+
+enum class TelemetryEvent : uint32_t {
+  OutOfData = 0,       // Every vibration source has finished playing
+  MalformedResult = 1  // A result packet could not be decoded
+};
+
+// Values that are not known (e.g. the latency of a window that was never matched) are NaN
+struct TelemetryRecord {
+  TelemetryKind kind;
+  uint32_t robot;
+  uint32_t index;
+  int32_t label;
+  double time;
+  float values[4];
+};
+
+enum class TelemetryFormat {
+  Text,   // The supervisor's console messages, for labels and events only
+  Csv,    // One row per record
+  Binary  // See the layout above
+};
+
+// Format from a file extension: ".csv" is Csv, ".bin" is Binary, anything else Text
+TelemetryFormat telemetryFormatFor(const std::string &filename);
+
+class TelemetrySink {
+public:
+  // capacity, in records, is rounded up to a power of two
+  explicit TelemetrySink(size_t capacity = 65536);
+  ~TelemetrySink();
+  TelemetrySink(const TelemetrySink &) = delete;
+  TelemetrySink &operator=(const TelemetrySink &) = delete;
+
+  // Start the writer thread on a file, or on the standard output for "-". Returns false, with a reason
+  // in error, if the file cannot be created or the sink is already open.
+  bool open(const std::string &filename, TelemetryFormat format, std::string *error = nullptr);
+  // Write every queued record, flush and stop the writer thread
+  void close();
+  bool isOpen() const { return writer_.joinable(); }
+
+  // Queue a record; returns false, and counts it as dropped, if the queue is full or the sink is closed.
+  // Safe to call from any number of threads.
+  bool push(const TelemetryRecord &record);
+
+  // Shorthands for the supervisor's records
+  bool label(double time, uint32_t robot, uint32_t sequence, int32_t label, float probability, float inferenceTime,
+             float latency, float simulatedLatency);
+  bool position(double time, uint32_t robot, double x, double y);
+  bool attenuation(double time, uint32_t robot, uint32_t source, float gain);
+  bool timing(double time, uint32_t step, float simulationTime, float controllerTime, size_t windows, size_t inFlight);
+  bool event(double time, TelemetryEvent event);
+
+  uint64_t written() const { return written_.load(std::memory_order_relaxed); }
+  uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+  struct Slot {
+    std::atomic<size_t> sequence;  // Position the slot can be written at, or + 1 once written
+    TelemetryRecord record;
+  };
+
+  // Claim a slot and publish the record in it; false if the queue is full
+  bool enqueue(const TelemetryRecord &record);
+  void writerLoop();
+  void format(const TelemetryRecord &record);
+  void writeBuffer();
+
+  const size_t capacity_;
+  const size_t mask_;
+  std::unique_ptr<Slot[]> slots_;
+  alignas(64) std::atomic<size_t> enqueue_{0};  // Claimed by the producers
+  alignas(64) size_t dequeue_ = 0;              // Only used by the writer thread
+  std::atomic<bool> accepting_{false};
+  std::atomic<size_t> pushing_{0};  // Producers inside push(), which close() waits for
+  std::atomic<bool> stopping_{false};
+  std::atomic<uint64_t> written_{0};
+  std::atomic<uint64_t> dropped_{0};
+
+  // Only used to put the writer thread to sleep while the queue is empty
+  std::mutex wakeMutex_;
+  std::condition_variable wake_;
+
+  TelemetryFormat format_ = TelemetryFormat::Text;
+  std::ofstream file_;
+  std::ostream *out_ = nullptr;
+  std::string buffer_;  // Formatted records waiting to be written, only used by the writer thread
+  std::thread writer_;
+};
+
+#endif  // TELEMETRY_HPP
@@ -0,0 +1,260 @@
+// File: vibration_map.cpp
+// Description: Loading, materialization and queries of the VibrationMap.
+
+#include "vibration_map.hpp"
+#include "capture_file.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+static const size_t kChunkRows = 4096;
+
+// Every reading of a playlist, one file after the other, and the sample rate in the header of its
+// first file (0 for a text capture)
+static bool loadPlaylist(const vector<string> &playlist, vector<float> &x, vector<float> &y, vector<float> &z,
+                         float &sampleRate, size_t &skippedLines, string *error) {
+  CaptureReader reader;
+  sampleRate = 0.0f;
+  for (const string &filename : playlist) {
+    if (!reader.open(filename, error))
+      return false;
+    if (&filename == &playlist.front())
+      sampleRate = reader.sampleRate();
+    size_t rows;
+    do {
+      size_t size = x.size();
+      x.resize(size + kChunkRows);
+      y.resize(size + kChunkRows);
+      z.resize(size + kChunkRows);
+      rows = reader.read(&x[size], &y[size], &z[size], kChunkRows);
+      x.resize(size + rows);
+      y.resize(size + rows);
+      z.resize(size + rows);
+    } while (rows > 0);
+    if (!reader.error().empty()) {
+      if (error)
+        *error = filename + ": " + reader.error();
+      return false;
+    }
+    skippedLines += reader.report().skippedLines;
+    reader.close();
+  }
+  return true;
+}
+
+bool VibrationMap::build(const vector<VibrationSource> &sources, double minX, double minY, double width, double height,
+                         double resolution, double captureRate, double stepRate, ResampleMethod method, PlaybackEnd end,
+                         const string &fieldCache, string *error) {
+  streams_.assign(sources.size(), Stream());
+  dense_.clear();
+  steps_ = 0;
+  loop_ = end == PlaybackEnd::Loop;
+  stepRate_ = stepRate;
+  skippedLines_ = 0;
+
+  for (size_t s = 0; s < sources.size(); ++s) {
+    vector<float> x, y, z;
+    float sampleRate;
+    if (!loadPlaylist(sources[s].playlist, x, y, z, sampleRate, skippedLines_, error))
+      return false;
+
+    // Skip the phase, then resample to one reading per map step
+    size_t cursor = min(sources[s].phase, x.size());
+    Resampler resampler(
+      [&](float &sx, float &sy, float &sz) {
+        if (cursor == x.size())
+          return false;
+        sx = x[cursor];
+        sy = y[cursor];
+        sz = z[cursor];
+        ++cursor;
+        return true;
+      },
+      sampleRate > 0.0f ? sampleRate : captureRate, stepRate, method);
+    Stream &stream = streams_[s];
+    float reading[3];
+    while (resampler.next(reading[0], reading[1], reading[2]))
+      stream.readings.insert(stream.readings.end(), reading, reading + 3);
+    stream.length = stream.readings.size() / 3;
+    if (stream.length == 0) {
+      if (error)
+        *error = "source " + to_string(s) + " has no vibration reading";
+      return false;
+    }
+    steps_ = max<uint64_t>(steps_, stream.length);
+  }
+
+  fields_ = buildSourceFields(sources, minX, minY, width, height, resolution, fieldCache);
+  return true;
+}
+
+bool VibrationMap::periodic() const {
+  // The superposition only repeats after the least common multiple of the lengths
+  for (const Stream &stream : streams_) {
+    if (loop_ && stream.length != steps_)
+      return false;
+  }
+  return true;
+}
+
+bool VibrationMap::materialize(size_t maxBytes, string *error) {
+  dense_.clear();
+  if (fields_.empty()) {
+    if (error)
+      *error = "the map has no source";
+    return false;
+  }
+  if (!periodic()) {
+    if (error)
+      *error = "looping sources of different lengths cannot be materialized";
+    return false;
+  }
+  nx_ = fields_[0].columns();
+  ny_ = fields_[0].rows();
+  uint64_t values = steps_ * nx_ * ny_ * 3;
+  if (values * sizeof(float) > maxBytes) {
+    if (error)
+      *error = "the map takes " + to_string(values * sizeof(float) / (1024 * 1024)) + " MiB";
+    return false;
+  }
+
+  // Source by source, so that the inner loop runs over contiguous nodes
+  dense_.assign(values, 0.0f);
+  for (size_t s = 0; s < streams_.size(); ++s) {
+    const AttenuationField &field = fields_[s];
+    for (uint64_t step = 0; step < streams_[s].length; ++step) {
+      const float *reading = streams_[s].at(step, false);
+      for (size_t j = 0; j < ny_; ++j) {
+        float *row = &dense_[denseIndex(step, 0, j)];
+        for (size_t i = 0; i < nx_; ++i) {
+          float gain = field.node(i, j);
+          row[3 * i] += gain * reading[0];
+          row[3 * i + 1] += gain * reading[1];
+          row[3 * i + 2] += gain * reading[2];
+        }
+      }
+    }
+  }
+  return true;
+}
+
+void VibrationMap::queryDense(double x, double y, uint64_t step, bool interpolate, float reading[3]) const {
+  const AttenuationField &grid = fields_[0];
+  if (!interpolate) {
+    const float *node = &dense_[denseIndex(step, grid.nodeColumn(x), grid.nodeRow(y))];
+    reading[0] = node[0];
+    reading[1] = node[1];
+    reading[2] = node[2];
+    return;
+  }
+
+  // Same weights as AttenuationField::bilinear, applied to the superposed readings
+  double u = (x - grid.minX()) * grid.resolution();
+  double v = (y - grid.minY()) * grid.resolution();
+  u = u < 0.0 ? 0.0 : u > nx_ - 1 ? nx_ - 1 : u;
+  v = v < 0.0 ? 0.0 : v > ny_ - 1 ? ny_ - 1 : v;
+  size_t i = (size_t)u, j = (size_t)v;
+  size_t i1 = i + 1 < nx_ ? i + 1 : i;
+  size_t j1 = j + 1 < ny_ ? j + 1 : j;
+  float fu = (float)(u - i), fv = (float)(v - j);
+  const float *n00 = &dense_[denseIndex(step, i, j)], *n10 = &dense_[denseIndex(step, i1, j)];
+  const float *n01 = &dense_[denseIndex(step, i, j1)], *n11 = &dense_[denseIndex(step, i1, j1)];
+  for (int axis = 0; axis < 3; ++axis) {
+    float bottom = n00[axis] + fu * (n10[axis] - n00[axis]);
+    float top = n01[axis] + fu * (n11[axis] - n01[axis]);
+    reading[axis] = bottom + fv * (top - bottom);
+  }
+}
+
+void VibrationMap::query(double x, double y, uint64_t step, bool interpolate, float reading[3]) const {
+  reading[0] = reading[1] = reading[2] = 0.0f;
+  if (step >= steps_) {
+    if (!loop_ || steps_ == 0)
+      return;
+    if (dense())
+      step %= steps_;
+  }
+  if (dense()) {
+    queryDense(x, y, step, interpolate, reading);
+    return;
+  }
+  for (size_t s = 0; s < streams_.size(); ++s) {
+    const float *source = streams_[s].at(step, loop_);
+    if (!source)
+      continue;
+    float gain = fields_[s].sample(x, y, interpolate);
+    reading[0] += gain * source[0];
+    reading[1] += gain * source[1];
+    reading[2] += gain * source[2];
+  }
+}
+
+void VibrationMap::query(const double *x, const double *y, size_t count, uint64_t step, bool interpolate, float *outX,
+                         float *outY, float *outZ) const {
+  if (dense() || (step >= steps_ && !loop_)) {
+    float reading[3];
+    for (size_t k = 0; k < count; ++k) {
+      query(x[k], y[k], step, interpolate, reading);
+      outX[k] = reading[0];
+      outY[k] = reading[1];
+      outZ[k] = reading[2];
+    }
+    return;
+  }
+
+  // Every point shares the source readings of the step: accumulate source by source
+  fill(outX, outX + count, 0.0f);
+  fill(outY, outY + count, 0.0f);
+  fill(outZ, outZ + count, 0.0f);
+  for (size_t s = 0; s < streams_.size(); ++s) {
+    const float *source = streams_[s].at(step, loop_);
+    if (!source)
+      continue;
+    const AttenuationField &field = fields_[s];
+    for (size_t k = 0; k < count; ++k) {
+      float gain = field.sample(x[k], y[k], interpolate);
+      outX[k] += gain * source[0];
+      outY[k] += gain * source[1];
+      outZ[k] += gain * source[2];
+    }
+  }
+}
+
+void VibrationMap::query(const double *x, const double *y, const uint64_t *steps, size_t count, bool interpolate,
+                         float *outX, float *outY, float *outZ) const {
+  float reading[3];
+  for (size_t k = 0; k < count; ++k) {
+    query(x[k], y[k], steps[k], interpolate, reading);
+    outX[k] = reading[0];
+    outY[k] = reading[1];
+    outZ[k] = reading[2];
+  }
+}
+
+void VibrationMap::queryNodes(uint64_t step, size_t i0, size_t j0, size_t columns, size_t rows, float *out) const {
+  if (dense()) {
+    for (size_t j = 0; j < rows; ++j) {
+      const float *row = &dense_[denseIndex(step, i0, j0 + j)];
+      copy(row, row + 3 * columns, out + 3 * columns * j);
+    }
+    return;
+  }
+
+  fill(out, out + 3 * columns * rows, 0.0f);
+  for (size_t s = 0; s < streams_.size(); ++s) {
+    const float *source = streams_[s].at(step, false);
+    if (!source)
+      continue;
+    const AttenuationField &field = fields_[s];
+    for (size_t j = 0; j < rows; ++j) {
+      float *row = out + 3 * columns * j;
+      for (size_t i = 0; i < columns; ++i) {
+        float gain = field.node(i0 + i, j0 + j);
+        row[3 * i] += gain * source[0];
+        row[3 * i + 1] += gain * source[1];
+        row[3 * i + 2] += gain * source[2];
+      }
+    }
+  }
+}
@@ -0,0 +1,117 @@
+// File: vibration_map.hpp
+// Description: Spatio-temporal vibration map: the superposed x, y, z vibration at any point of the
+// arena floor and any step, replacing the CSV map of python_generate_map. Every source's playlist is
+// loaded whole and resampled to the map's step rate once (in the supervisor, a map step is one
+// reading of the windows, at the rate the CNN was trained on); a query is then the sum of each source's reading
+// at the step scaled by its attenuation at the point, so its cost does not depend on the length of
+// the captures or the size of the map. materialize() also stores the sums on the attenuation grid
+// nodes as a dense [step][y][x][axis] tensor, turning a query into a single lookup.
+//
+// The map is read-only once built, so one instance can be shared by the supervisor pipeline and
+// any other reader of the same process.
+
+#ifndef VIBRATION_MAP_HPP
+#define VIBRATION_MAP_HPP
+
+#include "attenuation_field.hpp"
+#include "capture_playback.hpp"
+#include "resampler.hpp"
+#include "vibration_sources.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Superposed vibration at any point of the arena floor and any step, as the robots read it
+class VibrationField {
+public:
+  virtual ~VibrationField() {}
+
+  // Vibration at (x, y) at the given step, at the grid node below and left of the point or
+  // interpolated bilinearly between the four nodes around it; zero after the end of the captures
+  virtual void query(double x, double y, uint64_t step, bool interpolate, float reading[3]) const = 0;
+
+  // Vibration at count points at the same step, written to outX, outY and outZ
+  virtual void query(const double *x, const double *y, size_t count, uint64_t step, bool interpolate, float *outX,
+                     float *outY, float *outZ) const = 0;
+
+  // Steps until every source has played its whole playlist; a looping field is periodic and
+  // answers queries at any step
+  virtual uint64_t steps() const = 0;
+  virtual bool loops() const = 0;
+};
+
+class VibrationMap : public VibrationField {
+public:
+  // Load and resample the playlist of every source, skipping its phase, and build its attenuation
+  // field over the rectangle starting at (minX, minY), as the supervisor pipeline does. With
+  // PlaybackEnd::Loop every source wraps around at the end of its playlist; otherwise (Stop and
+  // NextFile) it is silent after it. Returns false, with a reason in error, if a capture cannot be
+  // read or a source has no reading; malformed lines are skipped and counted in skippedLines().
+  // A source is resampled from the rate in the header of its first capture, or from captureRate
+  // when that is a text capture or has no rate.
+  bool build(const std::vector<VibrationSource> &sources, double minX, double minY, double width, double height,
+             double resolution, double captureRate, double stepRate, ResampleMethod method = ResampleMethod::Sinc,
+             PlaybackEnd end = PlaybackEnd::Stop, const std::string &fieldCache = "", std::string *error = nullptr);
+
+  // Store the vibration of every step at every grid node, unless it takes more than maxBytes.
+  // Returns false, leaving the map computing its queries from the sources, if it does not fit.
+  bool materialize(size_t maxBytes, std::string *error = nullptr);
+  bool dense() const { return !dense_.empty(); }
+
+  void query(double x, double y, uint64_t step, bool interpolate, float reading[3]) const override;
+  void query(const double *x, const double *y, size_t count, uint64_t step, bool interpolate, float *outX, float *outY,
+             float *outZ) const override;
+
+  // Vibration at count points, each at its own step
+  void query(const double *x, const double *y, const uint64_t *steps, size_t count, bool interpolate, float *outX,
+             float *outY, float *outZ) const;
+
+  // Vibration at the grid nodes of the rectangle of columns x rows nodes from node (i0, j0), at a
+  // step before steps(), written row by row as x, y, z
+  void queryNodes(uint64_t step, size_t i0, size_t j0, size_t columns, size_t rows, float *out) const;
+
+  // With PlaybackEnd::Loop, the map loops over its sources
+  uint64_t steps() const override { return steps_; }
+  bool loops() const override { return loop_; }
+  // Whether the map repeats every steps(): not when looping sources have different lengths
+  bool periodic() const;
+  double stepRate() const { return stepRate_; }
+  size_t sourceCount() const { return streams_.size(); }
+  // Attenuation grid of every source; the map's grid nodes are those of the fields
+  const std::vector<AttenuationField> &fields() const { return fields_; }
+  size_t skippedLines() const { return skippedLines_; }
+
+private:
+  // Readings of a source at the map's step rate, x, y, z interleaved
+  struct Stream {
+    std::vector<float> readings;
+    size_t length = 0;
+
+    const float *at(uint64_t step, bool loop) const {
+      if (step >= length) {
+        if (!loop || length == 0)
+          return nullptr;
+        step %= length;
+      }
+      return &readings[3 * step];
+    }
+  };
+
+  size_t denseIndex(uint64_t step, size_t i, size_t j) const { return ((step * ny_ + j) * nx_ + i) * 3; }
+  void queryDense(double x, double y, uint64_t step, bool interpolate, float reading[3]) const;
+
+  std::vector<Stream> streams_;
+  std::vector<AttenuationField> fields_;
+  uint64_t steps_ = 0;
+  bool loop_ = false;
+  double stepRate_ = 0.0;
+  size_t skippedLines_ = 0;
+
+  // Materialized map: steps_ steps of ny_ rows of nx_ nodes of x, y, z
+  std::vector<float> dense_;
+  size_t nx_ = 0, ny_ = 0;
+};
+
+#endif  // VIBRATION_MAP_HPP
@@ -0,0 +1,127 @@
+// File: vibration_sources.cpp
+// Description: Propagation models, sources file parsing and per-source attenuation fields.
+
+#include "vibration_sources.hpp"
+
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <sstream>
+
+using namespace std;
+
+float propagationGain(const VibrationSource &source, double distance) {
+  switch (source.propagation) {
+    case Propagation::Inverse:
+      return (float)(1.0 / (1.0 + distance));
+    case Propagation::InverseSquare:
+      return (float)(1.0 / ((1.0 + distance) * (1.0 + distance)));
+    case Propagation::Exponential:
+      return (float)exp(-source.damping * distance);
+    case Propagation::Table: {
+      if (source.table.empty())
+        return 0.0f;
+      double position = distance / source.tableStep;
+      size_t i = (size_t)position;
+      if (i + 1 >= source.table.size())
+        return source.table.back();
+      float t = (float)(position - i);
+      return source.table[i] + t * (source.table[i + 1] - source.table[i]);
+    }
+  }
+  return 0.0f;
+}
+
+uint64_t propagationSignature(const VibrationSource &source) {
+  ostringstream description;
+  description.precision(17);
+  description << (int)source.propagation << " " << source.x << " " << source.y << " " << source.damping << " " << source.tableStep;
+  for (float gain : source.table)
+    description << " " << gain;
+  return hash<string>()(description.str());
+}
+
+static bool loadTable(const string &filename, vector<float> &table) {
+  ifstream file(filename);
+  float gain;
+  while (file >> gain)
+    table.push_back(gain);
+  return file.eof() && !table.empty();
+}
+
+bool loadSourceConfig(const string &filename, vector<VibrationSource> &sources, string *error) {
+  sources.clear();
+  ifstream file(filename);
+  if (!file.is_open()) {
+    if (error)
+      *error = "could not open " + filename;
+    return false;
+  }
+
+  string line;
+  for (size_t lineNumber = 1; getline(file, line); ++lineNumber) {
+    size_t comment = line.find('#');
+    if (comment != string::npos)
+      line.erase(comment);
+    if (line.find_first_not_of(" \t\r") == string::npos)
+      continue;
+
+    istringstream fields(line);
+    VibrationSource source;
+    string capture, keyword;
+    string problem;
+    if (!(fields >> source.x >> source.y >> capture))
+      problem = "expected \"x y capture\"";
+    source.playlist.push_back(capture);
+
+    while (problem.empty() && fields >> keyword) {
+      if (keyword == "phase") {
+        if (!(fields >> source.phase))
+          problem = "phase needs a number of readings";
+      } else if (keyword == "inverse") {
+        source.propagation = Propagation::Inverse;
+      } else if (keyword == "inverse-square") {
+        source.propagation = Propagation::InverseSquare;
+      } else if (keyword == "exponential") {
+        source.propagation = Propagation::Exponential;
+        if (!(fields >> source.damping))
+          problem = "exponential needs a damping factor";
+      } else if (keyword == "table") {
+        string tableFile;
+        source.propagation = Propagation::Table;
+        if (!(fields >> tableFile >> source.tableStep) || source.tableStep <= 0.0)
+          problem = "table needs a file and a positive step";
+        else if (!loadTable(tableFile, source.table))
+          problem = "could not read the gain table " + tableFile;
+      } else {
+        problem = "unknown keyword " + keyword;
+      }
+    }
+
+    if (!problem.empty()) {
+      if (error)
+        *error = filename + ":" + to_string(lineNumber) + ": " + problem;
+      return false;
+    }
+    sources.push_back(source);
+  }
+  return true;
+}
+
+vector<AttenuationField> buildSourceFields(const vector<VibrationSource> &sources, double minX, double minY, double width,
+                                           double height, double resolution, const string &cachePrefix) {
+  vector<AttenuationField> fields(sources.size());
+  for (size_t s = 0; s < sources.size(); ++s) {
+    const VibrationSource &source = sources[s];
+    uint64_t signature = propagationSignature(source);
+    string cache = cachePrefix.empty() ? "" : cachePrefix + to_string(s);
+    if (!cache.empty() && fields[s].load(cache, minX, minY, width, height, resolution, signature))
+      continue;
+
+    fields[s].build(minX, minY, width, height, resolution,
+                    [&](double x, double y) { return propagationGain(source, hypot(x - source.x, y - source.y)); }, signature);
+    if (!cache.empty())
+      fields[s].save(cache);
+  }
+  return fields;
+}
@@ -0,0 +1,50 @@
+// File: vibration_sources.hpp
+// Description: Registry of vibration sources (machines) on the arena floor. Each source has a
+// position, its own capture stream and phase offset, and a propagation model giving the gain of
+// its vibration at a distance. Robots sense the superposition of all sources.
+
+#ifndef VIBRATION_SOURCES_HPP
+#define VIBRATION_SOURCES_HPP
+
+#include "attenuation_field.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class Propagation {
+  Inverse,        // 1 / (1 + d)
+  InverseSquare,  // 1 / (1 + d)^2
+  Exponential,    // exp(-damping * d)
+  Table           // Linear interpolation in a user-supplied gain table, one entry every tableStep meters
+};
+
+struct VibrationSource {
+  double x = 0.0, y = 0.0;
+  std::vector<std::string> playlist;  // Capture stream of the source
+  size_t phase = 0;                    // Readings of the capture skipped before playback starts
+  Propagation propagation = Propagation::Inverse;
+  double damping = 1.0;
+  std::vector<float> table;
+  double tableStep = 1.0;
+};
+
+// Gain of a source's vibration at the given distance from it
+float propagationGain(const VibrationSource &source, double distance);
+
+// Stable description of a source's position and propagation model, for attenuation cache signatures
+uint64_t propagationSignature(const VibrationSource &source);
+
+// Read a sources file, one source per line, '#' starting a comment:
+//   x y capture [phase N] [inverse | inverse-square | exponential DAMPING | table FILE STEP]
+// A table file holds one gain per line, for distances 0, STEP, 2 * STEP, ...
+bool loadSourceConfig(const std::string &filename, std::vector<VibrationSource> &sources, std::string *error = nullptr);
+
+// Attenuation field of every source over the same floor rectangle, loaded from or saved to
+// cachePrefix + source index when a cache prefix is given
+std::vector<AttenuationField> buildSourceFields(const std::vector<VibrationSource> &sources, double minX, double minY,
+                                                double width, double height, double resolution,
+                                                const std::string &cachePrefix = "");
+
+#endif  // VIBRATION_SOURCES_HPP
@@ -0,0 +1,22 @@
+// File: window_assembler.cpp
+// Description: Construction and reset of WindowAssembler; push() is inline in the header.
+
+#include "window_assembler.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+WindowAssembler::WindowAssembler(size_t length, size_t hop) :
+  length_(max<size_t>(length, 1)),
+  hop_(max<size_t>(hop, 1)),
+  untilNext_(length_),
+  ring_(6 * length_, 0.0f) {
+}
+
+void WindowAssembler::reset() {
+  head_ = 0;
+  untilNext_ = length_;
+  windowCount_ = 0;
+  fill(ring_.begin(), ring_.end(), 0.0f);
+}
@@ -0,0 +1,59 @@
+// File: window_assembler.hpp
+// Description: Sliding window builder over a stream of x, y, z readings, with configurable window
+// length and hop. Readings are written twice into a preallocated mirrored ring, so the latest
+// window is always contiguous and can be handed out without copying.
+
+#ifndef WINDOW_ASSEMBLER_HPP
+#define WINDOW_ASSEMBLER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class WindowAssembler {
+public:
+  // Windows of `length` readings, one every `hop` readings (hop < length gives overlapping windows)
+  explicit WindowAssembler(size_t length = 24, size_t hop = 24);
+
+  // Append a reading; returns true when it completes a window, available through window()
+  bool push(float x, float y, float z) {
+    float *slot = ring_.data() + 3 * head_;
+    slot[0] = slot[3 * length_] = x;
+    slot[1] = slot[3 * length_ + 1] = y;
+    slot[2] = slot[3 * length_ + 2] = z;
+    head_ = head_ + 1 == length_ ? 0 : head_ + 1;
+
+    if (--untilNext_ > 0)
+      return false;
+    untilNext_ = hop_;
+    ++windowCount_;
+    return true;
+  }
+
+  // Whether the next reading belongs to the next window. With hop > length, the readings between
+  // two windows do not, and can be skipped instead of computed and pushed.
+  bool collecting() const { return untilNext_ <= length_; }
+
+  // Count a reading without storing it, while not collecting()
+  void skip() { --untilNext_; }
+
+  // The latest completed window: length() readings of interleaved x, y, z, oldest first.
+  // Only valid until the next push().
+  const float *window() const { return ring_.data() + 3 * head_; }
+
+  size_t length() const { return length_; }
+  size_t hop() const { return hop_; }
+  uint64_t windowCount() const { return windowCount_; }
+
+  void reset();
+
+private:
+  size_t length_;
+  size_t hop_;
+  size_t head_ = 0;       // Next slot to write, and start of the latest window
+  size_t untilNext_;      // Readings still needed before the next window is complete
+  uint64_t windowCount_ = 0;
+  std::vector<float> ring_;  // 2 * length readings: every reading is stored at slot and slot + length
+};
+
+#endif  // WINDOW_ASSEMBLER_HPP
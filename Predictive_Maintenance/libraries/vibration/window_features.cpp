@@ -0,0 +1,138 @@
+// File: window_features.cpp
+// Description: Streaming moments, real FFT and window feature extraction.
+
+#include "window_features.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+const double kPi = 3.14159265358979323846;
+
+void RunningMoments::push(double value) {
+  size_t n1 = count_++;
+  double n = (double)count_;
+  double delta = value - mean_;
+  double deltaN = delta / n;
+  double deltaN2 = deltaN * deltaN;
+  double term = delta * deltaN * n1;
+  mean_ += deltaN;
+  m4_ += term * deltaN2 * (n * n - 3 * n + 3) + 6 * deltaN2 * m2_ - 4 * deltaN * m3_;
+  m3_ += term * deltaN * (n - 2) - 3 * deltaN * m2_;
+  m2_ += term;
+  sumSquares_ += value * value;
+  peak_ = max(peak_, fabs(value));
+}
+
+double RunningMoments::rms() const {
+  return count_ ? sqrt(sumSquares_ / count_) : 0.0;
+}
+
+double RunningMoments::kurtosis() const {
+  // Relative threshold, so a constant signal does not produce rounding noise divided by ~0
+  if (count_ < 2 || m2_ <= 1e-12 * sumSquares_)
+    return 0.0;
+  return count_ * m4_ / (m2_ * m2_) - 3.0;
+}
+
+static bool isPowerOfTwo(size_t value) {
+  return value >= 2 && (value & (value - 1)) == 0;
+}
+
+RealFft::RealFft(size_t size) : size_(size) {
+  while (!isPowerOfTwo(size_))
+    ++size_;
+  size_t half = size_ / 2;
+
+  bitReversal_.resize(half);
+  size_t bits = 0;
+  while (((size_t)1 << bits) < half)
+    ++bits;
+  for (size_t i = 0; i < half; ++i) {
+    size_t reversed = 0;
+    for (size_t b = 0; b < bits; ++b)
+      if (i & ((size_t)1 << b))
+        reversed |= (size_t)1 << (bits - 1 - b);
+    bitReversal_[i] = reversed;
+  }
+
+  twiddles_.resize(max<size_t>(half / 2, 1));
+  for (size_t k = 0; k < twiddles_.size(); ++k)
+    twiddles_[k] = polar(1.0f, (float)(-2.0 * kPi * k / half));
+  realTwiddles_.resize(half);
+  for (size_t k = 0; k < half; ++k)
+    realTwiddles_[k] = polar(1.0f, (float)(-2.0 * kPi * k / size_));
+  buffer_.resize(half);
+}
+
+void RealFft::powerSpectrum(const float *input, float *power) {
+  size_t half = size_ / 2;
+
+  // Pack the even and odd samples as the real and imaginary parts of a half-size signal
+  for (size_t i = 0; i < half; ++i)
+    buffer_[bitReversal_[i]] = complex<float>(input[2 * i], input[2 * i + 1]);
+
+  // Iterative radix-2 FFT
+  for (size_t length = 2; length <= half; length *= 2) {
+    size_t stride = half / length;
+    for (size_t start = 0; start < half; start += length)
+      for (size_t k = 0; k < length / 2; ++k) {
+        complex<float> even = buffer_[start + k];
+        complex<float> odd = buffer_[start + k + length / 2] * twiddles_[k * stride];
+        buffer_[start + k] = even + odd;
+        buffer_[start + k + length / 2] = even - odd;
+      }
+  }
+
+  // Split into the spectrum of the real signal: X_k = E_k + W^k O_k
+  power[0] = norm(complex<float>(buffer_[0].real() + buffer_[0].imag(), 0.0f));
+  power[half] = norm(complex<float>(buffer_[0].real() - buffer_[0].imag(), 0.0f));
+  for (size_t k = 1; k < half; ++k) {
+    complex<float> z = buffer_[k], mirror = conj(buffer_[half - k]);
+    complex<float> even = 0.5f * (z + mirror);
+    complex<float> odd = complex<float>(0.0f, -0.5f) * (z - mirror);
+    power[k] = norm(even + realTwiddles_[k] * odd);
+  }
+}
+
+WindowFeatures::WindowFeatures(size_t windowLength, size_t bandCount)
+  : windowLength_(windowLength), bandCount_(bandCount), fft_(windowLength) {
+  size_t bins = fft_.size() / 2;  // Bins 1 .. bins, DC excluded
+  for (size_t b = 0; b <= bandCount_; ++b)
+    bandEdges_.push_back(1 + (bins * b + bandCount_ / 2) / max<size_t>(bandCount_, 1));
+  axis_.assign(fft_.size(), 0.0f);
+  power_.resize(bins + 1);
+}
+
+void WindowFeatures::compute(const float *window, float *features) {
+  for (int a = 0; a < 3; ++a) {
+    RunningMoments moments;
+    for (size_t r = 0; r < windowLength_; ++r)
+      moments.push(window[3 * r + a]);
+
+    double rms = moments.rms();
+    float *out = features + a * (kStatisticsPerAxis + bandCount_);
+    out[0] = (float)rms;
+    out[1] = (float)moments.peak();
+    out[2] = (float)(rms > 0.0 ? moments.peak() / rms : 0.0);
+    out[3] = (float)moments.kurtosis();
+    if (bandCount_ == 0)
+      continue;
+
+    // Spectrum of the window without its mean, zero-padded to the FFT size
+    float mean = (float)moments.mean();
+    for (size_t r = 0; r < windowLength_; ++r)
+      axis_[r] = window[3 * r + a] - mean;
+    fft_.powerSpectrum(axis_.data(), power_.data());
+
+    // Band energies, scaled so they sum to the one-sided AC energy of the window (Parseval)
+    float scale = 2.0f / fft_.size();
+    for (size_t b = 0; b < bandCount_; ++b) {
+      float energy = 0.0f;
+      for (size_t k = bandEdges_[b]; k < bandEdges_[b + 1]; ++k)
+        energy += k == fft_.size() / 2 ? power_[k] / 2 : power_[k];
+      out[kStatisticsPerAxis + b] = energy * scale;
+    }
+  }
+}
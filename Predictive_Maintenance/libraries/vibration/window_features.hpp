@@ -0,0 +1,77 @@
+// File: window_features.hpp
+// Description: Per-window features of the accelerometer signal, as computed on field devices:
+// RMS, peak, crest factor and kurtosis from streaming moments, and spectral band energies from a
+// real FFT of the window zero-padded to a power of two.
+//
+// Feature layout, for each axis x, y, z in turn:
+//   rms, peak, crest factor (peak / rms), kurtosis (excess, 0 for a normal distribution),
+//   energy of each of bandCount equal-width bands between DC (excluded) and the Nyquist frequency
+
+#ifndef WINDOW_FEATURES_HPP
+#define WINDOW_FEATURES_HPP
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+const size_t kStatisticsPerAxis = 4;
+
+// Mean and central moments up to the fourth, updated one sample at a time (Terriberry's
+// single-pass update), so they stay accurate on signals with a large offset such as gravity
+class RunningMoments {
+public:
+  void clear() { count_ = 0, mean_ = m2_ = m3_ = m4_ = 0.0, sumSquares_ = 0.0, peak_ = 0.0; }
+  void push(double value);
+
+  size_t count() const { return count_; }
+  double mean() const { return mean_; }
+  double variance() const { return count_ ? m2_ / count_ : 0.0; }
+  double rms() const;
+  double peak() const { return peak_; }  // Largest absolute value
+  double kurtosis() const;               // Excess kurtosis, 0 for fewer than two distinct values
+
+private:
+  size_t count_ = 0;
+  double mean_ = 0.0, m2_ = 0.0, m3_ = 0.0, m4_ = 0.0;
+  double sumSquares_ = 0.0;
+  double peak_ = 0.0;
+};
+
+// Real FFT of a power-of-two size, computed as a half-size complex FFT with precomputed twiddles
+class RealFft {
+public:
+  explicit RealFft(size_t size);
+
+  size_t size() const { return size_; }
+
+  // Power |X_k|^2 of bins 0 .. size / 2 of `size` real samples
+  void powerSpectrum(const float *input, float *power);
+
+private:
+  size_t size_;
+  std::vector<size_t> bitReversal_;
+  std::vector<std::complex<float>> twiddles_;      // Of the half-size FFT
+  std::vector<std::complex<float>> realTwiddles_;  // Of the split into the real spectrum
+  std::vector<std::complex<float>> buffer_;
+};
+
+class WindowFeatures {
+public:
+  WindowFeatures(size_t windowLength, size_t bandCount);
+
+  size_t windowLength() const { return windowLength_; }
+  size_t bandCount() const { return bandCount_; }
+  size_t featureCount() const { return 3 * (kStatisticsPerAxis + bandCount_); }
+
+  // Compute the features of a window of interleaved x, y, z readings into featureCount() floats
+  void compute(const float *window, float *features);
+
+private:
+  size_t windowLength_;
+  size_t bandCount_;
+  RealFft fft_;
+  std::vector<size_t> bandEdges_;  // bandCount_ + 1 bin indices
+  std::vector<float> axis_, power_;
+};
+
+#endif  // WINDOW_FEATURES_HPP
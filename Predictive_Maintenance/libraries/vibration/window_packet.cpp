@@ -0,0 +1,54 @@
+// File: window_packet.cpp
+// Description: Encoder and decoder for window packets. Fields are copied with memcpy, so packets can
+// be read from any buffer alignment; all supported platforms are little-endian.
+
+#include "window_packet.hpp"
+
+#include <cstring>
+
+float *encodeWindowPacketHeader(const WindowPacketHeader &header, void *buffer) {
+  unsigned char *out = (unsigned char *)buffer;
+  out[0] = 'W';
+  out[1] = 'P';
+  out[2] = kWindowPacketVersion;
+  out[3] = 3;
+  memcpy(out + 4, &header.sequence, 4);
+  memcpy(out + 8, &header.timestamp, 8);
+  memcpy(out + 16, &header.windowLength, 2);
+  memcpy(out + 18, &header.sampleCount, 2);
+  memcpy(out + 20, &header.robotId, 4);
+  memcpy(out + 24, &header.featureCount, 2);
+  memcpy(out + 26, &header.bandCount, 2);
+  return (float *)(out + kWindowPacketHeaderSize);
+}
+
+size_t encodeWindowPacket(uint32_t robotId, uint32_t sequence, double timestamp, const float *samples, size_t readings, void *buffer) {
+  WindowPacketHeader header = {robotId, sequence, timestamp, (uint16_t)readings, (uint16_t)(readings * 3), 0, 0};
+  float *out = encodeWindowPacketHeader(header, buffer);
+  memcpy(out, samples, header.sampleCount * sizeof(float));
+  return windowPacketSize(header.sampleCount);
+}
+
+bool decodeWindowPacket(const void *data, size_t size, WindowPacketHeader &header, float *samples, size_t sampleCapacity,
+                        float *features, size_t featureCapacity) {
+  const unsigned char *in = (const unsigned char *)data;
+  if (size < kWindowPacketHeaderSize || in[0] != 'W' || in[1] != 'P' || in[2] != kWindowPacketVersion || in[3] != 3)
+    return false;
+
+  memcpy(&header.sequence, in + 4, 4);
+  memcpy(&header.timestamp, in + 8, 8);
+  memcpy(&header.windowLength, in + 16, 2);
+  memcpy(&header.sampleCount, in + 18, 2);
+  memcpy(&header.robotId, in + 20, 4);
+  memcpy(&header.featureCount, in + 24, 2);
+  memcpy(&header.bandCount, in + 26, 2);
+  if ((header.sampleCount != 0 && header.sampleCount != header.windowLength * 3u) || header.sampleCount > sampleCapacity ||
+      header.featureCount > featureCapacity || size < windowPacketSize(header.sampleCount, header.featureCount))
+    return false;
+
+  if (header.sampleCount > 0)
+    memcpy(samples, in + kWindowPacketHeaderSize, header.sampleCount * sizeof(float));
+  if (header.featureCount > 0)
+    memcpy(features, in + kWindowPacketHeaderSize + header.sampleCount * sizeof(float), header.featureCount * sizeof(float));
+  return true;
+}
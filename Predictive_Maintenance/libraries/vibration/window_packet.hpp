@@ -0,0 +1,55 @@
+// File: window_packet.hpp
+// Description: Binary packet carrying one accelerometer window from the supervisor to a robot, as
+// raw samples, window features (see window_features.hpp), or both.
+//
+// Layout (little-endian, 28-byte header followed by the samples, then the features):
+//   offset  0  char[2]  magic "WP"
+//   offset  2  uint8    version (kWindowPacketVersion)
+//   offset  3  uint8    axis count (3)
+//   offset  4  uint32   sequence number of the window
+//   offset  8  float64  simulation time of the last reading, in seconds
+//   offset 16  uint16   window length, in readings
+//   offset 18  uint16   sample count (window length * axis count, or 0 without raw samples)
+//   offset 20  uint32   id of the robot the window is for
+//   offset 24  uint16   feature count (0 without features)
+//   offset 26  uint16   band count of the features
+//   offset 28  float32  samples, x, y, z of each reading in turn (the CNN input order)
+//   then       float32  features
+
+#ifndef WINDOW_PACKET_HPP
+#define WINDOW_PACKET_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+const uint8_t kWindowPacketVersion = 2;
+const size_t kWindowPacketHeaderSize = 28;
+
+struct WindowPacketHeader {
+  uint32_t robotId;
+  uint32_t sequence;
+  double timestamp;
+  uint16_t windowLength;
+  uint16_t sampleCount;
+  uint16_t featureCount;
+  uint16_t bandCount;
+};
+
+inline size_t windowPacketSize(size_t sampleCount, size_t featureCount = 0) {
+  return kWindowPacketHeaderSize + (sampleCount + featureCount) * sizeof(float);
+}
+
+// Encode a window of `readings` interleaved x, y, z readings into buffer, which must hold
+// windowPacketSize(readings * 3) bytes. Returns the packet size.
+size_t encodeWindowPacket(uint32_t robotId, uint32_t sequence, double timestamp, const float *samples, size_t readings, void *buffer);
+
+// Encode only the header of a packet, for callers that write the samples and features themselves
+// (e.g. while calibrating them). Returns the start of the samples in buffer; the features follow them.
+float *encodeWindowPacketHeader(const WindowPacketHeader &header, void *buffer);
+
+// Decode a packet, copying up to sampleCapacity samples and featureCapacity features. Returns false
+// if the packet is malformed, of another version, or has more samples or features than capacity.
+bool decodeWindowPacket(const void *data, size_t size, WindowPacketHeader &header, float *samples, size_t sampleCapacity,
+                        float *features = nullptr, size_t featureCapacity = 0);
+
+#endif  // WINDOW_PACKET_HPP
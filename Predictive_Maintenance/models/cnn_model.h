@@ -2,7 +2,9 @@
 #define AUTOENCODER_MODEL_H
 
 
-unsigned char autoencoder_model[] = {
+// Aligned so that the float weights can be used in place, and read-only so that it stays in .rodata.
+// Inline, so that every translation unit shares one array, and so one parsed graph in CnnModel.
+alignas(16) inline const unsigned char autoencoder_model[] = {
   0x1c, 0x00, 0x00, 0x00, 0x54, 0x46, 0x4c, 0x33, 0x14, 0x00, 0x20, 0x00,
   0x1c, 0x00, 0x18, 0x00, 0x14, 0x00, 0x10, 0x00, 0x0c, 0x00, 0x00, 0x00,
   0x08, 0x00, 0x04, 0x00, 0x14, 0x00, 0x00, 0x00, 0x1c, 0x00, 0x00, 0x00,
@@ -456,5 +458,5 @@ unsigned char autoencoder_model[] = {
   0x0b, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x0c, 0x00, 0x00, 0x00,
   0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03
 };
-unsigned int autoencoder_model_len = 5420;
+inline const unsigned int autoencoder_model_len = 5420;
 #endif //MODELS/AUTOENCODER/AUTOENCODER_MODEL_H
\ No newline at end of file
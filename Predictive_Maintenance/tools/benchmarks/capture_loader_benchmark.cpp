@@ -0,0 +1,113 @@
+// File: capture_loader_benchmark.cpp
+// Description: Compares the memory-mapped capture loader with the original getline/stringstream
+// loader of the supervisor, on a real capture and on a synthetic capture of arbitrary length.
+//
+// Usage: capture_loader_benchmark <capture.txt> [synthetic rows, default 100000000] [repetitions]
+
+#include <capture.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// The loader the supervisor used before the vibration library, kept verbatim as the baseline
+static vector<vector<double>> readAccelerometerData(const string &filename) {
+  vector<vector<double>> data;
+  ifstream file(filename);
+  string line;
+
+  if (!file.is_open()) {
+    cerr << "Error: Could not open the file " << filename << endl;
+    return data;
+  }
+
+  while (getline(file, line)) {
+    stringstream ss(line);
+    string value;
+    vector<double> row;
+
+    while (getline(ss, value, '\t')) {
+      row.push_back(stod(value));
+    }
+
+    data.push_back(row);
+  }
+
+  file.close();
+  return data;
+}
+
+// Function to write a synthetic capture with the same layout as the recorded ones
+static bool writeSyntheticCapture(const string &filename, size_t rows) {
+  FILE *file = fopen(filename.c_str(), "w");
+  if (!file)
+    return false;
+  unsigned state = 12345;
+  for (size_t i = 0; i < rows; ++i) {
+    state = state * 1103515245u + 12345u;
+    int a = (int)(state >> 16) % 40 - 20;
+    int b = (int)(state >> 8) % 40 - 20;
+    fprintf(file, "%.2f\t%.2f\t%.2f\n", a / 100.0, b / 100.0, 0.7 + (a + b) / 100.0);
+  }
+  return fclose(file) == 0;
+}
+
+template <typename Function> static double bestSeconds(int repetitions, Function function) {
+  double best = 1e300;
+  for (int r = 0; r < repetitions; ++r) {
+    auto start = chrono::steady_clock::now();
+    function();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (seconds < best)
+      best = seconds;
+  }
+  return best;
+}
+
+static void compareLoaders(const string &filename, int repetitions, bool runBaseline) {
+  size_t mappedRows = 0, baselineRows = 0;
+  double mapped = bestSeconds(repetitions, [&]() {
+    CaptureData data;
+    CaptureLoadReport report;
+    loadCaptureText(filename, data, &report);
+    mappedRows = data.size();
+  });
+  cout << filename << "\n  mmap loader:     " << mappedRows << " rows in " << mapped * 1e3 << " ms ("
+       << mappedRows / mapped / 1e6 << " Mrows/s)" << endl;
+
+  if (!runBaseline)
+    return;
+  double baseline = bestSeconds(repetitions, [&]() { baselineRows = readAccelerometerData(filename).size(); });
+  cout << "  getline loader:  " << baselineRows << " rows in " << baseline * 1e3 << " ms ("
+       << baselineRows / baseline / 1e6 << " Mrows/s)\n  speedup: " << baseline / mapped << "x" << endl;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    cerr << "Usage: " << argv[0] << " <capture.txt> [synthetic rows] [repetitions]" << endl;
+    return 1;
+  }
+  size_t syntheticRows = argc > 2 ? strtoull(argv[2], nullptr, 10) : 100000000;
+  int repetitions = argc > 3 ? atoi(argv[3]) : 5;
+
+  compareLoaders(argv[1], repetitions, true);
+
+  if (syntheticRows > 0) {
+    string synthetic = "synthetic_capture.txt";
+    if (!writeSyntheticCapture(synthetic, syntheticRows)) {
+      cerr << "Error: Could not write " << synthetic << endl;
+      return 1;
+    }
+    // The baseline needs around 100 bytes of heap per row, so large files run it only once
+    compareLoaders(synthetic, syntheticRows > 10000000 ? 1 : repetitions, true);
+    remove(synthetic.c_str());
+  }
+  return 0;
+}
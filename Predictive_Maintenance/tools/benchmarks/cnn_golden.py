@@ -0,0 +1,267 @@
+# File: cnn_golden.py
+# Description: Writes the golden outputs of models/cnn_model.tflite that `make check` compares the
+# native CnnModel with (cnn_golden_check.cpp): the class probabilities of consecutive 24-reading
+# windows of a capture, each scaled by a few source gains: the raw capture windows are all class 0,
+# and the attenuated ones also class 1, as the robots report them (no window of the bundled capture
+# comes out as class 2, at any gain).
+#
+# The reference is the TFLite interpreter of the Python robot (tflite_runtime, or tensorflow.lite).
+# Where neither is installed, --allow-numpy falls back to a plain numpy forward pass over the
+# flatbuffer, written independently of cnn_model.cpp; the fixture records which one produced it.
+# The checked-in cnn_golden.csv was written with the numpy reference.
+#
+# Usage: python3 cnn_golden.py [--windows N] [--allow-numpy] <model.tflite> <capture.txt> <golden.csv>
+
+import argparse
+import struct
+import sys
+
+import numpy as np
+
+GAINS = [2.0, 1.0, 0.5, 0.2, 0.1, 0.05]
+WINDOW_READINGS = 24
+
+
+def tflite_interpreter(model_path):
+    try:
+        import tflite_runtime.interpreter as tflite
+        return 'tflite_runtime', tflite.Interpreter(model_path=model_path)
+    except ImportError:
+        pass
+    try:
+        import tensorflow as tf
+        return 'tensorflow.lite', tf.lite.Interpreter(model_path=model_path)
+    except ImportError:
+        return None, None
+
+
+################## NUMPY REFERENCE ########################
+
+# Minimal flatbuffer table reader, for the few fields of the TFLite schema the model uses
+class Table:
+    def __init__(self, buf, pos):
+        self.buf = buf
+        self.pos = pos
+        self.vtable = pos - struct.unpack_from('<i', buf, pos)[0]
+        self.vtable_size = struct.unpack_from('<H', buf, self.vtable)[0]
+
+    def _field(self, index):
+        entry = 4 + 2 * index
+        if entry >= self.vtable_size:
+            return 0
+        return struct.unpack_from('<H', self.buf, self.vtable + entry)[0]
+
+    def scalar(self, index, fmt, default=0):
+        offset = self._field(index)
+        return struct.unpack_from('<' + fmt, self.buf, self.pos + offset)[0] if offset else default
+
+    def _indirect(self, index):
+        offset = self._field(index)
+        if not offset:
+            return None
+        at = self.pos + offset
+        return at + struct.unpack_from('<I', self.buf, at)[0]
+
+    def table(self, index):
+        at = self._indirect(index)
+        return Table(self.buf, at) if at is not None else None
+
+    def vector(self, index, fmt):
+        at = self._indirect(index)
+        if at is None:
+            return []
+        length = struct.unpack_from('<I', self.buf, at)[0]
+        return list(struct.unpack_from('<%d%s' % (length, fmt), self.buf, at + 4))
+
+    def tables(self, index):
+        at = self._indirect(index)
+        if at is None:
+            return []
+        length = struct.unpack_from('<I', self.buf, at)[0]
+        items = []
+        for i in range(length):
+            item = at + 4 + 4 * i
+            items.append(Table(self.buf, item + struct.unpack_from('<I', self.buf, item)[0]))
+        return items
+
+    def bytes(self, index):
+        at = self._indirect(index)
+        if at is None:
+            return b''
+        length = struct.unpack_from('<I', self.buf, at)[0]
+        return self.buf[at + 4:at + 4 + length]
+
+
+CONV_2D, FULLY_CONNECTED, MAX_POOL_2D, RESHAPE, SOFTMAX = 3, 9, 17, 22, 25
+
+
+def activate(x, function):
+    if function == 1:
+        return np.maximum(x, 0.0)
+    if function == 3:
+        return np.clip(x, 0.0, 6.0)
+    if function != 0:
+        raise ValueError('unsupported fused activation %d' % function)
+    return x
+
+
+def same_padding(size, kernel, stride, dilation):
+    out = (size + stride - 1) // stride
+    total = max((out - 1) * stride + (kernel - 1) * dilation + 1 - size, 0)
+    return out, total // 2
+
+
+class NumpyModel:
+    def __init__(self, model_path):
+        with open(model_path, 'rb') as f:
+            buf = f.read()
+        model = Table(buf, struct.unpack_from('<I', buf, 0)[0])
+        codes = []
+        for code in model.tables(1):
+            codes.append(max(code.scalar(0, 'b'), code.scalar(3, 'i')))
+        buffers = [buffer.bytes(0) for buffer in model.tables(4)]
+        subgraph = model.tables(2)[0]
+        self.tensors = []
+        for tensor in subgraph.tables(0):
+            data = buffers[tensor.scalar(2, 'I')]
+            shape = tensor.vector(0, 'i')
+            if data and tensor.scalar(1, 'b') == 0:  # FLOAT32
+                self.tensors.append((shape, np.frombuffer(data, dtype='<f4').reshape(shape)))
+            else:
+                self.tensors.append((shape, None))
+        self.inputs = subgraph.vector(1, 'i')
+        self.outputs = subgraph.vector(2, 'i')
+        self.operators = []
+        for op in subgraph.tables(3):
+            self.operators.append((codes[op.scalar(0, 'I')], op.vector(1, 'i'), op.vector(2, 'i'), op.table(4)))
+
+    def input_shape(self):
+        return self.tensors[self.inputs[0]][0]
+
+    def invoke(self, input_data):
+        values = {self.inputs[0]: input_data.astype(np.float32)}
+        for code, inputs, outputs, options in self.operators:
+            x = values[inputs[0]]
+            if code == CONV_2D:
+                y = self.conv2d(x, self.tensors[inputs[1]][1], self.tensors[inputs[2]][1] if len(inputs) > 2 else None,
+                                options)
+            elif code == MAX_POOL_2D:
+                y = self.max_pool(x, options)
+            elif code == RESHAPE:
+                y = x.reshape(self.tensors[outputs[0]][0])
+            elif code == FULLY_CONNECTED:
+                weights = self.tensors[inputs[1]][1]
+                y = x.reshape(-1, weights.shape[1]) @ weights.T
+                if len(inputs) > 2 and inputs[2] >= 0:
+                    y = y + self.tensors[inputs[2]][1]
+                y = activate(y, options.scalar(0, 'b') if options else 0)
+            elif code == SOFTMAX:
+                beta = options.scalar(0, 'f', 1.0) if options else 1.0
+                e = np.exp(beta * (x - x.max(axis=-1, keepdims=True)))
+                y = e / e.sum(axis=-1, keepdims=True)
+            else:
+                raise ValueError('unsupported operator %d' % code)
+            values[outputs[0]] = y.astype(np.float32)
+        return values[self.outputs[0]]
+
+    @staticmethod
+    def conv2d(x, filters, bias, options):
+        same = options.scalar(0, 'b') == 0
+        stride_w, stride_h = options.scalar(1, 'i'), options.scalar(2, 'i')
+        dilation_w, dilation_h = options.scalar(4, 'i', 1), options.scalar(5, 'i', 1)
+        batch, height, width, _ = x.shape
+        out_channels, kernel_h, kernel_w, _ = filters.shape
+        if same:
+            out_h, pad_h = same_padding(height, kernel_h, stride_h, dilation_h)
+            out_w, pad_w = same_padding(width, kernel_w, stride_w, dilation_w)
+        else:
+            out_h = (height - (kernel_h - 1) * dilation_h - 1) // stride_h + 1
+            out_w = (width - (kernel_w - 1) * dilation_w - 1) // stride_w + 1
+            pad_h = pad_w = 0
+        y = np.zeros((batch, out_h, out_w, out_channels), dtype=np.float64)
+        for oy in range(out_h):
+            for ox in range(out_w):
+                for ky in range(kernel_h):
+                    for kx in range(kernel_w):
+                        iy = oy * stride_h + ky * dilation_h - pad_h
+                        ix = ox * stride_w + kx * dilation_w - pad_w
+                        if 0 <= iy < height and 0 <= ix < width:
+                            y[:, oy, ox, :] += x[:, iy, ix, :] @ filters[:, ky, kx, :].T
+        if bias is not None:
+            y += bias
+        return activate(y, options.scalar(3, 'b'))
+
+    @staticmethod
+    def max_pool(x, options):
+        same = options.scalar(0, 'b') == 0
+        stride_w, stride_h = options.scalar(1, 'i'), options.scalar(2, 'i')
+        filter_w, filter_h = options.scalar(3, 'i'), options.scalar(4, 'i')
+        batch, height, width, channels = x.shape
+        if same:
+            out_h, pad_h = same_padding(height, filter_h, stride_h, 1)
+            out_w, pad_w = same_padding(width, filter_w, stride_w, 1)
+        else:
+            out_h, out_w = (height - filter_h) // stride_h + 1, (width - filter_w) // stride_w + 1
+            pad_h = pad_w = 0
+        y = np.full((batch, out_h, out_w, channels), -np.inf, dtype=np.float32)
+        for oy in range(out_h):
+            for ox in range(out_w):
+                for ky in range(filter_h):
+                    for kx in range(filter_w):
+                        iy, ix = oy * stride_h + ky - pad_h, ox * stride_w + kx - pad_w
+                        if 0 <= iy < height and 0 <= ix < width:
+                            y[:, oy, ox, :] = np.maximum(y[:, oy, ox, :], x[:, iy, ix, :])
+        return activate(y, options.scalar(5, 'b'))
+
+
+################################################################
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Golden outputs of the CNN for make check')
+    parser.add_argument('--windows', type=int, default=128, help='consecutive capture windows (default 128)')
+    parser.add_argument('--allow-numpy', action='store_true', help='use the numpy reference without a TFLite runtime')
+    parser.add_argument('model')
+    parser.add_argument('capture')
+    parser.add_argument('golden')
+    args = parser.parse_args()
+
+    # Readings as float32, as the supervisor loads them, and windows interleaved x, y, z
+    readings = np.loadtxt(args.capture, dtype=np.float64, ndmin=2)[:, :3].astype(np.float32)
+    windows = min(args.windows, len(readings) // WINDOW_READINGS)
+
+    reference, interpreter = tflite_interpreter(args.model)
+    if interpreter is not None:
+        interpreter.allocate_tensors()
+        input_details = interpreter.get_input_details()[0]
+        output_details = interpreter.get_output_details()[0]
+        input_shape = input_details['shape']
+
+        def invoke(window):
+            interpreter.set_tensor(input_details['index'], window.reshape(input_shape))
+            interpreter.invoke()
+            return interpreter.get_tensor(output_details['index']).ravel()
+    elif args.allow_numpy:
+        reference = 'numpy'
+        model = NumpyModel(args.model)
+        input_shape = model.input_shape()
+
+        def invoke(window):
+            return model.invoke(window.reshape(input_shape)).ravel()
+    else:
+        sys.exit('Error: neither tflite_runtime nor tensorflow is installed (see --allow-numpy)')
+
+    with open(args.golden, 'w') as golden:
+        golden.write('# Golden outputs of cnn_model.tflite, written by cnn_golden.py with the %s reference\n' % reference)
+        golden.write('# window: readings [24 * window, 24 * window + 24) of the capture, scaled by gain in float32\n')
+        golden.write('window,gain,label,probabilities\n')
+        for gain in GAINS:
+            for w in range(windows):
+                window = readings[w * WINDOW_READINGS:(w + 1) * WINDOW_READINGS].ravel() * np.float32(gain)
+                probabilities = invoke(window)
+                golden.write('%d,%.9g,%d,%s\n' % (w, gain, int(np.argmax(probabilities)),
+                                                  ','.join('%.9g' % p for p in probabilities)))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,140 @@
+// File: cnn_golden_check.cpp
+// Description: Checks the native CnnModel against golden outputs (cnn_golden.csv, written by
+// cnn_golden.py): every window of the fixture is rebuilt from the capture, scaled by its gain, and
+// classified, single and batched. Exits non-zero if any label differs or any probability is further
+// than the tolerance from the reference. Run by `make check`.
+// The checked-in fixture comes from the numpy reference of cnn_golden.py, a forward pass written
+// independently of cnn_model.cpp, not from the TFLite interpreter, so this is parity with that
+// reference; a fixture regenerated where tflite_runtime is installed makes it TFLite parity.
+//
+// Usage: cnn_golden_check <capture.txt> <golden.csv> [tolerance, default 1e-5]
+
+#include <capture.hpp>
+#include <cnn_model.hpp>
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../../models/cnn_model.h"
+
+using namespace std;
+
+struct GoldenWindow {
+  size_t window;
+  float gain;
+  int label;
+  vector<float> probabilities;
+};
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    cerr << "Usage: " << argv[0] << " <capture.txt> <golden.csv> [tolerance]" << endl;
+    return 1;
+  }
+  double tolerance = argc > 3 ? strtod(argv[3], nullptr) : 1e-5;
+
+  CnnModel model;
+  string error;
+  if (!model.load(autoencoder_model, autoencoder_model_len, &error)) {
+    cerr << "Error: Could not load the embedded CNN model (" << error << ")" << endl;
+    return 1;
+  }
+  CaptureData capture;
+  if (!loadCaptureText(argv[1], capture)) {
+    cerr << "Error: Could not read " << argv[1] << endl;
+    return 1;
+  }
+
+  // Fixture rows: window, gain, label, then the probabilities; '#' lines say what produced them
+  ifstream file(argv[2]);
+  if (!file.is_open()) {
+    cerr << "Error: Could not open " << argv[2] << endl;
+    return 1;
+  }
+  vector<GoldenWindow> golden;
+  string line;
+  bool header = true;
+  size_t readings = model.inputSize() / 3;
+  while (getline(file, line)) {
+    if (line.empty() || line[0] == '#') {
+      if (!line.empty())
+        cout << line << endl;
+      continue;
+    }
+    if (header) {  // Column names
+      header = false;
+      continue;
+    }
+    GoldenWindow row;
+    istringstream fields(line);
+    string field;
+    getline(fields, field, ',');
+    row.window = strtoull(field.c_str(), nullptr, 10);
+    getline(fields, field, ',');
+    row.gain = strtof(field.c_str(), nullptr);
+    getline(fields, field, ',');
+    row.label = atoi(field.c_str());
+    while (getline(fields, field, ','))
+      row.probabilities.push_back(strtof(field.c_str(), nullptr));
+    if (row.probabilities.size() != model.outputSize() || (row.window + 1) * readings > capture.size()) {
+      cerr << "Error: " << argv[2] << ": window " << row.window << " does not match the model or the capture" << endl;
+      return 1;
+    }
+    golden.push_back(row);
+  }
+  if (golden.empty()) {
+    cerr << "Error: " << argv[2] << " has no window" << endl;
+    return 1;
+  }
+
+  // The windows interleaved x, y, z and scaled in float32, as cnn_golden.py builds them
+  vector<float> inputs(golden.size() * model.inputSize());
+  for (size_t n = 0; n < golden.size(); ++n) {
+    float *input = &inputs[n * model.inputSize()];
+    size_t first = golden[n].window * readings;
+    for (size_t i = 0; i < readings; ++i) {
+      input[3 * i] = capture.x()[first + i] * golden[n].gain;
+      input[3 * i + 1] = capture.y()[first + i] * golden[n].gain;
+      input[3 * i + 2] = capture.z()[first + i] * golden[n].gain;
+    }
+  }
+
+  vector<float> outputs(golden.size() * model.outputSize());
+  vector<int> batchLabels(golden.size());
+  model.classifyBatch(inputs.data(), golden.size(), batchLabels.data());
+  size_t labelMismatches = 0, probabilityMismatches = 0;
+  double largestDifference = 0.0;
+  vector<size_t> labelCounts(model.outputSize());
+  for (size_t n = 0; n < golden.size(); ++n) {
+    float *output = &outputs[n * model.outputSize()];
+    model.invoke(&inputs[n * model.inputSize()], output);
+    int label = 0;
+    bool far = false;
+    for (size_t c = 0; c < model.outputSize(); ++c) {
+      label = output[c] > output[label] ? (int)c : label;
+      double difference = fabs(output[c] - golden[n].probabilities[c]);
+      largestDifference = max(largestDifference, difference);
+      far = far || difference > tolerance;
+    }
+    labelCounts[golden[n].label]++;
+    if (label != golden[n].label || batchLabels[n] != golden[n].label) {
+      ++labelMismatches;
+      cerr << "Window " << golden[n].window << " at gain " << golden[n].gain << ": label " << label << " (batched "
+           << batchLabels[n] << "), expected " << golden[n].label << endl;
+    }
+    probabilityMismatches += far;
+  }
+
+  cout << golden.size() << " windows, reference labels:";
+  for (size_t c = 0; c < labelCounts.size(); ++c)
+    cout << " " << c << "=" << labelCounts[c];
+  cout << "\n  " << labelMismatches << " label mismatches, " << probabilityMismatches
+       << " windows with a probability further than " << tolerance << " (largest difference " << largestDifference << ")"
+       << endl;
+  return labelMismatches == 0 && probabilityMismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,91 @@
+// File: cnn_inference_benchmark.cpp
+// Description: Per-inference latency of the native CNN runner on consecutive 24-reading windows
+// of a capture, using the model embedded in models/cnn_model.h, and its throughput when the
+// windows are classified in batches (as the supervisor does for a fleet).
+//
+// Usage: cnn_inference_benchmark <capture.txt> [inferences, default 100000] [batch size, default 100]
+
+#include <capture.hpp>
+#include <cnn_model.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../../models/cnn_model.h"
+
+using namespace std;
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    cerr << "Usage: " << argv[0] << " <capture.txt> [inferences] [batch size]" << endl;
+    return 1;
+  }
+  size_t inferences = argc > 2 ? strtoull(argv[2], nullptr, 10) : 100000;
+  size_t batchSize = argc > 3 ? strtoull(argv[3], nullptr, 10) : 100;
+
+  CnnModel model;
+  string error;
+  if (!model.load(autoencoder_model, autoencoder_model_len, &error)) {
+    cerr << "Error: Could not load the embedded CNN model (" << error << ")" << endl;
+    return 1;
+  }
+
+  CaptureData capture;
+  if (!loadCaptureText(argv[1], capture) || capture.size() < 24) {
+    cerr << "Error: Could not read a window from " << argv[1] << endl;
+    return 1;
+  }
+
+  // Interleave the capture into model inputs, one window per 24 readings
+  size_t readings = model.inputSize() / 3;
+  size_t windows = capture.size() / readings;
+  vector<float> inputs(windows * model.inputSize());
+  for (size_t i = 0; i < windows * readings; ++i) {
+    inputs[3 * i] = capture.x()[i];
+    inputs[3 * i + 1] = capture.y()[i];
+    inputs[3 * i + 2] = capture.z()[i];
+  }
+
+  vector<double> latencies(inferences);
+  vector<size_t> labelCounts(model.outputSize());
+  vector<int> labels(windows);
+  for (size_t n = 0; n < inferences; ++n) {
+    const float *input = inputs.data() + (n % windows) * model.inputSize();
+    auto start = chrono::steady_clock::now();
+    int label = model.classify(input);
+    latencies[n] = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+    labelCounts[label]++;
+    labels[n % windows] = label;
+  }
+
+  // The same windows in batches, checking the labels against the single-window runs
+  batchSize = max<size_t>(1, min(batchSize, windows));
+  vector<int> batchLabels(batchSize);
+  size_t mismatches = 0, batches = max<size_t>(1, inferences / batchSize);
+  auto batchStart = chrono::steady_clock::now();
+  for (size_t b = 0; b < batches; ++b) {
+    size_t first = (b * batchSize) % (windows - batchSize + 1);
+    model.classifyBatch(inputs.data() + first * model.inputSize(), batchSize, batchLabels.data());
+    for (size_t i = 0; i < batchSize; ++i)
+      mismatches += first + i < inferences && batchLabels[i] != labels[first + i];
+  }
+  double batchSeconds = chrono::duration<double>(chrono::steady_clock::now() - batchStart).count();
+
+  double total = 0.0;
+  for (double latency : latencies)
+    total += latency;
+  sort(latencies.begin(), latencies.end());
+  cout << inferences << " inferences over " << windows << " windows\n"
+       << "  mean " << total / inferences << " us, p50 " << latencies[inferences / 2] << " us, p99 "
+       << latencies[inferences * 99 / 100] << " us, max " << latencies.back() << " us\n"
+       << "  throughput " << inferences / total * 1e6 << " inferences/s\n  labels:";
+  for (size_t label = 0; label < labelCounts.size(); ++label)
+    cout << " " << label << "=" << labelCounts[label];
+  cout << "\n  batches of " << batchSize << ": " << batches * batchSize / batchSeconds << " inferences/s, "
+       << batchSeconds / batches * 1e6 << " us per batch, " << mismatches << " label mismatches" << endl;
+  return 0;
+}
@@ -0,0 +1,142 @@
+// File: cnn_quantization_benchmark.cpp
+// Description: Accuracy and speed of the int8 post-training-quantized CNN against the float model.
+// The first windows of a capture calibrate the activation ranges, as in the supervisor; every window
+// of the capture, as is and scaled by the source gains of attenuated robots, is then classified by
+// both models and the quantized labels and probabilities compared.
+//
+// Usage: cnn_quantization_benchmark <capture.txt> [calibration windows, default 256] [timed inferences, default 100000]
+
+#include <capture.hpp>
+#include <cnn_model.hpp>
+#include <quantized_cnn_model.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../../models/cnn_model.h"
+
+using namespace std;
+
+const int kTimingRounds = 5;
+// Source gains of the held-out windows: the capture as is is all class 0, attenuated windows are
+// class 1 as well
+const float kGains[] = {1.0f, 0.5f, 0.2f, 0.1f, 0.05f};
+const size_t kGainCount = sizeof(kGains) / sizeof(kGains[0]);
+
+// Function to time `inferences` classifications, in microseconds per inference
+template <typename Model> static double timeInferences(Model &model, const vector<float> &inputs, size_t windows, size_t inferences) {
+  size_t inputSize = model.inputSize();
+  int checksum = 0;
+  auto start = chrono::steady_clock::now();
+  for (size_t n = 0; n < inferences; ++n)
+    checksum += model.classify(inputs.data() + (n % windows) * inputSize);
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  if (checksum < 0)
+    cout << checksum;
+  return seconds / inferences * 1e6;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    cerr << "Usage: " << argv[0] << " <capture.txt> [calibration windows] [timed inferences]" << endl;
+    return 1;
+  }
+  size_t calibrationWindows = argc > 2 ? strtoull(argv[2], nullptr, 10) : 256;
+  size_t inferences = argc > 3 ? strtoull(argv[3], nullptr, 10) : 100000;
+
+  CnnModel model;
+  string error;
+  if (!model.load(autoencoder_model, autoencoder_model_len, &error)) {
+    cerr << "Error: Could not load the embedded CNN model (" << error << ")" << endl;
+    return 1;
+  }
+
+  CaptureData capture;
+  size_t readings = model.inputSize() / 3;
+  if (!loadCaptureText(argv[1], capture) || capture.size() < readings) {
+    cerr << "Error: Could not read a window from " << argv[1] << endl;
+    return 1;
+  }
+  // The capture windows once per gain, the unscaled ones first so that they calibrate
+  size_t captureWindows = capture.size() / readings;
+  size_t windows = captureWindows * kGainCount;
+  vector<float> inputs(windows * model.inputSize());
+  for (size_t g = 0; g < kGainCount; ++g) {
+    float *gainInputs = inputs.data() + g * captureWindows * model.inputSize();
+    for (size_t i = 0; i < captureWindows * readings; ++i) {
+      gainInputs[3 * i] = capture.x()[i] * kGains[g];
+      gainInputs[3 * i + 1] = capture.y()[i] * kGains[g];
+      gainInputs[3 * i + 2] = capture.z()[i] * kGains[g];
+    }
+  }
+
+  calibrationWindows = max<size_t>(1, min(calibrationWindows, captureWindows));
+  QuantizedCnnModel quantized;
+  auto buildStart = chrono::steady_clock::now();
+  if (!quantized.build(model, inputs.data(), calibrationWindows, &error)) {
+    cerr << "Error: Could not quantize the CNN model (" << error << ")" << endl;
+    return 1;
+  }
+  double buildSeconds = chrono::duration<double>(chrono::steady_clock::now() - buildStart).count();
+
+  // Accuracy: agreement with the float labels, split between calibration and held-out windows
+  size_t classes = model.outputSize();
+  vector<float> floatOutput(classes), quantizedOutput(classes);
+  vector<size_t> confusion(classes * classes);
+  size_t agreeCalibration = 0, agreeHeldOut = 0;
+  vector<size_t> agreeGain(kGainCount);
+  double maxError = 0.0, totalError = 0.0;
+  for (size_t w = 0; w < windows; ++w) {
+    const float *input = inputs.data() + w * model.inputSize();
+    model.invoke(input, floatOutput.data());
+    quantized.invoke(input, quantizedOutput.data());
+    size_t floatLabel = max_element(floatOutput.begin(), floatOutput.end()) - floatOutput.begin();
+    size_t quantizedLabel = max_element(quantizedOutput.begin(), quantizedOutput.end()) - quantizedOutput.begin();
+    confusion[floatLabel * classes + quantizedLabel]++;
+    if (floatLabel == quantizedLabel) {
+      (w < calibrationWindows ? agreeCalibration : agreeHeldOut)++;
+      agreeGain[w / captureWindows]++;
+    }
+    for (size_t c = 0; c < classes; ++c) {
+      double difference = fabs(floatOutput[c] - quantizedOutput[c]);
+      maxError = max(maxError, difference);
+      totalError += difference;
+    }
+  }
+
+  // Alternate the models over a few rounds and keep the best round of each, so that load on the
+  // machine affects both alike
+  double floatMicroseconds = 1e30, quantizedMicroseconds = 1e30;
+  for (int round = 0; round < kTimingRounds; ++round) {
+    floatMicroseconds = min(floatMicroseconds, timeInferences(model, inputs, windows, inferences / kTimingRounds));
+    quantizedMicroseconds = min(quantizedMicroseconds, timeInferences(quantized, inputs, windows, inferences / kTimingRounds));
+  }
+
+  size_t heldOut = windows - calibrationWindows;
+  cout << "Quantized with " << calibrationWindows << " calibration windows in " << buildSeconds * 1e3 << " ms, "
+       << windows << " windows compared\n"
+       << "  parameters: float " << autoencoder_model_len << " bytes of flatbuffer, int8 " << quantized.parameterBytes() << " bytes\n"
+       << "  label agreement: calibration " << 100.0 * agreeCalibration / calibrationWindows << "%, held out "
+       << (heldOut ? 100.0 * agreeHeldOut / heldOut : 100.0) << "%\n"
+       << "  label agreement by gain:";
+  for (size_t g = 0; g < kGainCount; ++g)
+    cout << " " << kGains[g] << " " << 100.0 * agreeGain[g] / captureWindows << "%";
+  cout << "\n"
+       << "  probability error: mean " << totalError / (windows * classes) << ", max " << maxError << "\n"
+       << "  latency: float " << floatMicroseconds << " us, int8 " << quantizedMicroseconds << " us ("
+       << floatMicroseconds / quantizedMicroseconds << "x)\n"
+       << "  confusion (rows float label, columns int8 label):\n";
+  for (size_t f = 0; f < classes; ++f) {
+    cout << "   ";
+    for (size_t q = 0; q < classes; ++q)
+      cout << " " << confusion[f * classes + q];
+    cout << "\n";
+  }
+  cout << flush;
+  return 0;
+}
@@ -0,0 +1,88 @@
+// File: map_codec_check.cpp
+// Description: Round trip of the map store's chunk codec (encodeMapChunk, decodeMapChunk): smooth
+// vibration series, all-zero chunks, chunks that end in a partial block, single steps, and values
+// at and beyond the +-2^29 quanta clamp, alternating between the two ends so that every delta is
+// the largest the 32-bit zigzag must hold. Every value must decode to its clamped value within
+// quantum / 2 (plus the float rounding of the decoded value), and truncated or padded chunks must
+// be rejected. Exits non-zero on any failure. Run by `make check`.
+//
+// Usage: map_codec_check
+
+#include <map_store.hpp>
+
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static const float kQuantum = 1e-4f;
+static const double kLargest = 536870912.0 * kQuantum;  // 2^29 quanta, the codec's clamp
+
+// Function to encode and decode one chunk, returning the number of failures
+static size_t roundTrip(const string &name, const vector<float> &values, size_t steps, size_t nodes) {
+  vector<unsigned char> encoded;
+  encodeMapChunk(values.data(), steps, nodes, kQuantum, encoded);
+  vector<float> decoded(values.size());
+  size_t failures = 0;
+  if (!decodeMapChunk(encoded.data(), encoded.size(), steps, nodes, kQuantum, decoded.data())) {
+    cerr << name << ": the encoded chunk does not decode" << endl;
+    ++failures;
+  }
+
+  double largestError = 0.0;
+  for (size_t i = 0; i < values.size() && failures == 0; ++i) {
+    double expected = max(-kLargest, min(kLargest, (double)values[i]));
+    double error = fabs(decoded[i] - expected);
+    largestError = max(largestError, error);
+    if (error > kQuantum * 0.5 * (1.0 + 1e-3) + fabs(expected) * 1e-6) {
+      cerr << name << ": value " << i << " is " << values[i] << ", decoded " << decoded[i] << endl;
+      ++failures;
+    }
+  }
+
+  // A chunk missing its last byte, or with a byte too many, is rejected
+  if (!encoded.empty() && decodeMapChunk(encoded.data(), encoded.size() - 1, steps, nodes, kQuantum, decoded.data())) {
+    cerr << name << ": a truncated chunk decodes" << endl;
+    ++failures;
+  }
+  encoded.push_back(0);
+  if (decodeMapChunk(encoded.data(), encoded.size(), steps, nodes, kQuantum, decoded.data())) {
+    cerr << name << ": a chunk with trailing bytes decodes" << endl;
+    ++failures;
+  }
+
+  cout << name << ": " << values.size() << " values in " << encoded.size() - 1 << " bytes, largest error "
+       << largestError << (failures == 0 ? "" : ", FAILED") << endl;
+  return failures;
+}
+
+int main() {
+  size_t failures = 0;
+
+  // Smooth series of a few nodes, as the maps hold; 256 x 37 x 3 values end in a partial block
+  size_t steps = 256, nodes = 37;
+  vector<float> values(steps * nodes * 3);
+  for (size_t t = 0; t < steps; ++t)
+    for (size_t n = 0; n < nodes * 3; ++n)
+      values[t * nodes * 3 + n] = 0.8f * sinf(0.05f * t + 0.3f * n) + (n % 3 == 2 ? -9.81f : 0.0f);
+  failures += roundTrip("smooth", values, steps, nodes);
+
+  failures += roundTrip("zeros", vector<float>(steps * nodes * 3, 0.0f), steps, nodes);
+  failures += roundTrip("single step", vector<float>(values.begin(), values.begin() + nodes * 3), 1, nodes);
+
+  // The clamp: exactly +-2^29 quanta, just inside, and far beyond, alternating sign every step so
+  // that the deltas reach 2^30 and their zigzag 2^31
+  steps = 64;
+  nodes = 3;
+  values.assign(steps * nodes * 3, 0.0f);
+  const float ends[] = {(float)kLargest, (float)(kLargest * 0.999), 1e30f, INFINITY};
+  for (size_t t = 0; t < steps; ++t)
+    for (size_t n = 0; n < nodes * 3; ++n)
+      values[t * nodes * 3 + n] = (t % 2 == 0 ? 1.0f : -1.0f) * ends[(t / 2 + n) % 4];
+  failures += roundTrip("clamp", values, steps, nodes);
+
+  cout << (failures == 0 ? "The chunk codec round-trips" : "The chunk codec FAILED") << endl;
+  return failures == 0 ? 0 : 1;
+}
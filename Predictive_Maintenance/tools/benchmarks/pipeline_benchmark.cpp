@@ -0,0 +1,108 @@
+// File: pipeline_benchmark.cpp
+// Description: Throughput of the whole supervisor pipeline (playback, attenuation, windowing,
+// window packets, inference and result packets) without Webots: robots follow scripted random walks
+// and the windows go through an in-memory radio to stand-in robots running the native CNN, or are
+// classified centrally. Each case runs a fixed number of steps, after a warm-up, and reports the
+// time per step, the robot readings (x, y, z samples) and windows processed per second, and a hash
+// of the final labels, which only changes if the pipeline's results do.
+//
+// Usage: pipeline_benchmark <capture.txt> [steps, default 2000] [filter, a substring of the case names]
+
+#include <headless_pipeline.hpp>
+#include <supervisor_pipeline.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../../models/cnn_model.h"
+
+using namespace std;
+
+struct BenchmarkCase {
+  size_t robots;
+  string payload;    // raw, features or both, sent to the stand-in robots
+  string inference;  // robots or supervisor; the int8 model is an accuracy simulation, see cnn_quantization_benchmark
+};
+
+static const size_t kWarmupSteps = 50;
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    cerr << "Usage: " << argv[0] << " <capture.txt> [steps] [filter]" << endl;
+    return 1;
+  }
+  size_t steps = argc > 2 ? strtoull(argv[2], nullptr, 10) : 2000;
+  string filter = argc > 3 ? argv[3] : "";
+
+  vector<BenchmarkCase> cases;
+  for (size_t robots : {1, 100, 1000}) {
+    cases.push_back({robots, "raw", "robots"});
+    cases.push_back({robots, "features", "robots"});
+    cases.push_back({robots, "raw", "supervisor"});
+  }
+
+  cout << left << setw(56) << "Benchmark" << right << setw(14) << "Time/step" << setw(8) << "Steps" << setw(14)
+       << "readings/s" << setw(12) << "windows/s" << setw(10) << "labels" << setw(18) << "label hash" << endl;
+  cout << string(132, '-') << endl;
+
+  for (const BenchmarkCase &c : cases) {
+    string name = "pipeline/robots:" + to_string(c.robots) + "/payload:" + c.payload + "/inference:" + c.inference;
+    if (name.find(filter) == string::npos)
+      continue;
+
+    PipelineSettings settings;
+    settings.playbackEnd = PlaybackEnd::Loop;
+    settings.sendSamples = c.payload != "features";
+    settings.sendFeatures = c.payload != "raw";
+    vector<RobotConfig> robots = gridFleet(c.robots, settings.arenaSize, 2);
+    VibrationSource source;
+    source.playlist.push_back(argv[1]);
+
+    SupervisorPipeline pipeline(settings, robots, {source});
+    string error;
+    if (c.inference != "robots" && !pipeline.loadModel(autoencoder_model, autoencoder_model_len, &error)) {
+      cerr << name << ": could not load the embedded CNN model (" << error << ")" << endl;
+      continue;
+    }
+
+    ScriptedTrajectories poses(robots, TrajectoryKind::RandomWalk, settings.arenaSize);
+    LoopbackRadio radio;
+    if (c.inference == "robots" && !radio.loadModel(autoencoder_model, autoencoder_model_len, &error)) {
+      cerr << name << ": could not load the embedded CNN model (" << error << ")" << endl;
+      continue;
+    }
+
+    double stepTime = 1.0 / settings.stepRate;
+    size_t step = 0;
+    for (; step < kWarmupSteps; ++step) {
+      pipeline.step(step * stepTime, poses, radio, radio);
+      radio.deliver();
+    }
+    uint64_t readings = pipeline.readings(), windows = pipeline.windowsCompleted();
+
+    auto start = chrono::steady_clock::now();
+    for (; step < kWarmupSteps + steps; ++step) {
+      pipeline.step(step * stepTime, poses, radio, radio);
+      radio.deliver();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    for (const CapturePlaybackError &playbackError : pipeline.takePlaybackErrors())
+      cerr << playbackError.filename << ":" << playbackError.line << ": " << playbackError.message << endl;
+
+    // FNV-1a over the labels of the fleet
+    uint64_t hash = 14695981039346656037ull;
+    for (int label : pipeline.fleet().label)
+      hash = (hash ^ (uint64_t)(uint32_t)label) * 1099511628211ull;
+
+    cout << left << setw(56) << name << right << fixed << setprecision(1) << setw(11) << seconds / steps * 1e6 << " us"
+         << setw(8) << steps << setprecision(0) << setw(14) << (pipeline.readings() - readings) / seconds << setw(12)
+         << (pipeline.windowsCompleted() - windows) / seconds << setw(10) << pipeline.labels() << "  " << hex
+         << setw(16) << setfill('0') << hash << dec << setfill(' ') << endl;
+  }
+  return 0;
+}
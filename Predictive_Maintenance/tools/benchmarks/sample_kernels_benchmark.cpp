@@ -0,0 +1,118 @@
+// File: sample_kernels_benchmark.cpp
+// Description: Throughput of the sample kernels at every SIMD level supported by this CPU: the
+// per-step superposition of a source reading over the fleet, and the calibration and packing of
+// a batch of windows. Every SIMD level is first checked against the scalar kernels, element by
+// element, at the given sizes and at sizes that leave SSE and scalar tails; the benchmark exits
+// non-zero on any mismatch beyond the rounding difference of a fused multiply-add.
+//
+// Usage: sample_kernels_benchmark [robots, default 1024] [window length, default 24] [iterations, default 20000]
+
+#include <sample_kernels.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+// Relative difference allowed between a SIMD and the scalar result: an FMA rounds once where the
+// scalar multiply and add round twice, a few units in the last place at most
+static const double kTolerance = 1e-6;
+
+// Function to run both kernels once on deterministic inputs: accumulateScaled over `robots`
+// readings, then scaleAndCalibrateBatch with reading gains over `robots` windows of windowLength
+// readings. Returns their outputs one after the other.
+static vector<float> runKernels(size_t robots, size_t windowLength, const AxisCalibration &calibration) {
+  vector<float> gains(robots), readings(robots), windows(robots * windowLength * 3), readingGains(robots * windowLength);
+  for (size_t k = 0; k < robots; ++k) {
+    gains[k] = 1.0f / (1.0f + k % 17);
+    readings[k] = (float)(k % 13) * 0.37f - 2.0f;
+  }
+  for (size_t i = 0; i < windows.size(); ++i)
+    windows[i] = (float)(i % 101) * 0.01f - 0.5f;
+  for (size_t i = 0; i < readingGains.size(); ++i)
+    readingGains[i] = 1.0f / (1.0f + i % 23);
+  vector<float> packed(windows.size());
+  vector<const float *> in(robots), inGains(robots);
+  vector<float *> out(robots);
+  for (size_t k = 0; k < robots; ++k) {
+    in[k] = windows.data() + k * windowLength * 3;
+    inGains[k] = readingGains.data() + k * windowLength;
+    out[k] = packed.data() + k * windowLength * 3;
+  }
+
+  accumulateScaled(readings.data(), gains.data(), 0.731f, robots);
+  scaleAndCalibrateBatch(in.data(), inGains.data(), robots, windowLength, calibration, out.data());
+  readings.insert(readings.end(), packed.begin(), packed.end());
+  return readings;
+}
+
+// Function to count the values further than kTolerance from the scalar reference
+static size_t mismatches(const vector<float> &values, const vector<float> &reference) {
+  size_t count = 0;
+  for (size_t i = 0; i < values.size(); ++i)
+    count += fabs(values[i] - reference[i]) > kTolerance * max(1.0, fabs((double)reference[i]));
+  return count;
+}
+
+int main(int argc, char **argv) {
+  size_t robots = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1024;
+  size_t windowLength = argc > 2 ? strtoull(argv[2], nullptr, 10) : 24;
+  size_t iterations = argc > 3 ? strtoull(argv[3], nullptr, 10) : 20000;
+
+  vector<float> gains(robots), readings(robots), windows(robots * windowLength * 3), packed(windows.size());
+  for (size_t k = 0; k < robots; ++k)
+    gains[k] = 1.0f / (1.0f + k % 17);
+  for (size_t i = 0; i < windows.size(); ++i)
+    windows[i] = (float)(i % 101) * 0.01f - 0.5f;
+  vector<const float *> in(robots);
+  vector<float *> out(robots);
+  for (size_t k = 0; k < robots; ++k) {
+    in[k] = windows.data() + k * windowLength * 3;
+    out[k] = packed.data() + k * windowLength * 3;
+  }
+  AxisCalibration calibration;
+  calibration.gain[1] = 1.02f;
+  calibration.offset[2] = -9.81f;
+
+  SimdLevel detected = detectSimdLevel();
+  cout << robots << " robots, windows of " << windowLength << " readings, " << iterations << " iterations" << endl;
+  // Sizes that leave a 4-wide SSE block and a scalar remainder after the 8-wide AVX2 blocks
+  size_t tailRobots = robots + 7, tailWindowLength = windowLength + 5;
+  setSimdLevel(SimdLevel::Scalar);
+  vector<float> reference = runKernels(robots, windowLength, calibration);
+  vector<float> tailReference = runKernels(tailRobots, tailWindowLength, calibration);
+  size_t failures = 0;
+  for (int level = (int)SimdLevel::Scalar + 1; level <= (int)detected; ++level) {
+    setSimdLevel((SimdLevel)level);
+    size_t count = mismatches(runKernels(robots, windowLength, calibration), reference) +
+                   mismatches(runKernels(tailRobots, tailWindowLength, calibration), tailReference);
+    cout << "  " << simdLevelName(simdLevel()) << ": "
+         << (count == 0 ? "matches the scalar kernels" : to_string(count) + " values differ from the scalar kernels")
+         << endl;
+    failures += count;
+  }
+
+  for (int level = 0; level <= (int)detected; ++level) {
+    setSimdLevel((SimdLevel)level);
+    fill(readings.begin(), readings.end(), 0.0f);
+
+    auto start = chrono::steady_clock::now();
+    for (size_t n = 0; n < iterations; ++n)
+      accumulateScaled(readings.data(), gains.data(), 0.001f * (n % 7), robots);
+    double accumulateSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    for (size_t n = 0; n < iterations; ++n)
+      scaleAndCalibrateBatch(in.data(), nullptr, robots, windowLength, calibration, out.data());
+    double calibrateSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "  " << simdLevelName(simdLevel()) << ": accumulate " << robots * iterations / accumulateSeconds / 1e6
+         << " M robot-readings/s, calibrate " << windows.size() * iterations / calibrateSeconds / 1e6 << " M samples/s"
+         << " (checksum " << readings[robots / 2] + packed[packed.size() / 2] << ")" << endl;
+  }
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,192 @@
+// File: vibration_map_benchmark.cpp
+// Description: Query throughput of the VibrationMap against the table scan of the Python map
+// generator (query_vibration filters every row of the map for each query). The map is computed from
+// the sources or materialized on its grid, queried one point at a time or a batch of points at the
+// same step, on the map of python_generate_map and on a larger arena. The Python map is also read
+// back from a map store (see map_store.hpp), at random steps and as robots walking through time.
+//
+// Usage: vibration_map_benchmark <capture.txt> [queries, default 10000000]
+
+#include <map_store.hpp>
+#include <vibration_map.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// One row of the Python map: Time, X, Y, Vibration_X, Vibration_Y, Vibration_Z
+struct MapRow {
+  uint32_t time;
+  int x, y;
+  float vibration[3];
+};
+
+static const size_t kBatch = 1000;  // Points per batched query, a large fleet at one step
+
+static void report(const string &name, size_t queries, double seconds, double checksum) {
+  cout << left << setw(48) << name << right << fixed << setprecision(1) << setw(12) << seconds / queries * 1e9 << " ns"
+       << setprecision(2) << setw(14) << queries / seconds / 1e6 << " Mq/s" << setprecision(3) << setw(16) << checksum
+       << endl;
+}
+
+static void benchmarkMap(const string &name, const VibrationField &map, double size, size_t queries) {
+  mt19937 random(1);
+  uniform_real_distribution<double> coordinate(0.0, size);
+  uniform_int_distribution<uint64_t> step(0, map.steps() - 1);
+  vector<double> x(kBatch), y(kBatch);
+  vector<uint64_t> steps(kBatch);
+  for (size_t k = 0; k < kBatch; ++k) {
+    x[k] = coordinate(random);
+    y[k] = coordinate(random);
+    steps[k] = step(random);
+  }
+
+  double checksum = 0.0;
+  float reading[3];
+  auto start = chrono::steady_clock::now();
+  for (size_t q = 0; q < queries; ++q) {
+    size_t k = q % kBatch;
+    map.query(x[k], y[k], steps[(q / kBatch + k) % kBatch], false, reading);
+    checksum += reading[2];
+  }
+  report(name + "/single", queries, chrono::duration<double>(chrono::steady_clock::now() - start).count(), checksum);
+
+  vector<float> outX(kBatch), outY(kBatch), outZ(kBatch);
+  checksum = 0.0;
+  start = chrono::steady_clock::now();
+  for (size_t q = 0; q < queries; q += kBatch) {
+    map.query(x.data(), y.data(), kBatch, steps[(q / kBatch) % kBatch], false, outX.data(), outY.data(), outZ.data());
+    for (float value : outZ)
+      checksum += value;
+  }
+  report(name + "/batch", queries, chrono::duration<double>(chrono::steady_clock::now() - start).count(), checksum);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    cerr << "Usage: " << argv[0] << " <capture.txt> [queries]" << endl;
+    return 1;
+  }
+  size_t queries = argc > 2 ? strtoull(argv[2], nullptr, 10) : 10000000;
+
+  cout << left << setw(48) << "Benchmark" << right << setw(15) << "Time/query" << setw(19) << "Throughput" << setw(16)
+       << "checksum" << endl;
+  cout << string(98, '-') << endl;
+
+  // The Python map: a source at (5, 5) over the integer coordinates 0 to 9, one step per reading
+  VibrationSource source;
+  source.x = source.y = 5.0;
+  source.playlist.push_back(argv[1]);
+  VibrationMap map;
+  string error;
+  if (!map.build({source}, 0.0, 0.0, 9.0, 9.0, 1.0, 60.0, 60.0, ResampleMethod::None, PlaybackEnd::Stop, "", &error)) {
+    cerr << "Error: " << error << endl;
+    return 1;
+  }
+
+  // Table scan over the rows of the Python map, capped at 1000 steps as the generator, at most 1000 queries
+  vector<MapRow> table;
+  for (uint32_t t = 0; t < 1000 && t < map.steps(); ++t) {
+    for (int i = 0; i < 10; ++i) {
+      for (int j = 0; j < 10; ++j) {
+        MapRow row = {t, i, j, {}};
+        map.query(i, j, t, false, row.vibration);
+        table.push_back(row);
+      }
+    }
+  }
+  mt19937 random(1);
+  uniform_int_distribution<int> coordinate(0, 9);
+  uniform_int_distribution<uint32_t> time(0, 999);
+  size_t scans = min<size_t>(queries, 1000);
+  double checksum = 0.0;
+  auto start = chrono::steady_clock::now();
+  for (size_t q = 0; q < scans; ++q) {
+    int x = coordinate(random), y = coordinate(random);
+    uint32_t t = time(random);
+    const MapRow *match = nullptr;
+    for (const MapRow &row : table) {
+      if (row.x == x && row.y == y && row.time == t && !match)
+        match = &row;
+    }
+    checksum += match ? match->vibration[2] : 0.0f;
+  }
+  report("python-map:1000-steps/table-scan", scans, chrono::duration<double>(chrono::steady_clock::now() - start).count(),
+         checksum);
+
+  benchmarkMap("python-map:" + to_string(map.steps()) + "-steps/computed", map, 9.0, queries);
+  if (map.materialize((size_t)1 << 30, &error))
+    benchmarkMap("python-map:" + to_string(map.steps()) + "-steps/dense", map, 9.0, queries);
+
+  // The Python map read back from a map store, with the default chunks; the steps of the sequential
+  // queries advance as a fleet's would, every point of a batch then the next step
+  string storeFile = "vibration_map_benchmark.pmvm";
+  if (!writeMapStore(map, storeFile, mapStoreLayout(map), 0, &error)) {
+    cerr << "Error: " << error << endl;
+    return 1;
+  }
+  MapStoreReader store;
+  if (!store.open(storeFile, &error)) {
+    cerr << "Error: " << error << endl;
+    return 1;
+  }
+  double csvBytes = 0.0;  // Rows of the Python CSV, as written by tools/vibration_map
+  for (const MapRow &row : table) {
+    char line[128];
+    csvBytes += snprintf(line, sizeof(line), "%u,%d,%d,%.9g,%.9g,%.9g\n", row.time, row.x, row.y, row.vibration[0],
+                         row.vibration[1], row.vibration[2]);
+  }
+  csvBytes *= (double)map.steps() / min<uint64_t>(map.steps(), 1000);
+  FILE *stored = fopen(storeFile.c_str(), "rb");
+  long storedBytes = stored && fseek(stored, 0, SEEK_END) == 0 ? ftell(stored) : -1;
+  if (stored)
+    fclose(stored);
+  cout << "  map store: " << storedBytes << " bytes, " << csvBytes / storedBytes << "x smaller than the CSV" << endl;
+  // Random steps decode a chunk for most queries, so fewer of them
+  benchmarkMap("python-map:" + to_string(map.steps()) + "-steps/store", store, 9.0, min<size_t>(queries, 100000));
+
+  vector<double> x(kBatch), y(kBatch);
+  for (size_t k = 0; k < kBatch; ++k) {
+    x[k] = coordinate(random);
+    y[k] = coordinate(random);
+  }
+  vector<float> outX(kBatch), outY(kBatch), outZ(kBatch);
+  checksum = 0.0;
+  start = chrono::steady_clock::now();
+  for (size_t q = 0; q < queries; q += kBatch) {
+    store.query(x.data(), y.data(), kBatch, (q / kBatch) % store.steps(), false, outX.data(), outY.data(), outZ.data());
+    for (float value : outZ)
+      checksum += value;
+  }
+  report("python-map:" + to_string(map.steps()) + "-steps/store/sequential", queries,
+         chrono::duration<double>(chrono::steady_clock::now() - start).count(), checksum);
+  cout << "  decoded " << store.chunksDecoded() << " chunks, " << store.cacheHits() << " cache hits" << endl;
+  store.close();
+  remove(storeFile.c_str());
+
+  // A 1 km arena with four sources at 1 node per meter, too large to materialize
+  vector<VibrationSource> sources;
+  for (int s = 0; s < 4; ++s) {
+    VibrationSource machine = source;
+    machine.x = 200.0 + 200.0 * s;
+    machine.y = 500.0;
+    machine.phase = 1000 * s;
+    sources.push_back(machine);
+  }
+  VibrationMap arena;
+  if (!arena.build(sources, 0.0, 0.0, 1000.0, 1000.0, 1.0, 60.0, 60.0, ResampleMethod::None, PlaybackEnd::Stop, "",
+                   &error)) {
+    cerr << "Error: " << error << endl;
+    return 1;
+  }
+  benchmarkMap("arena:1000m-4-sources/computed", arena, 1000.0, queries);
+  return 0;
+}
@@ -0,0 +1,103 @@
+// File: capture_converter.cpp
+// Description: Converts a tab-separated accelerometer capture into the binary capture format
+// (see capture_file.hpp). The input is streamed chunk by chunk, so captures of any size work.
+//
+// Usage: capture_converter [--rate HZ] [--int16] [--scale S] <input.txt> <output.pmvc>
+//   --rate   sample rate stored in the header (default: 0, unknown)
+//   --int16  store int16 fixed-point samples instead of float32
+//   --scale  fixed-point step for --int16 (default: largest magnitude / 32767)
+
+#include <capture_file.hpp>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+static const size_t kChunkRows = 65536;
+
+static void printUsage(const char *program) {
+  cerr << "Usage: " << program << " [--rate HZ] [--int16] [--scale S] <input.txt> <output.pmvc>" << endl;
+}
+
+int main(int argc, char **argv) {
+  float sampleRate = 0.0f;
+  float scale = 0.0f;
+  CaptureSampleType type = CaptureSampleType::Float32;
+  string input, output;
+
+  for (int a = 1; a < argc; ++a) {
+    if (strcmp(argv[a], "--rate") == 0 && a + 1 < argc)
+      sampleRate = strtof(argv[++a], nullptr);
+    else if (strcmp(argv[a], "--scale") == 0 && a + 1 < argc)
+      scale = strtof(argv[++a], nullptr);
+    else if (strcmp(argv[a], "--int16") == 0)
+      type = CaptureSampleType::Int16;
+    else if (input.empty())
+      input = argv[a];
+    else if (output.empty())
+      output = argv[a];
+    else {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+  if (input.empty() || output.empty()) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  CaptureReader reader;
+  string error;
+  if (!reader.open(input, &error)) {
+    cerr << "Error: " << input << ": " << error << endl;
+    return 1;
+  }
+
+  CaptureData chunk;
+  chunk.resize(kChunkRows);
+
+  // Without an explicit scale, a first pass finds the range the int16 samples have to cover
+  if (type == CaptureSampleType::Int16 && scale <= 0.0f) {
+    float largest = 0.0f;
+    size_t rows;
+    while ((rows = reader.read(chunk.x(), chunk.y(), chunk.z(), kChunkRows)) > 0)
+      for (const float *axis : {chunk.x(), chunk.y(), chunk.z()})
+        for (size_t i = 0; i < rows; ++i)
+          largest = fmaxf(largest, fabsf(axis[i]));
+    scale = largest > 0.0f ? largest / 32767.0f : 1.0f;
+    reader.rewind();
+  }
+
+  CaptureWriter writer;
+  if (!writer.open(output, type, sampleRate, scale)) {
+    cerr << "Error: Could not create " << output << endl;
+    return 1;
+  }
+
+  size_t total = 0, rows;
+  while ((rows = reader.read(chunk.x(), chunk.y(), chunk.z(), kChunkRows)) > 0) {
+    if (!writer.write(chunk.x(), chunk.y(), chunk.z(), rows)) {
+      cerr << "Error: Could not write " << output << endl;
+      return 1;
+    }
+    total += rows;
+  }
+  if (!reader.error().empty()) {
+    cerr << "Error: " << input << ": " << reader.error() << endl;
+    return 1;
+  }
+  if (!writer.close()) {
+    cerr << "Error: Could not finalize " << output << endl;
+    return 1;
+  }
+
+  for (const CaptureParseError &parseError : reader.report().errors)
+    cerr << input << ":" << parseError.line << ": " << parseError.message << endl;
+  cout << "Converted " << total << " rows from " << input << " to " << output << " ("
+       << (type == CaptureSampleType::Int16 ? "int16" : "float32") << ")" << endl;
+  return 0;
+}
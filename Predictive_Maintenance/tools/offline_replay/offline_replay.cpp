@@ -0,0 +1,567 @@
+// File: offline_replay.cpp
+// Description: Offline, faster-than-real-time replay of the supervisor's windows, to score the CNN
+// over whole captures without Webots. The captures are played back and resampled to the reading rate
+// of the windows, with the readings of every step, exactly as in the supervisor, the robots follow scripted or recorded trajectories, and every window
+// is classified by the native CNN as fast as the CPU allows.
+//
+// The steps are cut into segments, classified in parallel by worker threads. A segment starts with
+// enough warm-up steps for its windows to be identical to those of a single continuous run; the main
+// thread only plays back the captures and the trajectories, which is cheap next to the inference.
+//
+// Each window is also classified without attenuation (every source at gain 1, as a robot sitting on
+// the machines would sense it), and the confusion matrix compares the two labels. --timeline writes
+// one CSV row per window.
+//
+// Usage: offline_replay [options] [capture ...]
+//   --robots N | --fleet FILE       fleet, as in the supervisor (one robot at the origin by default)
+//   --sources FILE                  vibration sources, as in the supervisor (the captures at the origin by default)
+//   --trajectory still | circle | random-walk   scripted trajectories (default random-walk)
+//   --seed N                        seed of the random walks (default 1)
+//   --positions FILE                recorded trajectories: a CSV telemetry file of the supervisor
+//   --duration S                    simulated seconds to replay (default: until the captures end)
+//   --loop                          loop the captures, with --duration
+//   --time-step MS                  supervisor time step (default 64)
+//   --capture-rate HZ, --resample METHOD, --window-length N, --window-hop N, --interpolate,
+//   --field-resolution R, --calibration GX GY GZ OX OY OZ, --int8   as in the supervisor
+//   --threads N                     worker threads (default: one per core)
+//   --timeline FILE                 CSV of time, robot, window, label and reference label
+
+#include <capture_file.hpp>
+#include <capture_playback.hpp>
+#include <cnn_model.hpp>
+#include <fleet.hpp>
+#include <headless_pipeline.hpp>
+#include <quantized_cnn_model.hpp>
+#include <resampler.hpp>
+#include <sample_kernels.hpp>
+#include <supervisor_pipeline.hpp>
+#include <vibration_sources.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../models/cnn_model.h"
+
+using namespace std;
+
+static const double kArenaSize = 10.0;
+static const size_t kSegmentReadings = 2048;  // Readings whose windows a segment keeps
+static const size_t kBatchWindows = 256;    // Windows per CNN run
+static const size_t kInt8CalibrationWindows = 256;
+static const double kReadingRate = PipelineSettings().readingRate;  // Readings per second in the windows
+
+// Readings [start, end) of the replay: the windows completed from reading keep on are kept, the
+// readings before only fill the windows and the source history
+struct Segment {
+  size_t index;
+  size_t historyStart, start, keep, end;
+  vector<float> readings;  // Per reading from historyStart, per source: x, y, z
+  vector<double> x, y;     // Per reading from start, per robot: the position at the reading's step
+  vector<double> times;    // Per reading from start: the simulation time of the reading's step
+};
+
+struct TimelineEntry {
+  double time;
+  uint32_t robot;
+  uint32_t window;
+  int label;
+  int reference;
+};
+
+// Segments waiting for a worker, bounded so that the main thread does not run ahead
+class SegmentQueue {
+public:
+  explicit SegmentQueue(size_t capacity) : capacity_(capacity) {}
+
+  void push(unique_ptr<Segment> segment) {
+    unique_lock<mutex> lock(mutex_);
+    notFull_.wait(lock, [this] { return segments_.size() < capacity_; });
+    segments_.push_back(move(segment));
+    notEmpty_.notify_one();
+  }
+
+  // Returns nullptr once closed and empty
+  unique_ptr<Segment> pop() {
+    unique_lock<mutex> lock(mutex_);
+    notEmpty_.wait(lock, [this] { return !segments_.empty() || closed_; });
+    if (segments_.empty())
+      return nullptr;
+    unique_ptr<Segment> segment = move(segments_.front());
+    segments_.pop_front();
+    notFull_.notify_one();
+    return segment;
+  }
+
+  void close() {
+    lock_guard<mutex> lock(mutex_);
+    closed_ = true;
+    notEmpty_.notify_all();
+  }
+
+private:
+  size_t capacity_;
+  deque<unique_ptr<Segment>> segments_;
+  bool closed_ = false;
+  mutex mutex_;
+  condition_variable notEmpty_, notFull_;
+};
+
+struct ReplaySettings {
+  vector<RobotConfig> robots;
+  size_t sourceCount;
+  size_t windowLength, windowHop;
+  bool interpolate;
+  AxisCalibration calibration;
+  const vector<AttenuationField> *fields;
+  const CnnModel *model;
+  const QuantizedCnnModel *quantizedModel;  // Used instead of model when built
+};
+
+// Classifies the windows of segments, each with its own models and buffers
+class ReplayWorker {
+public:
+  ReplayWorker(const ReplaySettings &settings, size_t classes) :
+    settings_(settings),
+    model_(*settings.model),
+    quantizedModel_(*settings.quantizedModel),
+    classes_(classes),
+    confusion_(classes * classes, 0) {
+    size_t inputSize = settings.windowLength * 3;
+    inputs_.resize(kBatchWindows * inputSize);
+    referenceInputs_.resize(kBatchWindows * inputSize);
+    labels_.resize(kBatchWindows);
+    referenceLabels_.resize(kBatchWindows);
+  }
+
+  void run(const Segment &segment, vector<TimelineEntry> &timeline) {
+    const ReplaySettings &s = settings_;
+    size_t robots = s.robots.size();
+    FleetState fleet(s.robots, s.sourceCount, s.windowLength, s.windowHop);
+    FleetState reference(s.robots, s.sourceCount, s.windowLength, s.windowHop);  // Gains stay at 1
+    vector<SampleHistory> histories(s.sourceCount, SampleHistory(fleet.maxDelay() + 1));
+
+    // A robot joins the windows at the reading its cursor reaches the captures. Its assembler is fed as
+    // many zero readings as the continuous run's windows are ahead, so that the windows it completes
+    // after the warm-up fall on the same readings.
+    for (size_t k = 0; k < robots; ++k) {
+      size_t delay = fleet.delay[k];
+      size_t skipped = (max(segment.start, delay) - delay) % s.windowHop;
+      for (size_t i = 0; i < skipped; ++i) {
+        fleet.windows[k].push(0.0f, 0.0f, 0.0f);
+        reference.windows[k].push(0.0f, 0.0f, 0.0f);
+      }
+    }
+
+    for (size_t n = segment.historyStart; n < segment.end; ++n) {
+      const float *reading = &segment.readings[(n - segment.historyStart) * s.sourceCount * 3];
+      for (size_t source = 0; source < s.sourceCount; ++source)
+        histories[source].push(reading[3 * source], reading[3 * source + 1], reading[3 * source + 2]);
+      if (n < segment.start)
+        continue;
+
+      size_t offset = (n - segment.start) * robots;
+      copy(segment.x.begin() + offset, segment.x.begin() + offset + robots, fleet.x.begin());
+      copy(segment.y.begin() + offset, segment.y.begin() + offset + robots, fleet.y.begin());
+      fleet.updateAttenuation(*s.fields, s.interpolate);
+      fleet.pushReadings(histories);
+      reference.pushReadings(histories);
+      if (n < segment.keep)
+        continue;
+
+      // Both fleets complete the same windows, as they only differ in the gains
+      for (uint32_t k : fleet.ready) {
+        size_t inputSize = s.windowLength * 3;
+        scaleAndCalibrate(fleet.windows[k].window(), nullptr, s.windowLength, s.calibration, &inputs_[pending_.size() * inputSize]);
+        scaleAndCalibrate(reference.windows[k].window(), nullptr, s.windowLength, s.calibration,
+                          &referenceInputs_[pending_.size() * inputSize]);
+        size_t reading = n - fleet.delay[k];
+        uint32_t window = (uint32_t)((reading + 1 - s.windowLength) / s.windowHop);
+        pending_.push_back({segment.times[n - segment.start], k, window, -1, -1});
+        if (pending_.size() == kBatchWindows)
+          classify(timeline);
+      }
+    }
+    classify(timeline);
+  }
+
+  const vector<uint64_t> &confusion() const { return confusion_; }
+
+private:
+  void classify(vector<TimelineEntry> &timeline) {
+    size_t count = pending_.size();
+    if (count == 0)
+      return;
+    if (quantizedModel_.isBuilt()) {
+      quantizedModel_.classifyBatch(inputs_.data(), count, labels_.data());
+      quantizedModel_.classifyBatch(referenceInputs_.data(), count, referenceLabels_.data());
+    } else {
+      model_.classifyBatch(inputs_.data(), count, labels_.data());
+      model_.classifyBatch(referenceInputs_.data(), count, referenceLabels_.data());
+    }
+    for (size_t i = 0; i < count; ++i) {
+      pending_[i].label = labels_[i];
+      pending_[i].reference = referenceLabels_[i];
+      ++confusion_[referenceLabels_[i] * classes_ + labels_[i]];
+      timeline.push_back(pending_[i]);
+    }
+    pending_.clear();
+  }
+
+  const ReplaySettings &settings_;
+  CnnModel model_;  // Copies share the parsed graph, with their own activations
+  QuantizedCnnModel quantizedModel_;
+  vector<float> inputs_, referenceInputs_;
+  vector<int> labels_, referenceLabels_;
+  vector<TimelineEntry> pending_;
+  size_t classes_;
+  vector<uint64_t> confusion_;  // [reference][label]
+};
+
+static void printUsage(const char *program) {
+  cerr << "Usage: " << program << " [--robots N | --fleet FILE] [--sources FILE]"
+       << " [--trajectory still | circle | random-walk] [--seed N] [--positions FILE] [--duration S] [--loop]"
+       << " [--time-step MS] [--capture-rate HZ] [--resample METHOD] [--window-length N] [--window-hop N]"
+       << " [--interpolate] [--field-resolution R] [--calibration GX GY GZ OX OY OZ] [--int8] [--threads N]"
+       << " [--timeline FILE] [capture ...]" << endl;
+}
+
+int main(int argc, char **argv) {
+  vector<string> playlist;
+  size_t robotCount = 1;
+  string fleetFile, sourcesFile, positionsFile, timelineFile;
+  TrajectoryKind trajectory = TrajectoryKind::RandomWalk;
+  uint32_t seed = 1;
+  double duration = 0.0;
+  double timeStep = 64.0;
+  PlaybackEnd playbackEnd = PlaybackEnd::Stop;
+  double captureRate = 60.0;
+  ResampleMethod resampleMethod = ResampleMethod::Sinc;
+  size_t windowLength = 24, windowHop = 24;
+  bool interpolate = false;
+  double fieldResolution = 1.0;
+  AxisCalibration calibration;
+  bool int8Inference = false;
+  size_t threads = max(1u, thread::hardware_concurrency());
+
+  for (int a = 1; a < argc; ++a) {
+    string argument = argv[a];
+    if (argument == "--robots" && a + 1 < argc)
+      robotCount = strtoull(argv[++a], nullptr, 10);
+    else if (argument == "--fleet" && a + 1 < argc)
+      fleetFile = argv[++a];
+    else if (argument == "--sources" && a + 1 < argc)
+      sourcesFile = argv[++a];
+    else if (argument == "--trajectory" && a + 1 < argc) {
+      if (!parseTrajectoryKind(argv[++a], trajectory)) {
+        cerr << "Error: Unknown trajectory " << argv[a] << endl;
+        return 1;
+      }
+    } else if (argument == "--seed" && a + 1 < argc)
+      seed = (uint32_t)strtoul(argv[++a], nullptr, 10);
+    else if (argument == "--positions" && a + 1 < argc)
+      positionsFile = argv[++a];
+    else if (argument == "--duration" && a + 1 < argc)
+      duration = strtod(argv[++a], nullptr);
+    else if (argument == "--loop")
+      playbackEnd = PlaybackEnd::Loop;
+    else if (argument == "--time-step" && a + 1 < argc)
+      timeStep = strtod(argv[++a], nullptr);
+    else if (argument == "--capture-rate" && a + 1 < argc)
+      captureRate = strtod(argv[++a], nullptr);
+    else if (argument == "--resample" && a + 1 < argc) {
+      if (!parseResampleMethod(argv[++a], resampleMethod)) {
+        cerr << "Error: Unknown resampling method " << argv[a] << endl;
+        return 1;
+      }
+    } else if (argument == "--window-length" && a + 1 < argc)
+      windowLength = strtoull(argv[++a], nullptr, 10);
+    else if (argument == "--window-hop" && a + 1 < argc)
+      windowHop = strtoull(argv[++a], nullptr, 10);
+    else if (argument == "--interpolate")
+      interpolate = true;
+    else if (argument == "--field-resolution" && a + 1 < argc)
+      fieldResolution = strtod(argv[++a], nullptr);
+    else if (argument == "--calibration" && a + 6 < argc) {
+      for (int axis = 0; axis < 3; ++axis)
+        calibration.gain[axis] = strtof(argv[++a], nullptr);
+      for (int axis = 0; axis < 3; ++axis)
+        calibration.offset[axis] = strtof(argv[++a], nullptr);
+    } else if (argument == "--int8")
+      int8Inference = true;
+    else if (argument == "--threads" && a + 1 < argc)
+      threads = max<size_t>(1, strtoull(argv[++a], nullptr, 10));
+    else if (argument == "--timeline" && a + 1 < argc)
+      timelineFile = argv[++a];
+    else if (argument.compare(0, 2, "--") == 0) {
+      printUsage(argv[0]);
+      return 1;
+    } else
+      playlist.push_back(argument);
+  }
+  if (playlist.empty() && sourcesFile.empty()) {
+    printUsage(argv[0]);
+    return 1;
+  }
+  if (playbackEnd == PlaybackEnd::Loop && duration <= 0.0) {
+    cerr << "Error: --loop needs a --duration" << endl;
+    return 1;
+  }
+  if (windowLength == 0 || windowHop == 0 || timeStep <= 0.0) {
+    cerr << "Error: The window length, window hop and time step must be positive" << endl;
+    return 1;
+  }
+
+  // Fleet and sources, as in the supervisor
+  vector<RobotConfig> robots;
+  string error;
+  if (!fleetFile.empty()) {
+    if (!loadFleetConfig(fleetFile, robots, 2, &error)) {
+      cerr << "Error: " << error << endl;
+      return 1;
+    }
+  } else if (robotCount > 1) {
+    robots = gridFleet(robotCount, kArenaSize, 2);
+  }
+  if (robots.empty())
+    robots.push_back({0.0, 0.0, 2, 0});
+
+  vector<VibrationSource> sources;
+  if (!sourcesFile.empty() && !loadSourceConfig(sourcesFile, sources, &error)) {
+    cerr << "Error: " << error << endl;
+    return 1;
+  }
+  if (sources.empty()) {
+    VibrationSource source;
+    source.playlist = playlist;
+    sources.push_back(source);
+  }
+  vector<AttenuationField> fields =
+    buildSourceFields(sources, -kArenaSize / 2, -kArenaSize / 2, kArenaSize, kArenaSize, fieldResolution);
+
+  // Trajectories
+  unique_ptr<RobotPoses> poses;
+  if (!positionsFile.empty()) {
+    RecordedTrajectories *recorded = new RecordedTrajectories(robots);
+    poses.reset(recorded);
+    if (!recorded->load(positionsFile, &error)) {
+      cerr << "Error: " << error << endl;
+      return 1;
+    }
+  } else {
+    poses.reset(new ScriptedTrajectories(robots, trajectory, kArenaSize, seed));
+  }
+
+  // Models, copied by every worker
+  CnnModel model;
+  if (!model.load(autoencoder_model, autoencoder_model_len, &error)) {
+    cerr << "Error: Could not load the embedded CNN model (" << error << ")" << endl;
+    return 1;
+  }
+  if (model.inputSize() != windowLength * 3) {
+    cerr << "Error: The CNN expects windows of " << model.inputSize() / 3 << " readings" << endl;
+    return 1;
+  }
+  QuantizedCnnModel quantizedModel;
+  if (int8Inference) {
+    PipelineSettings calibrationSettings;
+    calibrationSettings.windowLength = windowLength;
+    calibrationSettings.calibration = calibration;
+    calibrationSettings.captureRate = captureRate;
+    calibrationSettings.resampleMethod = resampleMethod;
+    vector<float> calibrationInputs;
+    if (!loadCalibrationWindows(sources[0].playlist[0], calibrationSettings, kInt8CalibrationWindows, calibrationInputs,
+                                &error) ||
+        !quantizedModel.build(model, calibrationInputs.data(), calibrationInputs.size() / model.inputSize(), &error)) {
+      cerr << "Error: Could not quantize the CNN model (" << error << ")" << endl;
+      return 1;
+    }
+  }
+
+  // Playback of every source, resampled to the reading rate of the windows, as in the supervisor pipeline
+  vector<unique_ptr<CapturePlayback>> playbacks;
+  vector<Resampler> resamplers;
+  for (const VibrationSource &source : sources) {
+    playbacks.emplace_back(new CapturePlayback());
+    playbacks.back()->start(source.playlist, playbackEnd);
+    float skipped[3];
+    for (size_t p = 0; p < source.phase && playbacks.back()->next(skipped[0], skipped[1], skipped[2]); ++p) {
+    }
+    CapturePlayback *playback = playbacks.back().get();
+    double sourceRate = source.playlist.empty() ? captureRate : captureSampleRate(source.playlist[0], captureRate);
+    resamplers.emplace_back([playback](float &x, float &y, float &z) { return playback->next(x, y, z); }, sourceRate,
+                            kReadingRate, resampleMethod);
+  }
+
+  ReplaySettings settings = {robots, sources.size(), windowLength, windowHop, interpolate, calibration, &fields,
+                             &model, &quantizedModel};
+  size_t classes = model.outputSize();
+  size_t maxDelay = FleetState(robots, sources.size(), windowLength, windowHop).maxDelay();
+  size_t warmupReadings = windowLength - 1;     // Readings of the first kept window before its segment
+  size_t historyReadings = maxDelay + 1;        // Source readings the robots' cursors reach back to
+  double stepTime = timeStep / 1000.0;
+  size_t maxSteps = duration > 0.0 ? (size_t)(duration * 1000.0 / timeStep) : (size_t)-1;
+
+  // Workers, each with its share of the timeline, indexed by segment
+  SegmentQueue queue(2 * threads);
+  vector<vector<TimelineEntry>> timelines;
+  mutex timelinesMutex;
+  vector<unique_ptr<ReplayWorker>> workers;
+  vector<thread> workerThreads;
+  for (size_t t = 0; t < threads; ++t) {
+    workers.emplace_back(new ReplayWorker(settings, classes));
+    ReplayWorker *worker = workers.back().get();
+    workerThreads.emplace_back([&queue, &timelines, &timelinesMutex, worker] {
+      while (unique_ptr<Segment> segment = queue.pop()) {
+        vector<TimelineEntry> timeline;
+        worker->run(*segment, timeline);
+        lock_guard<mutex> lock(timelinesMutex);
+        if (timelines.size() <= segment->index)
+          timelines.resize(segment->index + 1);
+        timelines[segment->index].swap(timeline);
+      }
+    });
+  }
+
+  // Play back the captures and the trajectories, with the readings due at every step, and cut them
+  // into segments. Every segment repeats the last readings of the previous one as its warm-up.
+  auto start = chrono::steady_clock::now();
+  size_t sourceValues = sources.size() * 3;
+  ReadingClock readingClock(kReadingRate, 1.0 / stepTime);
+  vector<float> readings;         // Per reading from readingsStart
+  vector<double> positionsX, positionsY, times;  // Per reading from positionsStart
+  size_t readingsStart = 0, positionsStart = 0;
+  vector<double> x(robots.size()), y(robots.size());
+  vector<float> reading(sourceValues);
+  vector<bool> sourceFinished(sources.size(), false);
+  size_t step = 0, readingCount = 0, segmentIndex = 0, segmentKeep = 0;
+  bool outOfData = false;
+  while (!outOfData) {
+    // Position of every robot at this step, and the readings of every source due at it
+    if (step < maxSteps) {
+      size_t due = readingClock.next();
+      ++step;
+      poses->read(step * stepTime, x, y);
+      for (size_t r = 0; r < due && !outOfData; ++r) {
+        size_t playingSources = 0;
+        for (size_t s = 0; s < sources.size(); ++s) {
+          float *sample = &reading[3 * s];
+          sample[0] = sample[1] = sample[2] = 0.0f;
+          if (!sourceFinished[s] && resamplers[s].next(sample[0], sample[1], sample[2]))
+            ++playingSources;
+          else
+            sourceFinished[s] = true;
+        }
+        outOfData = playingSources == 0;
+        if (outOfData)
+          break;
+        readings.insert(readings.end(), reading.begin(), reading.end());
+        positionsX.insert(positionsX.end(), x.begin(), x.end());
+        positionsY.insert(positionsY.end(), y.begin(), y.end());
+        times.push_back(step * stepTime);
+        ++readingCount;
+      }
+    } else {
+      outOfData = true;
+    }
+
+    if (readingCount - segmentKeep < kSegmentReadings && !outOfData)
+      continue;
+    if (readingCount == segmentKeep)
+      break;
+
+    // Segment [segmentKeep, readingCount), and its warm-up
+    unique_ptr<Segment> segment(new Segment());
+    segment->index = segmentIndex++;
+    segment->keep = segmentKeep;
+    segment->end = readingCount;
+    segment->start = segmentKeep > warmupReadings ? segmentKeep - warmupReadings : 0;
+    segment->historyStart = segment->start > historyReadings ? segment->start - historyReadings : 0;
+    segment->readings.assign(readings.begin() + (segment->historyStart - readingsStart) * sourceValues,
+                             readings.begin() + (readingCount - readingsStart) * sourceValues);
+    segment->x.assign(positionsX.begin() + (segment->start - positionsStart) * robots.size(), positionsX.end());
+    segment->y.assign(positionsY.begin() + (segment->start - positionsStart) * robots.size(), positionsY.end());
+    segment->times.assign(times.begin() + (segment->start - positionsStart), times.end());
+    queue.push(move(segment));
+    segmentKeep = readingCount;
+
+    // Keep what the next segment's warm-up needs
+    size_t nextStart = readingCount > warmupReadings ? readingCount - warmupReadings : 0;
+    size_t nextHistoryStart = nextStart > historyReadings ? nextStart - historyReadings : 0;
+    readings.erase(readings.begin(), readings.begin() + (nextHistoryStart - readingsStart) * sourceValues);
+    readingsStart = nextHistoryStart;
+    positionsX.erase(positionsX.begin(), positionsX.begin() + (nextStart - positionsStart) * robots.size());
+    positionsY.erase(positionsY.begin(), positionsY.begin() + (nextStart - positionsStart) * robots.size());
+    times.erase(times.begin(), times.begin() + (nextStart - positionsStart));
+    positionsStart = nextStart;
+  }
+  queue.close();
+  for (thread &worker : workerThreads)
+    worker.join();
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  for (const unique_ptr<CapturePlayback> &playback : playbacks) {
+    for (const CapturePlaybackError &playbackError : playback->takeErrors()) {
+      if (playbackError.line == 0)
+        cerr << "Error: " << playbackError.filename << ": " << playbackError.message << endl;
+      else
+        cerr << playbackError.filename << ":" << playbackError.line << ": " << playbackError.message << endl;
+    }
+  }
+
+  // Confusion matrix of the robots' labels against the unattenuated labels
+  vector<uint64_t> confusion(classes * classes, 0);
+  for (const unique_ptr<ReplayWorker> &worker : workers) {
+    for (size_t i = 0; i < confusion.size(); ++i)
+      confusion[i] += worker->confusion()[i];
+  }
+  uint64_t windows = 0, agreements = 0;
+  for (size_t i = 0; i < classes; ++i) {
+    for (size_t j = 0; j < classes; ++j)
+      windows += confusion[i * classes + j];
+    agreements += confusion[i * classes + i];
+  }
+
+  double simulated = step * stepTime;
+  cout << "Replayed " << simulated << " s of " << robots.size() << " robot(s) in " << seconds << " s ("
+       << simulated / seconds << "x real time) on " << threads << " thread(s): " << windows << " windows, "
+       << windows / seconds << " windows/s" << (quantizedModel.isBuilt() ? ", int8 CNN" : "") << endl;
+  cout << "Labels (columns) against the labels without attenuation (rows):" << endl;
+  cout << setw(10) << "";
+  for (size_t j = 0; j < classes; ++j)
+    cout << setw(10) << j;
+  cout << endl;
+  for (size_t i = 0; i < classes; ++i) {
+    cout << setw(10) << i;
+    for (size_t j = 0; j < classes; ++j)
+      cout << setw(10) << confusion[i * classes + j];
+    cout << endl;
+  }
+  cout << "Agreement: " << fixed << setprecision(2) << (windows ? 100.0 * agreements / windows : 0.0) << "%" << endl;
+
+  if (!timelineFile.empty()) {
+    ofstream timeline(timelineFile);
+    if (!timeline) {
+      cerr << "Error: Could not create " << timelineFile << endl;
+      return 1;
+    }
+    timeline << "time,robot,window,label,reference\n" << setprecision(3);
+    for (const vector<TimelineEntry> &segment : timelines) {
+      for (const TimelineEntry &entry : segment)
+        timeline << entry.time << "," << entry.robot << "," << entry.window << "," << entry.label << "," << entry.reference
+                 << "\n";
+    }
+    cout << "Wrote " << timelineFile << endl;
+  }
+  return 0;
+}
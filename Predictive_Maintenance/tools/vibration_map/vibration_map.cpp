@@ -0,0 +1,218 @@
+// File: vibration_map.cpp
+// Description: Builds the vibration map of python_generate_map with the C++ VibrationMap (see
+// vibration_map.hpp), without its 1000-row cap: answers point queries and writes the same CSV of
+// Time, X, Y, Vibration_X, Vibration_Y and Vibration_Z for every capture reading and every integer
+// coordinate of the map, or stores it chunked and compressed (see map_store.hpp).
+//
+// Usage: vibration_map [--sources FILE] [--map-size N] [--origin X Y] [--resolution R] [--rate HZ]
+//                      [--materialize MIB] [--csv FILE] [--store FILE] [--chunk-steps N] [--tile N] [--quantum Q]
+//                      [--threads N] [--from-store FILE] [--query X Y T]... [capture ...]
+//   --sources      vibration sources (see vibration_sources.hpp); without one, a single source at
+//                  (5, 5) attenuated by 1 / (1 + distance) plays the captures, as the Python generator
+//   --map-size     the map covers the coordinates 0 to N - 1 on both axes (default 10)
+//   --origin       the map starts at (X, Y) instead, e.g. -5 -5 for the supervisor's 10 m arena
+//   --resolution   grid nodes per unit of the map (default 1); the CSV keeps the integer coordinates
+//   --rate         sample rate of text captures, binary ones carry theirs; the map has one step per
+//                  reading (default 60)
+//   --materialize  store the map on its grid when it takes at most MIB (default 256)
+//   --csv          write every step of every coordinate
+//   --store        write the map to a map store, cut into chunks of N steps (default 256) by tiles of
+//                  N x N grid nodes (default 16), its values quantized to multiples of Q (default 1e-4)
+//   --threads      worker threads computing and compressing the chunks (default: one per core)
+//   --from-store   answer the queries from a map store instead of building the map from captures
+//   --query        print the vibration at (X, Y) at step T, answered in constant time
+
+#include <capture_file.hpp>
+#include <map_store.hpp>
+#include <vibration_map.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+struct Query {
+  double x, y;
+  uint64_t step;
+};
+
+static void printUsage(const char *program) {
+  cerr << "Usage: " << program << " [--sources FILE] [--map-size N] [--origin X Y] [--resolution R] [--rate HZ]"
+       << " [--materialize MIB] [--csv FILE] [--store FILE] [--chunk-steps N] [--tile N] [--quantum Q] [--threads N]"
+       << " [--from-store FILE] [--query X Y T]... [capture ...]" << endl;
+}
+
+static void printQuery(const Query &query, const VibrationField &map) {
+  float reading[3];
+  map.query(query.x, query.y, query.step, false, reading);
+  if (query.step < map.steps())
+    cout << "Acceleration at (" << query.x << ", " << query.y << ") at time " << query.step << ": " << reading[0] << ", "
+         << reading[1] << ", " << reading[2] << endl;
+  else
+    cout << "No data available at time " << query.step << endl;
+}
+
+int main(int argc, char **argv) {
+  string sourcesFile, csvFile, storeFile, fromStoreFile;
+  vector<string> playlist;
+  size_t mapSize = 10;
+  double originX = 0.0, originY = 0.0;
+  double resolution = 1.0;
+  size_t chunkSteps = 256, tileSize = 16;
+  float quantum = 1e-4f;
+  size_t threads = max(1u, thread::hardware_concurrency());
+  double rate = 60.0;
+  double materializeSize = 256.0;
+  vector<Query> queries;
+
+  for (int a = 1; a < argc; ++a) {
+    if (strcmp(argv[a], "--sources") == 0 && a + 1 < argc)
+      sourcesFile = argv[++a];
+    else if (strcmp(argv[a], "--map-size") == 0 && a + 1 < argc)
+      mapSize = strtoull(argv[++a], nullptr, 10);
+    else if (strcmp(argv[a], "--origin") == 0 && a + 2 < argc) {
+      originX = strtod(argv[++a], nullptr);
+      originY = strtod(argv[++a], nullptr);
+    } else if (strcmp(argv[a], "--resolution") == 0 && a + 1 < argc)
+      resolution = strtod(argv[++a], nullptr);
+    else if (strcmp(argv[a], "--rate") == 0 && a + 1 < argc)
+      rate = strtod(argv[++a], nullptr);
+    else if (strcmp(argv[a], "--materialize") == 0 && a + 1 < argc)
+      materializeSize = strtod(argv[++a], nullptr);
+    else if (strcmp(argv[a], "--csv") == 0 && a + 1 < argc)
+      csvFile = argv[++a];
+    else if (strcmp(argv[a], "--store") == 0 && a + 1 < argc)
+      storeFile = argv[++a];
+    else if (strcmp(argv[a], "--chunk-steps") == 0 && a + 1 < argc)
+      chunkSteps = strtoull(argv[++a], nullptr, 10);
+    else if (strcmp(argv[a], "--tile") == 0 && a + 1 < argc)
+      tileSize = strtoull(argv[++a], nullptr, 10);
+    else if (strcmp(argv[a], "--quantum") == 0 && a + 1 < argc)
+      quantum = strtof(argv[++a], nullptr);
+    else if (strcmp(argv[a], "--threads") == 0 && a + 1 < argc)
+      threads = max<size_t>(1, strtoull(argv[++a], nullptr, 10));
+    else if (strcmp(argv[a], "--from-store") == 0 && a + 1 < argc)
+      fromStoreFile = argv[++a];
+    else if (strcmp(argv[a], "--query") == 0 && a + 3 < argc) {
+      Query query;
+      query.x = strtod(argv[++a], nullptr);
+      query.y = strtod(argv[++a], nullptr);
+      query.step = strtoull(argv[++a], nullptr, 10);
+      queries.push_back(query);
+    } else if (strncmp(argv[a], "--", 2) == 0) {
+      printUsage(argv[0]);
+      return 1;
+    } else
+      playlist.push_back(argv[a]);
+  }
+  if ((playlist.empty() && sourcesFile.empty() && fromStoreFile.empty()) || mapSize < 2 || rate <= 0.0 ||
+      resolution <= 0.0) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  string error;
+  if (!fromStoreFile.empty()) {
+    MapStoreReader store;
+    if (!store.open(fromStoreFile, &error)) {
+      cerr << "Error: " << error << endl;
+      return 1;
+    }
+    const MapStoreLayout &layout = store.layout();
+    cout << "Opened a " << layout.columns << " x " << layout.rows << " node map of " << layout.steps << " steps in "
+         << layout.chunkCount() << " chunks" << endl;
+    for (const Query &query : queries)
+      printQuery(query, store);
+    cout << "Decoded " << store.chunksDecoded() << " chunk(s)" << endl;
+    return 0;
+  }
+
+  vector<VibrationSource> sources;
+  if (!sourcesFile.empty() && !loadSourceConfig(sourcesFile, sources, &error)) {
+    cerr << "Error: " << error << endl;
+    return 1;
+  }
+  if (sources.empty()) {
+    VibrationSource source;
+    source.x = source.y = 5.0;
+    source.playlist = playlist;
+    sources.push_back(source);
+  }
+
+  // One step per reading, at the rate of the first capture when it is a binary capture with one
+  if (!sources[0].playlist.empty())
+    rate = captureSampleRate(sources[0].playlist[0], rate);
+
+  auto start = chrono::steady_clock::now();
+  VibrationMap map;
+  double extent = (double)(mapSize - 1);
+  if (!map.build(sources, originX, originY, extent, extent, resolution, rate, rate, ResampleMethod::None, PlaybackEnd::Stop, "", &error)) {
+    cerr << "Error: " << error << endl;
+    return 1;
+  }
+  if (map.skippedLines() > 0)
+    cerr << "Warning: Skipped " << map.skippedLines() << " malformed capture line(s)" << endl;
+  if (!map.materialize((size_t)(materializeSize * 1024 * 1024), &error))
+    cerr << "Computing the queries from the sources (" << error << ")" << endl;
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  cout << "Built a " << mapSize << " x " << mapSize << " map of " << map.steps() << " steps in " << seconds << " s"
+       << (map.dense() ? ", materialized" : "") << endl;
+
+  for (const Query &query : queries)
+    printQuery(query, map);
+
+  if (!storeFile.empty()) {
+    start = chrono::steady_clock::now();
+    MapStoreLayout layout = mapStoreLayout(map, chunkSteps, tileSize, quantum);
+    if (!writeMapStore(map, storeFile, layout, threads, &error)) {
+      cerr << "Error: " << error << endl;
+      return 1;
+    }
+    seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    double rawBytes = (double)layout.steps * layout.columns * layout.rows * 3 * sizeof(float);
+    FILE *stored = fopen(storeFile.c_str(), "rb");
+    long storedBytes = stored && fseek(stored, 0, SEEK_END) == 0 ? ftell(stored) : -1;
+    if (stored)
+      fclose(stored);
+    cout << "Stored " << layout.chunkCount() << " chunks to " << storeFile << " in " << seconds << " s on " << threads
+         << " thread(s): " << storedBytes << " bytes, " << rawBytes / storedBytes << "x smaller than float32" << endl;
+  }
+
+  if (!csvFile.empty()) {
+    FILE *csv = fopen(csvFile.c_str(), "w");
+    if (!csv) {
+      cerr << "Error: Could not create " << csvFile << endl;
+      return 1;
+    }
+    // Same rows and order as the Python generator: every x, then every y, of every step
+    vector<double> x, y;
+    for (size_t i = 0; i < mapSize; ++i) {
+      for (size_t j = 0; j < mapSize; ++j) {
+        x.push_back(originX + i);
+        y.push_back(originY + j);
+      }
+    }
+    vector<float> vibrationX(x.size()), vibrationY(x.size()), vibrationZ(x.size());
+    fprintf(csv, "Time,X,Y,Vibration_X,Vibration_Y,Vibration_Z\n");
+    for (uint64_t step = 0; step < map.steps(); ++step) {
+      map.query(x.data(), y.data(), x.size(), step, false, vibrationX.data(), vibrationY.data(), vibrationZ.data());
+      for (size_t k = 0; k < x.size(); ++k)
+        fprintf(csv, "%llu,%d,%d,%.9g,%.9g,%.9g\n", (unsigned long long)step, (int)lround(x[k]), (int)lround(y[k]),
+                vibrationX[k], vibrationY[k], vibrationZ[k]);
+    }
+    if (fclose(csv) != 0) {
+      cerr << "Error: Could not write " << csvFile << endl;
+      return 1;
+    }
+    cout << "Vibration map successfully saved to " << csvFile << endl;
+  }
+  return 0;
+}